@@ -32,13 +32,25 @@ identified are necessarily the best available for the purpose.
 #include "CLI11.hpp"
 #include "glob.h"
 #include "nfir_lib.h"
+#include "pipeline.h"
+#include "target_writer.h"
+#include "threading_policy.h"
 #include "termcolor.h"
 
+#include <algorithm>
 #include <chrono>
 #ifndef _WIN32_64
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 #include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -48,14 +60,45 @@ identified are necessarily the best available for the purpose.
 int srcSampleRate{0};
 /** Desired sample rate of generated, target image */
 int tgtSampleRate{0};
-/** for the source image */
-std::string srcPath{""};
-/** for the target (generated) image */
-std::string tgtPath{""};
 
 // Forward function declarations
 std::string buildTargetImageFilename( const std::string &, const std::string & );
 void retrieveSourceImagesList( const std::string &, const std::string &, std::vector<std::string>& );
+void prefetchSourceFile( const std::string & );
+bool readSourceSize( const std::string &, uint32_t *, uint32_t * );
+bool parseRawSize( const std::string &, uint32_t *, uint32_t * );
+bool readRawSidecar( const std::string &, uint32_t *, uint32_t * );
+
+/**
+ * @brief Read-only view of a source image file.
+ *
+ * Linux: the file is memory-mapped, advised for sequential access and
+ * prefetched; the resampler decodes straight from the mapping, so there is
+ * no copy beside the page cache.  Windows: the file is read into memory.
+ */
+class SourceFile
+{
+public:
+  /** @brief Map or read the file; throws NFIR::Miscue if it cannot */
+  explicit SourceFile( const std::string & );
+  /** @brief Unmap */
+  ~SourceFile();
+
+  SourceFile( const SourceFile& ) = delete;
+  SourceFile& operator=( const SourceFile& ) = delete;
+
+  /** @brief File content */
+  const uint8_t *data(void) const { return _data; }
+  /** @brief File length in bytes */
+  size_t size(void) const { return _size; }
+
+private:
+  const uint8_t *_data{nullptr};
+  size_t _size{0};
+#ifdef _WIN32_64
+  std::vector<uint8_t> _buffer;
+#endif
+};
 
 /**
  * @brief OS dependent path delimiter.
@@ -118,18 +161,58 @@ int main(int argc, char** argv)
     ->check(CLI::ExistingDirectory);
 
   std::string srcImageFormat {"png"};
-  app.add_option( "-m, --src-img-fmt", srcImageFormat, "Image compression format by filename extension, default is 'png'" );
+  app.add_option( "-m, --src-img-fmt", srcImageFormat, "Image compression format by filename extension, raw and pgm are read without a codec; default is 'png'" );
 
   std::string tgtImageFormat {"png"};
-  app.add_option( "-n, --tgt-img-fmt", tgtImageFormat, "Image compression format by filename extension, default is 'png'" );
+  app.add_option( "-n, --tgt-img-fmt", tgtImageFormat, "Image compression format by filename extension, raw and pgm are written without a codec; default is 'png'" );
+
+  std::string rawSize {};
+  app.add_option( "--raw-size", rawSize, "Raw source image WxH, eg, 1600x1500; default is per image from the '<image>.dims' sidecar" );
 
   std::string interpolationMethod {};
-  CLI::Option *im_opt = app.add_option( "-i, --interp-method", interpolationMethod, "For interpolation use [ bicubic | bilinear ]" );
+  CLI::Option *im_opt = app.add_option( "-i, --interp-method", interpolationMethod, "For interpolation use [ bicubic | bilinear | spectral | polyphase ], spectral is downsample only, polyphase ignores filter type" );
 
   std::string filterType {};
-  CLI::Option *fs_opt = app.add_option( "-f, --downsamp-filter-type", filterType, "For filter use [ ideal | Gaussian ]" )
+  app.add_option( "-f, --downsamp-filter-type", filterType, "For filter use [ ideal | Gaussian ], not needed for polyphase" )
     ->needs(im_opt);
-  im_opt->needs(fs_opt);
+
+  size_t maskCacheMB {256};
+  app.add_option( "--mask-cache-mb", maskCacheMB, "Downsample filter/mask cache memory cap in MiB, 0 disables; default is 256" );
+
+  NFIR::Options options;
+  app.add_option( "--downsamp-engine", options.filterEngine, "Downsample lowpass filter engine [ fft | auto | spatial | tiled ], spatial is Gaussian only; default is 'fft'" );
+  app.add_option( "--tile-size", options.tileSize, "Tiled filter engine tile width and height in pixels; default is 1024" );
+  std::string fftBackend {"opencv"};
+  app.add_option( "--fft-backend", fftBackend, "Downsample FFT backend [ opencv | builtin | fftw | auto ], fftw only if built with it, auto times each per size; default is 'opencv'" );
+  std::string fftWisdomFile {};
+  app.add_option( "--fft-wisdom", fftWisdomFile, "FFT wisdom file, fastest backend per size, read at start and written at end" );
+  size_t memoryBudgetMB {0};
+  app.add_option( "--memory-budget-mb", memoryBudgetMB, "Downsample FFT working memory cap in MiB, bounds tiles in flight; 0 is unbounded (default)" );
+  app.add_option( "--metadata", options.metadataWriter, "PNG/BMP target resolution and text metadata [ auto | inline | nfimm | none ], inline writes it in the one encode; default is 'auto'" );
+  app.add_option( "--png-preset", options.pngPreset, "PNG target encode [ default | fast | store | small ], fast and store trade size for encode time; default is 'default'" );
+  app.add_option( "--png-level", options.pngCompressionLevel, "PNG deflate level 0-9, overrides the preset; -1 (default) for none" );
+  app.add_option( "--png-strategy", options.pngStrategy, "PNG deflate strategy [ default | filtered | huffman | rle | fixed ], overrides the preset" );
+  app.add_flag( "--stream-rows", options.streamRows, "Polyphase, 8-bit gray PNG/PGM: decode, resample, and encode by row bands; bounds memory by image width" );
+  size_t readAhead {2};
+  app.add_option( "--read-ahead", readAhead, "Source files to prefetch ahead of the one being resampled, 0 disables; default is 2" );
+  size_t jobs {0};
+  app.add_option( "-j, --jobs", jobs, "Images resampled concurrently, 0 lets the threading policy choose; default is 0" );
+  std::string threading {"auto"};
+  app.add_option( "--threading", threading, "Cores to [ latency | throughput | hybrid | auto ]: all to one image, one per image, or split; auto chooses from the batch; default is 'auto'" );
+  size_t readers {0};
+  app.add_option( "--readers", readers, "Threads that read and decode source images, 0 lets the threading policy choose; default is 0" );
+  size_t writers {0};
+  app.add_option( "--writers", writers, "Threads that encode and write target images, 0 lets the threading policy choose; default is 0" );
+  size_t queueDepth {2};
+  app.add_option( "--queue-depth", queueDepth, "Images queued between read, resample, and write stages; default is 2" );
+  NFIR::TargetWriterOptions writerOptions;
+  int writeThreads {-1};
+  app.add_option( "--write-threads", writeThreads, "Threads that write target files behind the encoders, 0 writes on the encoding thread, -1 lets the threading policy choose; default is -1" );
+  app.add_option( "--write-queue", writerOptions.queueDepth, "Encoded targets waiting to be written before the encoders wait; default is 8" );
+  app.add_flag( "--atomic-write", writerOptions.atomicRename, "Write each target to '<target>.tmp' and rename it once complete and synced" );
+  app.add_option( "--fsync", writerOptions.fsync, "Sync written targets to disk [ none | file | batch ], batch syncs (and with --atomic-write renames) all at the end; default is 'none'" );
+  std::string schedule {"largest-first"};
+  app.add_option( "--schedule", schedule, "Batch order [ largest-first | list ], largest-first estimates cost from the image headers; default is 'largest-first'" );
 
   bool flagDryRun {false};
   app.add_flag( "-x,--dry-run", flagDryRun, "Skip resample attempt" )
@@ -212,6 +295,9 @@ int main(int argc, char** argv)
     }
     std::cout << "Source image format: '" << srcImageFormat  << "'" << std::endl;
     std::cout << "Target image format: '" << tgtImageFormat  << "'" << std::endl;
+    if( srcImageFormat == "raw" )
+      std::cout << "Raw source size: '" << ( rawSize.empty() ? "sidecar" : rawSize )
+                << "'" << std::endl;
     // output the PNG text
     #ifdef USE_NFIMM
     if( srcImageFormat == "png" )
@@ -224,6 +310,11 @@ int main(int argc, char** argv)
     #endif
     if( tgtSampleRate < srcSampleRate ) {
       std::cout << "Downsample filter type: '" << filterType << "'" << std::endl;
+      std::cout << "Downsample filter engine: '" << options.filterEngine << "'" << std::endl;
+      std::cout << "Downsample tile size: '" << options.tileSize << "'" << std::endl;
+      std::cout << "Downsample memory budget (MiB): '" << memoryBudgetMB << "'" << std::endl;
+      std::cout << "Downsample FFT backend: '" << fftBackend << "'" << std::endl;
+      std::cout << "Downsample FFT wisdom file: '" << fftWisdomFile << "'" << std::endl;
       std::cout << "Downsample interpolation method: '" << interpolationMethod
                 << "'" << std::endl;
     }
@@ -232,6 +323,24 @@ int main(int argc, char** argv)
       std::cout << "Upsample interpolation method: '" << interpolationMethod
                 << "'" << std::endl;
     }
+    std::cout << "Filter/mask cache (MiB): '" << maskCacheMB << "'" << std::endl;
+    std::cout << "Metadata writer: '" << options.metadataWriter << "'" << std::endl;
+    if( tgtImageFormat == "png" ) {
+      std::cout << "PNG preset: '" << options.pngPreset << "'" << std::endl;
+      std::cout << "PNG level, strategy: '" << options.pngCompressionLevel
+                << "', '" << options.pngStrategy << "'" << std::endl;
+    }
+    std::cout << "Stream rows: " << std::boolalpha << options.streamRows << std::endl;
+    std::cout << "Read-ahead (files): '" << readAhead << "'" << std::endl;
+    std::cout << "Jobs: '" << jobs << "'" << std::endl;
+    std::cout << "Threading policy: '" << threading << "'" << std::endl;
+    std::cout << "Readers, writers: '" << readers << "', '" << writers << "'" << std::endl;
+    std::cout << "Queue depth: '" << queueDepth << "'" << std::endl;
+    std::cout << "Write threads, queue: '" << writeThreads << "', '"
+              << writerOptions.queueDepth << "'" << std::endl;
+    std::cout << "Atomic write: " << std::boolalpha << writerOptions.atomicRename << std::endl;
+    std::cout << "Fsync: '" << writerOptions.fsync << "'" << std::endl;
+    std::cout << "Schedule: '" << schedule << "'" << std::endl;
     std::cout << "Dry-run: " << std::boolalpha << flagDryRun << std::endl;
     std::cout << "Verbose mode: " << std::boolalpha << flagVerbose << std::endl;
 
@@ -289,141 +398,324 @@ int main(int argc, char** argv)
     }
   }
 
+  // Polyphase has no filter/mask; the other methods need its type.
+  if( ( im_opt->count() > 0 ) && ( interpolationMethod != "polyphase" )
+      && filterType.empty() )
+  {
+    std::cout << "--interp-method requires --downsamp-filter-type" << std::endl;
+    std::cout << "Run with --help for more information." << std::endl;
+    return 1;
+  }
+  if( ( schedule != "largest-first" ) && ( schedule != "list" ) )
+  {
+    std::cout << "Invalid schedule: '" << schedule << "'" << std::endl;
+    return 1;
+  }
+  if( ( writerOptions.fsync != "none" ) && ( writerOptions.fsync != "file" )
+      && ( writerOptions.fsync != "batch" ) )
+  {
+    std::cout << "Invalid fsync policy: '" << writerOptions.fsync << "'" << std::endl;
+    return 1;
+  }
+  if( ( threading != "auto" ) && ( threading != "latency" )
+      && ( threading != "throughput" ) && ( threading != "hybrid" ) )
+  {
+    std::cout << "Invalid threading policy: '" << threading << "'" << std::endl;
+    return 1;
+  }
+  uint32_t rawWidth{0}, rawHeight{0};
+  if( !rawSize.empty() && !parseRawSize( rawSize, &rawWidth, &rawHeight ) )
+  {
+    std::cout << "Invalid raw size, not WxH: '" << rawSize << "'" << std::endl;
+    return 1;
+  }
+
+  NFIR::set_maskCacheCapacity( maskCacheMB * 1024 * 1024 );
+  options.memoryBudget = memoryBudgetMB * 1024 * 1024;
+  try {
+    NFIR::set_fftBackend( fftBackend );
+    if( fftWisdomFile != "" )
+      NFIR::loadFFTWisdom( fftWisdomFile );
+  }
+  catch( const NFIR::Miscue &e ) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+
   auto startStamp = std::chrono::system_clock::now();
   std::time_t startTime = std::chrono::system_clock::to_time_t( startStamp );
-  std::string tgtFname;
 
   #ifdef USE_NFIMM
   vecPngTextChunk.push_back( "Description:image resamp from "
     + std::to_string(srcSampleRate) + "PPI by NFIRv" + NFIR::getVersion() );
   #endif
 
-  // START LOOP through all src images.
-  for( auto it:listSrcImages )
+  NFIR::PipelineOptions pipelineOptions;
+  pipelineOptions.queueDepth = queueDepth;
+  pipelineOptions.readAhead = readAhead;
+
+  // Console reports are built per image and printed whole under the lock,
+  // so reports of concurrent images do not interleave.
+  std::mutex consoleMutex;
+  // Source files are prefetched so that reading overlaps resampling.
+  std::vector<bool> prefetched( listSrcImages.size(), false );
+  bool batchFailed{false};
+  std::string loadBalance;  // summary of the resample workers
+  std::string threadingSummary;
+  const bool colorConsole = termcolor::_internal::is_atty( std::cout );
+
+  auto buildTargetPath = [&]( const std::string &srcPath ) -> std::string
   {
-    if( srcFile != "" ) {   // source image specific by name in config
-      tgtPath = tgtFile;
-    }
-    else {                  // source image(s) specified by dir in config
-      tgtFname = buildTargetImageFilename( it, tgtImageFormat );
-      tgtPath = tgtDir + tgtFname;
+    if( srcFile != "" )     // source image specific by name in config
+      return tgtFile;
+    else                    // source image(s) specified by dir in config
+      return tgtDir + buildTargetImageFilename( srcPath, tgtImageFormat );
+  };
+
+  // Raw images have no header: the size is that of --raw-size, or of the
+  // sidecar next to each image.
+  auto readRawSize = [&]( const std::string &srcPath,
+                          uint32_t *width, uint32_t *height ) -> bool
+  {
+    if( rawWidth > 0 ) {
+      *width = rawWidth;
+      *height = rawHeight;
+      return true;
     }
+    return readRawSidecar( srcPath, width, height );
+  };
+
+  auto startReport = [&]( std::ostringstream &report,
+                          const std::string &srcPath, const std::string &tgtPath )
+  {
+    if( colorConsole )
+      report << termcolor::colorize;
+    report << termcolor::blue
+           << "-------------------------------------------" << std::endl;
+    report << "src image: " << srcPath << std::endl;
+    report << "tgt image: " << tgtPath
+           << termcolor::grey << std::endl;
+  };
 
-    // Load file into memory (block); get its length
-    char *srcFileMemBlock;
-    std::ifstream ifsSrcFile( it, std::ios::binary );
-    ifsSrcFile.seekg( 0, std::ios::end );
-    uint64_t lenSrcFileBlock = ifsSrcFile.tellg();
-    ifsSrcFile.seekg( 0, std::ios::beg );
-    srcFileMemBlock = new char[lenSrcFileBlock];
-    ifsSrcFile.read( srcFileMemBlock, lenSrcFileBlock );
-    ifsSrcFile.close();
-
-    srcPath = it;
-    std::cout << termcolor::blue
-              << "-------------------------------------------" << std::endl;
-    std::cout << "src image: " << srcPath << std::endl;
-    std::cout << "tgt image: " << tgtPath
-              << termcolor::grey << std::endl;
-
-    // Init NFIR resampler params.
-    uint8_t* srcImageAry{NULL};       // source image data
-    uint8_t* tmpImg{NULL};            // resampled image data
-    uint8_t** tgtImageAry{&tmpImg};   // pointer to resampled image data
-    uint32_t imageWidth{0};           // source IN and target OUT
-    uint32_t imageHeight{0};          // source IN and target OUT
-    std::vector<std::string>logRuntime;  // container for all log messages
-
-
-    // Copy the file stream into memory for resampler call.
-    srcImageAry = new uint8_t[lenSrcFileBlock];
-    memcpy( srcImageAry, srcFileMemBlock, lenSrcFileBlock );
-
-
-    if( !flagDryRun )
+  // START LOOP through all src images.
+  if( flagDryRun )
+  {
+    for( auto it:listSrcImages )
     {
+      std::string tgtPath = buildTargetPath( it );
+      std::ostringstream report;
+      startReport( report, it, tgtPath );
       try {
-        // Ensure the output image file can be opened and therefore written.
-        std::ofstream outFile( tgtPath, std::ios::out | std::ios::binary );
-        if( outFile.is_open() )
-        {
-          NFIR::resample( srcImageAry, tgtImageAry,
-                        srcSampleRate, tgtSampleRate, "inch",
-                        interpolationMethod, filterType,
-                        &imageWidth, &imageHeight, &lenSrcFileBlock,
-                        srcImageFormat, tgtImageFormat, vecPngTextChunk,
-                        logRuntime );
-          // Note: lenSrcFileBlock contains length of the generated, target
-          // image buffer as returned from the NFIR::resample(...) call above.
-          outFile.write( reinterpret_cast<char*>(*tgtImageAry), lenSrcFileBlock );
-          outFile.close();
-        }
-        else
-        {
-          throw NFIR::Miscue( "Cannot open file for write: " + tgtPath );
+        SourceFile srcFileMemBlock( it );
+      }
+      catch( const NFIR::Miscue &e ) {
+        std::cout << report.str() << termcolor::red << e.what()
+                  << termcolor::grey << std::endl;
+        return -1;
+      }
+      tmp_count += 1;
+      if( flagVerbose )
+      {
+        report << "dry-run srcPath: " << it << std::endl;
+        report << "dry-run tgtPath: " << tgtPath << std::endl;
+        report << "dry-run count: " << tmp_count << " of " << listSrcImages.size() << std::endl;
+      }
+      std::cout << report.str() << std::flush;
+    }
+  }
+  else
+  {
+    // Reader threads: prefetch, map the file into memory; the library
+    // decodes straight from the mapping.
+    auto readSourceImage = [&]( NFIR::PipelineItem &item )
+    {
+      {
+        std::lock_guard<std::mutex> lock( consoleMutex );
+        // Each of the files read next, in schedule order, is prefetched once.
+        for( size_t next : item.readAhead ) {
+          if( !prefetched[next] ) {
+            prefetched[next] = true;
+            prefetchSourceFile( listSrcImages[next] );
+          }
         }
-        tmp_count += 1;
+      }
+      const std::string &srcPath = listSrcImages[item.index];
+      if( ( srcImageFormat == "raw" )
+          && !readRawSize( srcPath, &item.sourceWidth, &item.sourceHeight ) )
+        throw NFIR::Miscue( "Raw image size unknown, set --raw-size or write "
+                            + srcPath + ".dims" );
+      auto srcFileMemBlock = std::make_shared<SourceFile>( srcPath );
+      item.source = srcFileMemBlock->data();
+      item.sourceSize = srcFileMemBlock->size();
+      item.sourceHold = srcFileMemBlock;
+    };
+
+    // Reports an image once its target is written, or has failed.
+    auto reportImage = [&]( size_t index, const std::string &tgtPath,
+                            const std::vector<std::string> &log,
+                            const std::string &error )
+    {
+      const std::string &srcPath = listSrcImages[index];
+      std::ostringstream report;
+      startReport( report, srcPath, tgtPath );
 
-        // {
-        //   // Access for the intermediate, filtered image prior to downsample.
-        //   // Uncomment this scope/section and set the filteredPath appropriately.
-        //   NFIR::get_filteredImage( tgtImageAry, srcImageFormat, &lenSrcFileBlock, &imageWidth, &imageHeight );
-        //   std::cout << "intermediate image Width:  " << imageWidth << std::endl;
-        //   std::cout << "intermediate image Height: " << imageHeight << std::endl;
-        //   std::cout << "intermediate image vector length: " << lenSrcFileBlock << std::endl;
-        //   std::string filteredPath{""};
-        //   std::ofstream outFileIntermediateImage( filteredPath, std::ios::out | std::ios::binary );
-        //   if( outFileIntermediateImage.is_open() )
-        //   {
-        //     outFileIntermediateImage.write( reinterpret_cast<char*>(*tgtImageAry), lenSrcFileBlock );
-        //     outFile.close();
-        //   }
-        //   else
-        //   {
-        //     throw NFIR::Miscue( "Cannot open file for write: " + filteredPath );
-        //   }
-        // }
+      // The pipeline does not keep the filtered image prior to downsample;
+      // call NFIR::resample() per image and see NFIR::Result for it.
 
+      std::lock_guard<std::mutex> lock( consoleMutex );
+      if( !error.empty() )
+      {
+        batchFailed = true;
+        report << termcolor::red << srcPath << ": " << error << std::endl;
+        if( !log.empty() )
+        {
+          report << "NFIR runtime log prior-to this exception:" << std::endl;
+          for( auto s : log ) { report << s << std::endl; }
+        }
+        report << termcolor::grey;
       }
-      catch( const NFIR::Miscue &e ) {
-        std::cout << termcolor::red << e.what() << std::endl;
-        if( !logRuntime.empty() )
+      else
+      {
+        tmp_count += 1;
+        if( flagVerbose )
         {
-          std::cout << "NFIR runtime log prior-to this exception:" << std::endl;
-          for( auto s : logRuntime ) { std::cout << s << std::endl; }
+          report << "srcPath: " << srcPath << std::endl;
+          report << "tgtPath: " << tgtPath << std::endl;
+          for( auto s : log ) { report << s << std::endl; }
+          report << "RESAMPLE complete: " << tmp_count << " of " << listSrcImages.size() << std::endl;
         }
-        std::cout << termcolor::grey;
-        return -1;
       }
-    }   // END flagDryRun
-
-    if( flagVerbose )
+      std::cout << report.str() << std::flush;
+    };
+
+    // Source dimensions from the image headers, for the schedule and the
+    // threading policy; the few unrecognized images are costed as average.
+    std::vector<double> costs;
+    uint64_t maxImagePixels{0};
+    if( ( listSrcImages.size() > 1 )
+        && ( ( schedule == "largest-first" ) || ( threading == "auto" ) ) )
     {
-      if( flagDryRun )
+      double knownCost{0.0};
+      size_t numKnown{0};
+      for( auto it:listSrcImages )
       {
-        tmp_count += 1;
-        std::cout << "dry-run srcPath: " << srcPath << std::endl;
-        std::cout << "dry-run tgtPath: " << tgtPath << std::endl;
-        std::cout << "dry-run count: " << tmp_count << " of " << listSrcImages.size() << std::endl;
+        uint32_t width{0}, height{0};
+        costs.push_back( 0.0 );
+        bool known = ( srcImageFormat == "raw" ) ? readRawSize( it, &width, &height )
+                                                 : readSourceSize( it, &width, &height );
+        if( known )
+        {
+          costs.back() = NFIR::get_resampleCost( srcSampleRate, tgtSampleRate,
+                                                 width, height );
+          maxImagePixels = std::max( maxImagePixels, (uint64_t)width * height );
+        }
+        if( costs.back() > 0.0 ) {
+          knownCost += costs.back();
+          numKnown++;
+        }
       }
+      for( auto &c : costs )
+        if( c <= 0.0 )
+          c = ( numKnown > 0 ) ? knownCost / numKnown : 1.0;
+    }
+
+    NFIR::ThreadingPlan plan = NFIR::resolveThreadingPolicy(
+        threading, listSrcImages.size(), maxImagePixels, jobs );
+    // The plan sets every thread count not given on the command line.
+    pipelineOptions.workers = plan.workers;
+    pipelineOptions.openCVThreads = plan.openCVThreads;
+    pipelineOptions.readers = ( readers > 0 ) ? readers : plan.readers;
+    pipelineOptions.writers = ( writers > 0 ) ? writers : plan.writers;
+    writerOptions.threads = ( writeThreads >= 0 ) ? (size_t)writeThreads
+                                                   : plan.writeThreads;
+    threadingSummary = plan.to_s();
+
+    // Declared after reportImage, which its Completions call, also while
+    // it is destroyed.
+    NFIR::TargetWriter targetWriter( writerOptions );
+
+    // Pipeline writer threads: hand the encoded target, or the mapped file
+    // it was resampled into, to the write-behind writer, which owns it from
+    // then on, and reports it once written.  Raw dimensions go to the
+    // sidecar, for the next stage to read the target back.
+    auto writeTargetImage = [&]( NFIR::PipelineItem &item ) -> bool
+    {
+      std::string tgtPath = buildTargetPath( listSrcImages[item.index] );
+      if( !item.error.empty() )
+        reportImage( item.index, tgtPath, item.log, item.error );
       else
       {
-        std::cout << "srcPath: " << srcPath << std::endl;
-        std::cout << "tgtPath: " << tgtPath << std::endl;
-        for( auto s : logRuntime ) { std::cout << s << std::endl; }
-        std::cout << "RESAMPLE complete: " << tmp_count << " of " << listSrcImages.size() << std::endl;
+        const size_t index = item.index;
+        if( tgtImageFormat == "raw" )
+        {
+          std::string dims = std::to_string(item.result.width) + "x"
+                           + std::to_string(item.result.height) + "\n";
+          targetWriter.submit( tgtPath + ".dims",
+                               std::vector<uint8_t>( dims.begin(), dims.end() ),
+                               [&reportImage, index, tgtPath]( const std::string &error ) {
+                                 if( !error.empty() )
+                                   reportImage( index, tgtPath + ".dims", {}, error );
+                               } );
+        }
+        auto log = std::make_shared<std::vector<std::string>>( std::move( item.log ) );
+        auto completion = [&reportImage, index, tgtPath, log]( const std::string &error ) {
+          reportImage( index, tgtPath, *log, error );
+        };
+        if( item.targetHold )
+          targetWriter.submit( std::static_pointer_cast<NFIR::MappedTarget>( item.targetHold ),
+                               completion );
+        else
+          targetWriter.submit( tgtPath, std::move( item.target ), completion );
       }
-    }
 
-    // clean up
-    delete [] srcFileMemBlock;
-    delete [] srcImageAry;
-    delete [] *tgtImageAry;
-      // char key_press{};
-      // std::cin >> key_press;
+      std::lock_guard<std::mutex> lock( consoleMutex );
+      return !batchFailed;
+    };
+
+    NFIR::Pipeline pipeline( srcSampleRate, tgtSampleRate, "inch",
+                             interpolationMethod, filterType,
+                             srcImageFormat, tgtImageFormat, vecPngTextChunk,
+                             options, pipelineOptions );
+    // Uncompressed targets: the workers resample straight into the target
+    // file, created at its size and mapped; should that fail, the target
+    // is encoded and written instead.
+    if( ( tgtImageFormat == "raw" ) || ( tgtImageFormat == "pgm" ) )
+      pipeline.set_targetAllocator(
+        [&]( NFIR::PipelineItem &item, size_t size ) -> uint8_t* {
+          auto target = targetWriter.map( buildTargetPath( listSrcImages[item.index] ),
+                                          size );
+          item.targetHold = target;
+          return target ? target->data() : nullptr;
+        } );
+    if( ( schedule == "largest-first" ) && !costs.empty() )
+      pipeline.run( costs, readSourceImage, writeTargetImage );
+    else
+      pipeline.run( listSrcImages.size(), readSourceImage, writeTargetImage );
+    loadBalance = pipeline.get_stats().to_s();
 
+    // Wait for the writes behind, and sync them per the fsync policy.
+    try {
+      targetWriter.finish();
+    }
+    catch( const NFIR::Miscue &e ) {
+      std::cout << termcolor::red << e.what() << termcolor::grey << std::endl;
+      batchFailed = true;
+    }
   }   // END LOOP through all src images.
 
+  if( batchFailed )
+    return -1;
+
+  if( fftWisdomFile != "" )
+  {
+    try {
+      NFIR::saveFFTWisdom( fftWisdomFile );
+    }
+    catch( const NFIR::Miscue &e ) {
+      std::cout << e.what() << std::endl;
+    }
+  }
+
   std::chrono::system_clock::time_point endStamp = std::chrono::system_clock::now();
   std::time_t endTime = std::chrono::system_clock::to_time_t( endStamp );
 
@@ -433,6 +725,10 @@ int main(int argc, char** argv)
   std::cout << "Started resample: " << std::ctime(&startTime);
   std::cout << "Finished resample: " << std::ctime(&endTime)
             << "Elapsed time: " << elapsedSeconds.count() << "s\n";
+  if( !threadingSummary.empty() )
+    std::cout << threadingSummary << std::endl;
+  if( !loadBalance.empty() )
+    std::cout << loadBalance << std::endl;
   return 0;
 }
 
@@ -515,3 +811,141 @@ void retrieveSourceImagesList( const std::string &dir, const std::string &fmt, s
 
   std::sort( v.begin(), v.end() );
 }
+
+
+/**
+ * @param path of source image
+ *
+ * @throw NFIR::Miscue cannot open, stat, or map the file
+ */
+SourceFile::SourceFile( const std::string &path )
+{
+#ifdef _WIN32_64
+  std::ifstream ifs( path, std::ios::binary | std::ios::ate );
+  if( !ifs.is_open() )
+    throw NFIR::Miscue( "Cannot open file for read: " + path );
+  _buffer.resize( (size_t)ifs.tellg() );
+  ifs.seekg( 0, std::ios::beg );
+  ifs.read( reinterpret_cast<char*>( _buffer.data() ), _buffer.size() );
+  _data = _buffer.data();
+  _size = _buffer.size();
+#else
+  int fd = open( path.c_str(), O_RDONLY );
+  if( fd < 0 )
+    throw NFIR::Miscue( "Cannot open file for read: " + path );
+  struct stat st;
+  if( fstat( fd, &st ) != 0 )
+  {
+    close( fd );
+    throw NFIR::Miscue( "Cannot stat file: " + path );
+  }
+  _size = (size_t)st.st_size;
+  if( _size > 0 )
+  {
+    void *addr = mmap( nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if( addr == MAP_FAILED )
+    {
+      close( fd );
+      throw NFIR::Miscue( "Cannot map file: " + path );
+    }
+    // The decoder reads the file once, front to back.
+    madvise( addr, _size, MADV_SEQUENTIAL );
+    madvise( addr, _size, MADV_WILLNEED );
+    _data = static_cast<const uint8_t*>( addr );
+  }
+  close( fd );   // the mapping stays valid
+#endif
+}
+
+SourceFile::~SourceFile()
+{
+#ifndef _WIN32_64
+  if( _data != nullptr )
+    munmap( const_cast<uint8_t*>( _data ), _size );
+#endif
+}
+
+/**
+ * @brief Ask the OS to start reading a file into the page cache.
+ *
+ * Returns immediately; errors are ignored, the file is opened again when
+ * its turn comes.  No-op on Windows.
+ *
+ * @param path of source image
+ */
+void prefetchSourceFile( const std::string &path )
+{
+#ifdef _WIN32_64
+  (void)path;
+#else
+  int fd = open( path.c_str(), O_RDONLY );
+  if( fd < 0 )
+    return;
+  posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED );
+  close( fd );
+#endif
+}
+
+/**
+ * @brief Width and height of a source image, from its header.
+ *
+ * Only the first bytes of the file are read; see NFIR::get_imageSize().
+ *
+ * @param path of source image
+ * @param width OUT pixels
+ * @param height OUT pixels
+ *
+ * @return false if the file cannot be read or its format is not recognized
+ */
+bool readSourceSize( const std::string &path, uint32_t *width, uint32_t *height )
+{
+  uint8_t header[512];
+  std::ifstream ifs( path, std::ios::binary );
+  if( !ifs.is_open() )
+    return false;
+  ifs.read( reinterpret_cast<char*>( header ), sizeof(header) );
+
+  return NFIR::get_imageSize( header, (size_t)ifs.gcount(), width, height );
+}
+
+/**
+ * @brief Width and height from `WxH`, eg, `1600x1500`.
+ *
+ * @param s text
+ * @param width OUT pixels
+ * @param height OUT pixels
+ *
+ * @return false if not two positive integers separated by `x`
+ */
+bool parseRawSize( const std::string &s, uint32_t *width, uint32_t *height )
+{
+  unsigned long w{0}, h{0};
+  char x{0}, extra{0};
+  std::istringstream iss( s );
+  if( !( iss >> w >> x >> h ) || ( x != 'x' ) || ( iss >> extra ) )
+    return false;
+  if( ( w == 0 ) || ( h == 0 ) || ( w > INT32_MAX ) || ( h > INT32_MAX ) )
+    return false;
+  *width = (uint32_t)w;
+  *height = (uint32_t)h;
+  return true;
+}
+
+/**
+ * @brief Width and height of a raw image from its sidecar, `<image>.dims`,
+ * one line `WxH`.
+ *
+ * @param imagePath of the raw image
+ * @param width OUT pixels
+ * @param height OUT pixels
+ *
+ * @return false if there is no sidecar, or it is not `WxH`
+ */
+bool readRawSidecar( const std::string &imagePath, uint32_t *width, uint32_t *height )
+{
+  std::ifstream ifs( imagePath + ".dims" );
+  std::string line;
+  if( !ifs.is_open() || !std::getline( ifs, line ) )
+    return false;
+  return parseRawSize( line, width, height );
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace NFIR {
+
+/**
+ * @brief Fixed-capacity, blocking, multi-producer multi-consumer FIFO.
+ *
+ * push() blocks while the queue is full, so a fast producer cannot run
+ * ahead of its consumers by more than the capacity.  pop() blocks while the
+ * queue is empty and not closed.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  /** @brief Capacity is at least one */
+  explicit BoundedQueue( size_t capacity )
+    : _capacity{ std::max( (size_t)1, capacity ) } {}
+
+  BoundedQueue( const BoundedQueue& ) = delete;
+  BoundedQueue& operator=( const BoundedQueue& ) = delete;
+
+  /** @brief Append; waits for room */
+  void push( T item )
+  {
+    std::unique_lock<std::mutex> lock( _mutex );
+    _notFull.wait( lock, [this] { return _items.size() < _capacity; } );
+    _items.push_back( std::move( item ) );
+    _notEmpty.notify_one();
+  }
+
+  /**
+   * @brief Remove the front item into OUT param; waits for one.
+   *
+   * @return false once the queue is closed and empty
+   */
+  bool pop( T &item )
+  {
+    std::unique_lock<std::mutex> lock( _mutex );
+    _notEmpty.wait( lock, [this] { return !_items.empty() || _closed; } );
+    if( _items.empty() )
+      return false;
+    item = std::move( _items.front() );
+    _items.pop_front();
+    _notFull.notify_one();
+    return true;
+  }
+
+  /** @brief No more items will be pushed; wakes all waiting consumers */
+  void close(void)
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _closed = true;
+    _notEmpty.notify_all();
+  }
+
+private:
+  /** @brief Maximum number of items queued */
+  const size_t _capacity;
+  /** @brief Front is the oldest */
+  std::deque<T> _items;
+  /** @brief Set by close() */
+  bool _closed{false};
+
+  /** @brief Guards all members */
+  std::mutex _mutex;
+  /** @brief Signalled by pop() */
+  std::condition_variable _notFull;
+  /** @brief Signalled by push() and close() */
+  std::condition_variable _notEmpty;
+};
+
+}   // End namespace
@@ -0,0 +1,116 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "exceptions.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <complex>
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+/**
+ * @brief Interface to a 2-D real-input DFT implementation.
+ *
+ * All backends take and return the OpenCV layouts: the forward transform of
+ * a real, CV_32F image is the CCS packed spectrum of the same size, as from
+ * `cv::dft( src, dst )`; the inverse of a packed spectrum is the real image,
+ * as from `cv::dft( src, dst, cv::DFT_INVERSE | cv::DFT_REAL_OUTPUT )`.
+ * Neither direction is scaled.
+ *
+ * Backends reuse their plans per transform size.  All methods are
+ * thread-safe; tiles may be transformed concurrently.
+ *
+ * The backend for a transform is chosen by select(): either the preferred
+ * backend, or for `auto` the fastest one for that size.  The fastest backend
+ * is measured once per size and kept as "wisdom", which can be saved to and
+ * loaded from a file so that fixed scanner geometries are measured only once.
+ */
+class FFTBackend
+{
+public:
+  /** @brief Virtual destructor */
+  virtual ~FFTBackend() {}
+
+  /** @brief Backend name as used by set_preferred() */
+  virtual std::string get_name(void) const = 0;
+
+  /** @brief Real CV_32F image to CCS packed spectrum, unscaled */
+  virtual void forward( const cv::Mat&, cv::Mat& ) = 0;
+
+  /** @brief CCS packed spectrum to real CV_32F image, unscaled */
+  virtual void inverse( const cv::Mat&, cv::Mat& ) = 0;
+
+  /** @brief Number of cached plans, for logging */
+  virtual size_t get_planCount(void) const = 0;
+
+  /** @brief Transform size supported; default is any size */
+  virtual bool supports( cv::Size ) const;
+
+  /** @brief Names of the backends compiled in */
+  static std::vector<std::string> get_available(void);
+
+  /** @brief `auto` or one of get_available() */
+  static void set_preferred( const std::string& );
+
+  /** @brief Current preference */
+  static std::string get_preferred(void);
+
+  /** @brief Backend to use for a transform of this size */
+  static FFTBackend& select( cv::Size );
+
+  /** @brief Read fastest-backend-per-size (and backend plan) wisdom */
+  static void loadWisdom( const std::string& );
+
+  /** @brief Write fastest-backend-per-size (and backend plan) wisdom */
+  static void saveWisdom( const std::string& );
+
+  /** @brief Preference, wisdom, and plan counts for logging */
+  static std::string to_s(void);
+
+protected:
+  /** @brief Half spectrum, N x (M/2 + 1) complex, to CCS packed N x M */
+  static void packHalfSpectrum( const std::complex<float>*, cv::Mat& );
+
+  /** @brief CCS packed N x M to half spectrum, N x (M/2 + 1) complex */
+  static void unpackHalfSpectrum( const cv::Mat&, std::complex<float>* );
+
+  /** @brief Backend plan wisdom, if the backend has any; default none */
+  virtual void importWisdom( const std::string& ) {}
+  /** @brief Backend plan wisdom, if the backend has any; default none */
+  virtual void exportWisdom( const std::string& ) const {}
+
+private:
+  /** @brief Time each backend on a transform of this size */
+  static std::string benchmark( cv::Size );
+};
+
+}   // End namespace
@@ -0,0 +1,80 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "fft_backend.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace NFIR {
+
+/**
+ * @brief Self-contained mixed-radix FFT; no dependencies.
+ *
+ * Complex FFT by recursive decimation in time, radix 4 and radix 2
+ * butterflies and a generic butterfly for radices 3, 5 and any other prime.
+ * The 2-D real transform does two image rows per complex row transform, then
+ * the column transforms of the half spectrum.
+ *
+ * Plans (factorization and twiddles) are immutable and cached per length.
+ * The row, column and half spectrum buffers are kept per thread and reused.
+ * Sizes must be even in both dimensions, as all NFIR transform sizes are.
+ */
+class BuiltinFFT : public FFTBackend
+{
+public:
+  std::string get_name(void) const override;
+  void forward( const cv::Mat&, cv::Mat& ) override;
+  void inverse( const cv::Mat&, cv::Mat& ) override;
+  size_t get_planCount(void) const override;
+  bool supports( cv::Size ) const override;
+
+  /** @brief 1-D complex transform plan */
+  struct Plan
+  {
+    /** @brief Length */
+    int n;
+    /** @brief Pairs of (radix, remaining length) per stage */
+    std::vector<int> factors;
+    /** @brief exp(-2 pi i k/n), k = 0..n-1 */
+    std::vector<std::complex<float>> twiddles;
+  };
+
+private:
+  /** @brief Guards the plans */
+  mutable std::mutex _mutex;
+  /** @brief Plans per length */
+  std::map<int, std::shared_ptr<const Plan>> _plans;
+
+  /** @brief Get or build the plan for a length */
+  std::shared_ptr<const Plan> acquire( int );
+};
+
+}   // End namespace
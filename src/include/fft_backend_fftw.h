@@ -0,0 +1,79 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#ifdef USE_FFTW
+
+#include "fft_backend.h"
+
+#include <fftw3.h>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace NFIR {
+
+/**
+ * @brief FFTW single-precision real transforms, `fftw3f`.
+ *
+ * Available when FFTW is found at configure time, see option USE_FFTW.
+ * Plans are created with FFTW_MEASURE once per size and direction and
+ * executed on aligned copies of the data (new-array execute), so one plan
+ * serves all threads.  FFTW plan wisdom is saved and loaded with the NFIR
+ * wisdom file, in a sidecar with suffix `.fftw`.
+ */
+class FFTWBackend : public FFTBackend
+{
+public:
+  /** @brief Destroys the plans */
+  virtual ~FFTWBackend();
+
+  std::string get_name(void) const override;
+  void forward( const cv::Mat&, cv::Mat& ) override;
+  void inverse( const cv::Mat&, cv::Mat& ) override;
+  size_t get_planCount(void) const override;
+  bool supports( cv::Size ) const override;
+
+protected:
+  void importWisdom( const std::string& ) override;
+  void exportWisdom( const std::string& ) const override;
+
+private:
+  /** @brief FFTW planner is not thread-safe; guards the plans, too */
+  mutable std::mutex _mutex;
+  /** @brief Plans per (rows, cols, inverse) */
+  std::map<std::tuple<int,int,bool>, fftwf_plan> _plans;
+
+  /** @brief Get or create the plan */
+  fftwf_plan acquire( int, int, bool );
+};
+
+}   // End namespace
+
+#endif
@@ -53,8 +53,15 @@ public:
 protected:
   /** @brief (float)_tgtSampleRate / (float)_srcSampleRate */
   double _maskRadiusFactor;
+  /** @brief Padded image width and height the mask was built for */
+  cv::Size _maskSize;
   /** @brief The low pass filter */
   cv::Mat _theFilterMask;
+  /**
+   * @brief The low pass filter rearranged to match the packed (CCS) spectrum
+   * of a real-valued image, see pack()
+   */
+  cv::Mat _thePackedFilterMask;
 
   /** @brief source image resolution */
   int _srcSampleRate;
@@ -67,6 +74,12 @@ protected:
   /** @brief Copy function to make clones of an object */
   void Copy( const FilterMask& );
 
+  /** @brief Rearrange the built filter/mask into the packed (CCS) layout */
+  void pack(void);
+
+  /** @brief Throw unless the packed spectrum is of the mask size */
+  void checkPackedSize( const cv::Mat& ) const;
+
 public:
   /** @brief Default constructor never used */
   FilterMask();
@@ -86,6 +99,20 @@ public:
   /** @brief Build the filter/mask; implemented in subclass */
   virtual void build( cv::Size );
 
+  /** @brief Get the filter/mask from the cache, or build and cache it */
+  bool acquire( cv::Size );
+
+  /** @brief Multiply a packed (CCS) spectrum by the scaled filter/mask in place */
+  virtual void applyPacked( cv::Mat&, float ) const;
+  /** @brief Filter/mask value of one frequency, point-symmetric part */
+  virtual float get_value( int, int ) const;
+  /** @brief Compact representation of the built filter/mask for the cache */
+  virtual cv::Mat get_cacheEntry(void) const;
+  /** @brief Restore the filter/mask from its cached representation */
+  virtual void set_cacheEntry( cv::Size, cv::Mat );
+  /** @brief Separable space-domain equivalent, if the filter/mask has one */
+  virtual bool get_spatialKernels( cv::Mat&, cv::Mat&, float& ) const;
+
   /** @brief Setter method */
   void set_srcSampleRate( const int& );
   /** @brief Setter method */
@@ -99,7 +126,9 @@ public:
   /** @brief tgtSampleRate / srcSampleRate */
   double get_maskRadiusFactor(void) const;
   /** @brief Getter method */
-  cv::Mat get_theFilterMask(void) const;
+  virtual cv::Mat get_theFilterMask(void) const;
+  /** @brief Filter/mask to multiply with a packed (CCS) real-input spectrum */
+  cv::Mat get_thePackedFilterMask(void) const;
 
   /** @brief Implement a clone operator */
   FilterMask Clone(void);
@@ -0,0 +1,133 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "filter_mask.h"
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace NFIR {
+
+/**
+ * @brief Process-wide cache of built filter/masks.
+ *
+ * Scanner batches are mostly one geometry at one sample rate, so the same
+ * filter/mask is built over and over.  The cache is keyed by the padded image
+ * size, the source and target sample rates, and the filter type.
+ *
+ * Entries are evicted least-recently-used first when the total size of the
+ * cached masks exceeds the capacity.  A mask that by itself exceeds the
+ * capacity is not cached.
+ *
+ * All methods are thread-safe.  A hit returns a cv::Mat header that shares
+ * its data with the cache; it is read-only and must not be modified.
+ */
+class FilterMaskCache
+{
+public:
+  /** @brief Identifies a filter/mask */
+  struct Key {
+    /** @brief Padded image rows */
+    int rows;
+    /** @brief Padded image cols */
+    int cols;
+    /** @brief Source image resolution */
+    int srcSampleRate;
+    /** @brief Target image resolution */
+    int tgtSampleRate;
+    /** @brief Ideal or Gaussian */
+    FilterMask::FilterType filterType;
+
+    /** @brief Strict weak ordering for std::map */
+    bool operator<( const Key &k ) const
+    {
+      return std::tie( rows, cols, srcSampleRate, tgtSampleRate, filterType )
+           < std::tie( k.rows, k.cols, k.srcSampleRate, k.tgtSampleRate,
+                       k.filterType );
+    }
+  };
+
+  /** @brief Default capacity in bytes, 256 MiB */
+  static constexpr size_t defaultCapacity{ (size_t)256 * 1024 * 1024 };
+
+  /** @brief The single, process-wide instance */
+  static FilterMaskCache& instance(void);
+
+  /** @brief Copy the cached mask into OUT param; counts a hit or miss */
+  bool lookup( const Key&, cv::Mat& );
+
+  /** @brief Add a mask, evict least-recently-used masks as necessary */
+  void insert( const Key&, const cv::Mat& );
+
+  /** @brief Remove all masks; hit and miss counts are kept */
+  void clear(void);
+
+  /** @brief Set the memory cap in bytes; zero disables the cache */
+  void set_capacity( size_t );
+
+  /** @brief Getter method */
+  size_t get_capacity(void) const;
+  /** @brief Number of lookups that found a mask */
+  uint64_t get_hits(void) const;
+  /** @brief Number of lookups that did not find a mask */
+  uint64_t get_misses(void) const;
+
+  /** @brief Cache statistics for logging */
+  std::string to_s(void) const;
+
+private:
+  FilterMaskCache();
+  FilterMaskCache( const FilterMaskCache& ) = delete;
+  FilterMaskCache& operator=( const FilterMaskCache& ) = delete;
+
+  /** @brief Evict least-recently-used masks until size fits the capacity */
+  void evict(void);
+
+  /** @brief Most-recently-used at front */
+  std::list<std::pair<Key, cv::Mat>> _lru;
+  /** @brief Index into the LRU list */
+  std::map<Key, std::list<std::pair<Key, cv::Mat>>::iterator> _index;
+
+  /** @brief Total bytes of all cached masks */
+  size_t _size;
+  /** @brief Memory cap in bytes */
+  size_t _capacity;
+  /** @brief Lookup counts */
+  uint64_t _hits;
+  /** @brief Lookup counts */
+  uint64_t _misses;
+
+  /** @brief Guards all members */
+  mutable std::mutex _mutex;
+};
+
+}   // End namespace
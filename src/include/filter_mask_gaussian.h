@@ -31,13 +31,30 @@ identified are necessarily the best available for the purpose.
 
 namespace NFIR {
 
-/** @brief Support the Gaussian lowpass filter used for downsample. */
+/**
+ * @brief Support the Gaussian lowpass filter used for downsample.
+ *
+ * The 2-dimensional Gaussian is the outer product of two 1-dimensional
+ * Gaussians.  Only the two 1-D profiles are kept, already in FFT (unshifted)
+ * order; the mask value of each frequency is formed on the fly while the
+ * spectrum is multiplied.  A full, width x height mask is never built for
+ * the downsample.
+ */
 class Gaussian : public FilterMask
 {
 private:
   /** @brief Current instance */
   FilterType _filterType;
 
+  /**
+   * @brief One row of floats: the row profile (N values, by row frequency),
+   * the column profile (M values, by packed CCS column), and the offset.
+   *
+   * Mask value at (u,v) is `rowProfile[u] * colProfile[v] + offset`.  The
+   * min-max normalization is folded into the row profile and the offset.
+   */
+  cv::Mat _profiles;
+
 public:
   /** @brief Default constructor never used */
   Gaussian() = delete;
@@ -54,9 +71,23 @@ public:
   /** @brief Getter method */
   FilterType get_filterType(void) const override;
 
-  /** @brief Build the Gaussian filter upenCV Gaussian kernel generator */
+  /** @brief Build the Gaussian filter profiles using OpenCV Gaussian kernel generator */
   void build( cv::Size ) override;
 
+  /** @brief Multiply by the separable mask, formed on the fly */
+  void applyPacked( cv::Mat&, float ) const override;
+  /** @brief Mask value from the two profiles */
+  float get_value( int, int ) const override;
+  /** @brief The two profiles and offset */
+  cv::Mat get_cacheEntry(void) const override;
+  /** @brief Restore the two profiles and offset */
+  void set_cacheEntry( cv::Size, cv::Mat ) override;
+  /** @brief Inverse DFT of the two profiles, truncated */
+  bool get_spatialKernels( cv::Mat&, cv::Mat&, float& ) const override;
+
+  /** @brief Full-size, normalized and shifted mask; built on demand */
+  cv::Mat get_theFilterMask(void) const override;
+
   /** @brief Implement a clone operator */
   Gaussian Clone(void);
 
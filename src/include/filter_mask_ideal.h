@@ -31,12 +31,25 @@ identified are necessarily the best available for the purpose.
 
 namespace NFIR {
 
-/** @brief Support the ideal lowpass filter used for downsample. */
+/**
+ * @brief Support the ideal lowpass filter used for downsample.
+ *
+ * The mask is 1.0 inside an ellipse and 0.0 outside.  For each row
+ * frequency, the ellipse covers a single, symmetric interval of column
+ * frequencies; only the half-width of that interval is kept per row.  The
+ * mask is applied by zeroing the spectrum outside the interval.
+ */
 class Ideal : public FilterMask
 {
 private:
   FilterType _filterType;
 
+  /**
+   * @brief One row of ints: per row frequency u, the largest column
+   * frequency inside the ellipse, or -1 if none.
+   */
+  cv::Mat _halfWidths;
+
 public:
   /** @brief Default constructor never used */
   Ideal() = delete;
@@ -62,6 +75,18 @@ public:
    */
   void build( cv::Size ) override;
 
+  /** @brief Zero the spectrum outside the ellipse, scale inside */
+  void applyPacked( cv::Mat&, float ) const override;
+  /** @brief 1.0 inside the ellipse, 0.0 outside */
+  float get_value( int, int ) const override;
+  /** @brief Per-row half-widths */
+  cv::Mat get_cacheEntry(void) const override;
+  /** @brief Restore per-row half-widths */
+  void set_cacheEntry( cv::Size, cv::Mat ) override;
+
+  /** @brief Full-size mask; built on demand */
+  cv::Mat get_theFilterMask(void) const override;
+
 
   // Implement a clone operator.
   Ideal Clone(void);
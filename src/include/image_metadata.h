@@ -0,0 +1,66 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+/**
+ * @brief Resolution and text metadata written into the encoded target.
+ *
+ * Same content NFIMM writes, written by the one encode of the target, or
+ * into the buffer `cv::imencode()` produced: the image is not parsed and
+ * serialized again.
+ */
+struct ImageMetadata
+{
+  /** @brief Target image sample rate */
+  int sampleRate{0};
+  /** @brief `inch`, `meter`, or other (unit unknown) */
+  std::string srUnits{"inch"};
+  /** @brief PNG only: `keyword:text` pairs, one tEXt chunk each */
+  std::vector<std::string> textChunks;
+
+  /** @brief Sample rate in pixels per meter, or as is if units unknown */
+  uint32_t get_pixelsPerUnit(void) const;
+  /** @brief Summary for logging */
+  std::string to_s(void) const;
+};
+
+/** @brief Update pHYs, or add it, and add tEXt chunks after IHDR */
+void
+writePngMetadata( std::vector<uint8_t> &, const ImageMetadata & );
+
+/** @brief Set the pixels-per-meter fields of the BITMAPINFOHEADER */
+void
+writeBmpMetadata( std::vector<uint8_t> &, const ImageMetadata & );
+
+}   // End namespace
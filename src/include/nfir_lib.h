@@ -30,7 +30,11 @@ identified are necessarily the best available for the purpose.
 
 #include "exceptions.h"
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #define NFIR_VERSION "0.2.0"
 
@@ -48,6 +52,199 @@ printVersion(void);
 std::string
 getVersion(void);
 
+/**
+ * @brief Processing options for resample().
+ *
+ * Defaults reproduce the behavior of the overload without options.
+ */
+struct Options
+{
+  /**
+   * @brief Downsample lowpass filter engine: `fft`, `tiled`, `spatial`, or `auto`
+   *
+   * `fft` multiplies the padded image spectrum by the filter/mask, `tiled`
+   * does the same per tile, see tileSize.  `spatial`
+   * convolves the unpadded image with the equivalent separable kernel,
+   * truncated to match the filter/mask response within 1e-3, and requires
+   * the Gaussian filter and bilinear or bicubic interpolation.
+   * `auto` picks the cheaper of the two from the image size and the kernel
+   * support.  The default is `fft`, the original NFIR output; the other
+   * engines are opt-in since their results differ slightly.
+   */
+  std::string filterEngine{"fft"};
+
+  /**
+   * @brief Tiled engine: tile width and height in pixels, at least 64
+   *
+   * `tiled` filters overlapping tiles with the FFT (overlap-save) instead of
+   * the whole padded image.  Peak memory is bounded by the tiles in flight.
+   */
+  int tileSize{1024};
+
+  /**
+   * @brief Bytes of FFT working memory; 0 is unbounded
+   *
+   * Bounds the number of tiles filtered at once.  With `auto`, the tiled
+   * engine is used when the whole-image FFT would exceed it.
+   */
+  size_t memoryBudget{0};
+
+  /**
+   * @brief PNG and BMP target metadata: `auto`, `inline`, `nfimm`, or `none`
+   *
+   * The target sample rate (PNG pHYs, BMP pixels per meter) and, for PNG,
+   * the text chunks.  `inline` writes them as part of the one encode of
+   * the target (PNG, with libpng; else in one pass over the encoded
+   * target); `nfimm` has NFIMM parse the encoded target and serialize it
+   * again, and requires a build with NFIMM.  `auto` is `nfimm` with NFIMM
+   * built in and `none` without, as before; `inline` is opt-in.
+   */
+  std::string metadataWriter{"auto"};
+
+  /**
+   * @brief PNG target encode preset: `default`, `fast`, `store`, or `small`
+   *
+   * `default` leaves OpenCV's deflate level and strategy.  `fast` is level 1
+   * with Huffman-only coding, for targets read back right away where encode
+   * time matters more than size; `store` is level 0, no compression at
+   * all; `small` is level 9 with the filtered strategy.
+   */
+  std::string pngPreset{"default"};
+
+  /** @brief PNG deflate level 0 to 9, overrides the preset; -1 for none */
+  int pngCompressionLevel{-1};
+
+  /**
+   * @brief PNG deflate strategy, overrides the preset: `default`,
+   * `filtered`, `huffman`, `rle`, or `fixed`; empty for none
+   */
+  std::string pngStrategy{""};
+
+  /**
+   * @brief Decode, resample, and encode by bands of rows
+   *
+   * Polyphase interpolation of an 8-bit grayscale PNG or PGM only; the
+   * full source and target images are never decoded into memory.  Other
+   * images and methods are resampled whole, as without the option.
+   */
+  bool streamRows{false};
+};
+
+/**
+ * @brief Where resample() delivers the encoded target image.
+ *
+ * Set exactly one of:
+ * - `vector`: the encoded image is moved into it, no copy
+ * - `buffer` and `bufferSize`: copied into caller storage, see
+ *   get_encodedSizeBound(); if too small, nothing is written, `size` is set,
+ *   and NFIR::Miscue is thrown
+ * - `allocate`: called once with the size; the encoded image is copied into
+ *   the storage it returns, eg, from a memory pool
+ *
+ * `vector` takes precedence over `buffer`, `buffer` over `allocate`.
+ */
+struct TargetBuffer
+{
+  /** @brief Move mode: receives the encoded image */
+  std::vector<uint8_t> *vector{nullptr};
+  /** @brief Caller buffer mode: storage */
+  uint8_t *buffer{nullptr};
+  /** @brief Caller buffer mode: bytes available at `buffer` */
+  size_t bufferSize{0};
+  /** @brief Allocator mode: returns storage for the given number of bytes */
+  std::function<uint8_t*( size_t )> allocate;
+
+  /** @brief OUT encoded image, in whichever storage was used */
+  uint8_t *data{nullptr};
+  /** @brief OUT bytes of the encoded image */
+  size_t size{0};
+};
+
+/**
+ * @brief Per-call output of resample(), besides the target image.
+ *
+ * Everything a call produces is returned here; the library keeps no
+ * per-call state, so that resample() may be called from many threads at
+ * once.  The process-wide caches (filter/masks, FFT plans, polyphase tables)
+ * are shared and internally synchronized.
+ */
+struct Result
+{
+  /** @brief Opaque holder of the filtered image prior to downsample */
+  struct FilteredImage;
+
+  /** @brief `UPSAMPLE`, `DOWNSAMPLE`, or `POLYPHASE` */
+  std::string stage;
+  /** @brief Target image width in pixels */
+  uint32_t width{0};
+  /** @brief Target image height in pixels */
+  uint32_t height{0};
+  /** @brief Filtered image prior to downsample width; 0 if not generated */
+  uint32_t filteredWidth{0};
+  /** @brief Filtered image prior to downsample height; 0 if not generated */
+  uint32_t filteredHeight{0};
+  /** @brief See get_filteredImage(); copies of the result share it */
+  std::shared_ptr<const FilteredImage> filteredImage;
+
+  /**
+   * @brief Encode the filtered image prior to downsample.
+   *
+   * This intermediate image has been cropped of its zero-padding but not
+   * (yet) been downsampled.
+   */
+  void get_filteredImage( std::vector<uint8_t> &, const std::string & ) const;
+};
+
+/**
+ * @brief Set the memory cap of the process-wide filter/mask cache.
+ *
+ * Downsample filter/masks are cached by padded image size, sample rates, and
+ * filter type, and are reused by subsequent images of the same geometry.
+ * Least-recently-used masks are evicted when the cap is exceeded.  Default
+ * is 256 MiB; zero disables the cache.  Cache hit/miss counts are reported in
+ * the resample runtime log.
+ *
+ * @param bytes memory cap
+ */
+void
+set_maskCacheCapacity( size_t bytes );
+
+/**
+ * @brief Select the FFT implementation of the downsample filter.
+ *
+ * `opencv` (default) or `builtin`, and `fftw` if built with USE_FFTW; or
+ * `auto` to time each backend once per transform size and use the fastest.
+ * Plans are reused per transform size.
+ *
+ * @param name backend
+ *
+ * @throw NFIR::Miscue backend not available
+ */
+void
+set_fftBackend( const std::string &name );
+
+/**
+ * @brief Read the fastest FFT backend per transform size, and FFTW plans
+ * if built with USE_FFTW, as saved by saveFFTWisdom().
+ *
+ * A missing file is not an error.  Use with `auto` so that fixed scanner
+ * geometries are timed only once.
+ *
+ * @param path wisdom file
+ */
+void
+loadFFTWisdom( const std::string &path );
+
+/**
+ * @brief Write the FFT wisdom gathered so far, see loadFFTWisdom().
+ *
+ * @param path wisdom file
+ *
+ * @throw NFIR::Miscue cannot write file
+ */
+void
+saveFFTWisdom( const std::string &path );
+
 /**
  * @brief Primary API to the resampler process that generates a new image
  * at the desired sample rate.
@@ -79,7 +276,7 @@ getVersion(void);
  * channels and pixel bit-depth of the source image.
  */
 void
-resample( uint8_t *, uint8_t **,
+resample( const uint8_t *, uint8_t **,
                int, int, const std::string &,
                const std::string &, const std::string &,
                uint32_t *, uint32_t *,
@@ -88,6 +285,144 @@ resample( uint8_t *, uint8_t **,
                std::vector<std::string> &,
                std::vector<std::string> & );
 
+/**
+ * @brief Same as above with processing options, see NFIR::Options.
+ */
+void
+resample( const uint8_t *, uint8_t **,
+               int, int, const std::string &,
+               const std::string &, const std::string &,
+               uint32_t *, uint32_t *,
+               size_t *,
+               const std::string &, const std::string &,
+               std::vector<std::string> &,
+               std::vector<std::string> &,
+               const Options & );
+
+/**
+ * @brief Same as above, the encoded target image is delivered per
+ * NFIR::TargetBuffer instead of allocated with `new[]`.
+ *
+ * The target width and height are always set, also when the target cannot
+ * be delivered.  Reentrant; see NFIR::Result.
+ *
+ * @return target dimensions and the filtered image prior to downsample
+ */
+Result
+resample( const uint8_t *, size_t, TargetBuffer &,
+               int, int, const std::string &,
+               const std::string &, const std::string &,
+               uint32_t *, uint32_t *,
+               const std::string &, const std::string &,
+               std::vector<std::string> &,
+               std::vector<std::string> &,
+               const Options &options = Options{} );
+
+/**
+ * @brief Upper bound of the encoded size of an 8-bit grayscale target image,
+ * including metadata, to size a TargetBuffer `buffer`.
+ *
+ * @param width pixels
+ * @param height pixels
+ * @param compression `png`, `bmp`, `pgm`, or `raw`
+ *
+ * @throw NFIR::Miscue no bound for other formats
+ */
+size_t
+get_encodedSizeBound( uint32_t, uint32_t, const std::string & );
+
+/**
+ * @brief Resample raw, 8-bit grayscale pixels into caller storage.
+ *
+ * Same process as above without the image codec: the source is not decoded
+ * and the target is not encoded, nor is any metadata written.  Use
+ * get_targetSize() to size the target storage.
+ *
+ * @param srcPixels IN source image, row-major
+ * @param srcWidth pixels
+ * @param srcHeight pixels
+ * @param srcStride bytes between source rows; 0 for `srcWidth`
+ * @param tgtPixels OUT target image, row-major, written in place
+ * @param tgtStride bytes between target rows; 0 for target width
+ * @param tgtBufSize bytes available at `tgtPixels`
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param interpolationMethod see above
+ * @param filterType see above
+ * @param tgtWidth OUT pixels
+ * @param tgtHeight OUT pixels
+ * @param log resample-process metadata for reporting to caller
+ * @param options see NFIR::Options
+ *
+ * @return target dimensions and the filtered image prior to downsample
+ *
+ * @throw NFIR::Miscue as above, or for stride less than width, or target
+ *              storage too small; the target width and height are set first
+ */
+Result
+resample( const uint8_t *srcPixels, uint32_t srcWidth, uint32_t srcHeight,
+          size_t srcStride,
+          uint8_t *tgtPixels, size_t tgtStride, size_t tgtBufSize,
+          int srcSampleRate, int tgtSampleRate,
+          const std::string &interpolationMethod, const std::string &filterType,
+          uint32_t *tgtWidth, uint32_t *tgtHeight,
+          std::vector<std::string> &log,
+          const Options &options = Options{} );
+
+/**
+ * @brief Width and height of the target image for a source image.
+ *
+ * Same for all interpolation methods and filter types.
+ *
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param srcWidth pixels
+ * @param srcHeight pixels
+ * @param tgtWidth OUT pixels
+ * @param tgtHeight OUT pixels
+ *
+ * @throw NFIR::Miscue sample rate not positive
+ */
+void
+get_targetSize( int srcSampleRate, int tgtSampleRate,
+                uint32_t srcWidth, uint32_t srcHeight,
+                uint32_t *tgtWidth, uint32_t *tgtHeight );
+
+/**
+ * @brief Width and height of an encoded image from its header, without
+ * decoding it.
+ *
+ * PNG, BMP, and binary PGM are recognized; the first 64 bytes of the file
+ * are enough.
+ *
+ * @param encoded IN start of the encoded image
+ * @param encodedSize bytes available at `encoded`
+ * @param width OUT pixels
+ * @param height OUT pixels
+ *
+ * @return false if the format is not recognized or the header is short
+ */
+bool
+get_imageSize( const uint8_t *encoded, size_t encodedSize,
+               uint32_t *width, uint32_t *height );
+
+/**
+ * @brief Relative compute cost of resampling an image of this size.
+ *
+ * Downsample grows with the padded DFT size, upsample with the target
+ * size.  Use to order a batch, see NFIR::Pipeline.
+ *
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param width pixels
+ * @param height pixels
+ *
+ * @return cost, only meaningful relative to other images
+ */
+double
+get_resampleCost( int srcSampleRate, int tgtSampleRate,
+                  uint32_t width, uint32_t height );
+
 /**
  * @brief Additional API to get the filtered image prior to downsample.
  *
@@ -95,6 +430,10 @@ resample( uint8_t *, uint8_t **,
  * been downsampled.  It is encoded per the compression parameter.  The encoded
  * image is "vectorized" for return.
  *
+ * The image is that of the last call, on the calling thread, of a
+ * resample() overload without NFIR::Result; see Result::get_filteredImage()
+ * otherwise.
+ *
  * @param filteredImage OUT pointer to image
  * @param encodeCompression desired compression of filteredImage
  * @param imgBufSize OUT size of filteredImage array
@@ -0,0 +1,233 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "nfir_lib.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+class Session;
+
+/**
+ * @brief Threads per stage and queue depth of NFIR::Pipeline.
+ */
+struct PipelineOptions
+{
+  /** @brief Read-and-decode threads, 0 for as many as workers */
+  size_t readers{0};
+  /** @brief Resample threads */
+  size_t workers{1};
+  /** @brief Encode-and-write threads, 0 for as many as workers */
+  size_t writers{0};
+  /** @brief Capacity of each of the two queues between stages */
+  size_t queueDepth{2};
+  /** @brief Images read next that the Reader is told of, see PipelineItem */
+  size_t readAhead{0};
+  /**
+   * @brief Size of OpenCV's thread pool for the run, 0 leaves it as is
+   *
+   * `cv::setNumThreads()` is process-wide, so the pool is shared by all
+   * workers, and by any other OpenCV user of the process; it is restored
+   * when run() returns.  See NFIR::resolveThreadingPolicy().
+   */
+  int openCVThreads{0};
+};
+
+/**
+ * @brief Load balance of the resample workers of the last
+ * Pipeline::run().
+ */
+struct PipelineStats
+{
+  /** @brief Seconds spent resampling, per worker */
+  std::vector<double> workerBusy;
+
+  /** @brief Mean over maximum worker busy time; 1 is perfect balance */
+  double get_balance(void) const;
+  /** @brief Summary for logging */
+  std::string to_s(void) const;
+};
+
+/**
+ * @brief One image in flight through NFIR::Pipeline.
+ */
+struct PipelineItem
+{
+  /** @brief Position in the batch, from 0 */
+  size_t index{0};
+  /**
+   * @brief Set before the Reader is called: the indices of the images read
+   * after this one, in read order, up to PipelineOptions::readAhead, for
+   * the Reader to prefetch
+   */
+  std::vector<size_t> readAhead;
+
+  /** @brief Set by the reader: encoded source image, read in place */
+  const uint8_t *source{nullptr};
+  /** @brief Set by the reader: length of the encoded source image */
+  size_t sourceSize{0};
+  /** @brief Set by the reader: keeps `source` valid; released once decoded */
+  std::shared_ptr<void> sourceHold;
+  /** @brief Set by the reader of a `raw` source: width in pixels */
+  uint32_t sourceWidth{0};
+  /** @brief Set by the reader of a `raw` source: height in pixels */
+  uint32_t sourceHeight{0};
+
+  /**
+   * @brief Encoded target image for the writer; empty if written to the
+   * storage of `targetHold`
+   */
+  std::vector<uint8_t> target;
+  /** @brief Set by the TargetAllocator: owns the storage it returned */
+  std::shared_ptr<void> targetHold;
+  /** @brief Stage and target dimensions; the filtered image is not kept */
+  Result result;
+  /** @brief Resample-process metadata of this image */
+  std::vector<std::string> log;
+  /** @brief Set if a stage failed; the later stages are then skipped */
+  std::string error;
+};
+
+/**
+ * @brief Resample a batch of encoded images in three overlapping stages.
+ *
+ *  - readers: the caller's Reader gets the encoded source, which is then
+ *    decoded; `raw` and 8-bit `pgm` sources are read in place, and held
+ *    until resampled
+ *  - workers: resample, as resample() does, each with its own
+ *    NFIR::Session per source size, so that a batch of one geometry sets
+ *    up the resampler and filter/mask once per worker
+ *  - writers: encode the target, with NFIMM metadata, and hand it to the
+ *    caller's Writer; `raw` and `pgm` targets are their rows, no codec,
+ *    and given a TargetAllocator the workers resample them straight into
+ *    the caller's storage, such as a mapped file, so nothing is copied
+ *
+ * The stages are connected by queues of `queueDepth` images; a stage that
+ * runs ahead blocks until the next has caught up.  At most
+ * `readers + workers + writers + 2 * queueDepth` images are in flight,
+ * which caps memory independently of the batch size.
+ *
+ * Images are read in list order, or, given their estimated costs, largest
+ * first, see NFIR::WorkScheduler.  The resample workers take decoded
+ * images from one queue, so the most costly images are resampled first
+ * and the small ones fill in at the end of the batch.
+ *
+ * With Options::streamRows the workers decode, resample, and encode by row
+ * bands where streamImage() can; the images in flight are then held
+ * encoded only, and the writers hand them on as they are.
+ *
+ * Images complete out of order.  A failed image reaches the Writer with its
+ * `error` set.  Once the Writer returns false no further images are read;
+ * the images in flight still reach the Writer.
+ */
+class Pipeline
+{
+public:
+  /** @brief Set `source`, `sourceSize`, and `sourceHold` of the item */
+  using Reader = std::function<void( PipelineItem& )>;
+  /** @brief Write or report the item; false stops the batch */
+  using Writer = std::function<bool( PipelineItem& )>;
+  /**
+   * @brief Storage of the bytes given for the encoded target, owned by
+   * `targetHold`; null to have it encoded into `target` instead
+   */
+  using TargetAllocator = std::function<uint8_t*( PipelineItem&, size_t )>;
+
+  /** @brief Fix the resample parameters of every image of the batch */
+  Pipeline( int, int, const std::string &,
+            const std::string &, const std::string &,
+            const std::string &, const std::string &,
+            const std::vector<std::string> &,
+            const Options &options = Options{},
+            const PipelineOptions &pipelineOptions = PipelineOptions{} );
+
+  /** @brief Resample images 0 to count-1; returns the number without error */
+  size_t run( size_t, const Reader &, const Writer & );
+
+  /** @brief Same as above, largest estimated cost first */
+  size_t run( const std::vector<double> &, const Reader &, const Writer & );
+
+  /** @brief Load balance of the last run() */
+  PipelineStats get_stats(void) const;
+
+  /** @brief Write `raw` and `pgm` targets into the caller's storage */
+  void set_targetAllocator( const TargetAllocator & );
+
+private:
+  /** @brief Item plus its decoded and resampled images */
+  struct Job;
+  /** @brief Queues and counters of one run() */
+  struct Batch;
+  /** @brief Sessions of one worker, per source size */
+  struct SessionCache;
+
+  /** @brief Threads of all stages, returns once all have ended */
+  size_t runBatch( Batch &, const Reader &, const Writer & );
+  /** @brief Reader thread */
+  void readStage( Batch &, const Reader & );
+  /** @brief Worker thread */
+  void computeStage( Batch &, size_t );
+  /** @brief Writer thread */
+  void writeStage( Batch &, const Writer & );
+  /** @brief Session of a worker for a source width and height */
+  Session& acquireSession( SessionCache &, int, int ) const;
+  /** @brief Target pixels in the caller's storage, or null */
+  uint8_t* allocateTarget( PipelineItem &, int, int ) const;
+
+  /** @brief Source image resolution */
+  int _srcSampleRate;
+  /** @brief Target image resolution */
+  int _tgtSampleRate;
+  /** @brief Sample rate units, for the metadata */
+  std::string _srUnits;
+  /** @brief See NFIR::resample() */
+  std::string _interpolationMethod;
+  /** @brief See NFIR::resample() */
+  std::string _filterType;
+  /** @brief Compression format of the source */
+  std::string _srcComp;
+  /** @brief Compression format of the target */
+  std::string _tgtComp;
+  /** @brief PNG text chunks, with NFIMM */
+  std::vector<std::string> _vecPngTextChunk;
+  /** @brief See NFIR::Options */
+  Options _options;
+  /** @brief Threads and queue depth */
+  PipelineOptions _pipelineOptions;
+  /** @brief See set_targetAllocator() */
+  TargetAllocator _targetAllocator;
+  /** @brief Of the last run() */
+  PipelineStats _stats;
+};
+
+}   // End namespace
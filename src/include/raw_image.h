@@ -0,0 +1,77 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+/*
+ * The uncompressed formats: `raw`, 8-bit grayscale pixels row by row with
+ * no header, its dimensions known to the caller; and `pgm`, binary PGM,
+ * the same pixels after a short text header.  Neither needs a codec: the
+ * source is read in place and the target is its header and rows.
+ */
+
+/**
+ * @brief Binary PGM (`P5`) header fields.
+ */
+struct PgmHeader
+{
+  uint32_t width{0};
+  uint32_t height{0};
+  /** @brief Maximum gray value; up to 255 for 8-bit pixels */
+  uint32_t maxval{0};
+  /** @brief Offset of the first pixel */
+  size_t pixelOffset{0};
+};
+
+/** @brief Parse the header of a binary PGM; false if not one */
+bool
+readPgmHeader( const uint8_t *, size_t, PgmHeader & );
+
+/** @brief Header of an 8-bit binary PGM of the given width and height */
+std::string
+writePgmHeader( uint32_t, uint32_t );
+
+/** @brief Non-owning image over raw pixels of the given size */
+cv::Mat
+mapRawImage( const uint8_t *, size_t, uint32_t, uint32_t );
+
+/** @brief Non-owning image over the pixels of an 8-bit binary PGM */
+bool
+mapPgmImage( const uint8_t *, size_t, cv::Mat & );
+
+/** @brief `raw` or `pgm` image of the pixels, one copy of the rows */
+void
+encodeRawImage( const cv::Mat &, const std::string &, std::vector<uint8_t> & );
+
+}   // End namespace
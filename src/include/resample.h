@@ -40,6 +40,24 @@ identified are necessarily the best available for the purpose.
 // Type alias.
 typedef int InterpolationMethod;
 
+/**
+ * @brief Downsample only: decimate by cropping the filtered spectrum to the
+ * target size and inverse transforming at target resolution.
+ *
+ * This is not an OpenCV interpolation flag; the value is outside the range
+ * of `cv::InterpolationFlags`.
+ */
+const InterpolationMethod INTER_SPECTRAL{ 100 };
+
+/**
+ * @brief Upsample or downsample: polyphase FIR resampler, see
+ * NFIR::Polyphase.  Lowpass filter and interpolation in one separable pass;
+ * no filter/mask, no DFT.
+ *
+ * This is not an OpenCV interpolation flag.
+ */
+const InterpolationMethod INTER_POLYPHASE{ 101 };
+
 /** @brief Applied to source image prior to DFT
  * 
  * Top and left sides are always zero.
@@ -102,7 +120,8 @@ protected:
    * See screen-shots of SIVV 1D power spectrum in README.
    */
   cv::Mat _filteredImagePriorToDownsample;
-  uint32_t *_filteredImageDimens;
+  /** @brief Width x height of _filteredImagePriorToDownsample */
+  uint32_t _filteredImageDimens[2];
 
   /** @brief Bicubic or bilinear used to resize source image to target image */
   InterpolationMethod _interpolationMethod;
@@ -138,6 +157,10 @@ public:
   virtual cv::Mat resize( cv::Mat );
   /** @brief Resize a downsampled image */
   virtual cv::Mat resize( cv::Mat, NFIR::FilterMask*, Padding& );
+  /** @brief Resize an upsampled image into the target, reusing its buffer */
+  virtual void resizeInto( cv::Mat, cv::Mat& );
+  /** @brief Resize a downsampled image into the target, reusing its buffer */
+  virtual void resizeInto( cv::Mat, cv::Mat&, NFIR::FilterMask*, Padding& );
   /** @brief Resample runtime log */
   virtual std::vector<std::string> to_s(void) const;
 
@@ -162,6 +185,10 @@ public:
   int get_srcSampleRate(void) const;
   /** @brief Getter method */
   int get_tgtSampleRate(void) const;
+  /** @brief Rational ratio L/M of target to source rate, L in lowest terms */
+  int get_upFactor(void) const;
+  /** @brief Rational ratio L/M of target to source rate, M in lowest terms */
+  int get_downFactor(void) const;
 
   // Implement a clone operator.
   // Resample Clone(void);
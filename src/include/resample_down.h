@@ -29,14 +29,61 @@ identified are necessarily the best available for the purpose.
 
 #include "resample.h"
 
+#include <complex>
+#include <vector>
+
 namespace NFIR {
 
 /** @brief Support downsample process. */
 class Downsample : public Resample
 {
+public:
+  /**
+   * @brief Intermediate images of resize().
+   *
+   * Kept by the instance and reused while the image size is unchanged, so
+   * that repeated resize() calls with the same geometry do not reallocate.
+   */
+  struct Workspace
+  {
+    /** @brief Source image, CV_32F */
+    cv::Mat floatImage;
+    /** @brief Packed spectrum of floatImage, filtered in place */
+    cv::Mat spectrum;
+    /** @brief Inverse DFT of spectrum, CV_32F */
+    cv::Mat inverse;
+    /** @brief Spectral decimation: target-size band of spectrum */
+    cv::Mat band;
+    /** @brief Spectral decimation: inverse DFT of band */
+    cv::Mat bandImage;
+    /** @brief Spectral decimation: per band row and column phase ramps */
+    std::vector<std::complex<float>> rowPhase, colPhase;
+    /** @brief Spatial engine: source image with white border */
+    cv::Mat bordered;
+    /** @brief Spatial engine: sepFilter2D of bordered */
+    cv::Mat convolved;
+    /** @brief Spatial engine: filtered image, CV_32F */
+    cv::Mat filtered;
+    /** @brief Spatial engine: separable kernels, see resolveFilterEngine() */
+    cv::Mat kernelRows, kernelCols;
+    /** @brief Spatial engine: filter/mask offset */
+    float offset{0.f};
+  };
+
 private:
   /** @brief low pass filter ideal or Gaussian */
   std::string _filterType;
+  /** @brief low pass filter in freq domain (fft, tiled) or space domain (spatial) */
+  std::string _filterEngine;
+  /** @brief Tiled engine: tile width and height, incl. overlap */
+  int _tileSize;
+  /** @brief Tiled engine: bytes of tiles in flight; 0 is unbounded */
+  size_t _memoryBudget;
+  /** @brief Reused by resize(); the tiled engine allocates per tile */
+  Workspace _work;
+
+  /** @brief Whole-image FFT working set exceeds the memory budget */
+  bool exceedsMemoryBudget( cv::Size ) const;
 
 public:
   /** @brief Default constructor. Never used */
@@ -54,8 +101,8 @@ public:
    */
   Downsample( int, int );
 
-  /** @brief Virtual destructor cleans-up */
-  virtual ~Downsample() { delete [] _filteredImageDimens; }
+  /** @brief Virtual destructor */
+  virtual ~Downsample() {}
 
 
   /** @brief Used for upsample only; exists to satisfy linker; NOT TO BE CALLED */
@@ -71,16 +118,34 @@ public:
    *
    * Includes image processing prior to the OpenCV `resize()` function call:
    *
-   * 1. Calculate the Discrete Fourier Transform (DFT) of the `srcImg`
+   * 1. Calculate the Discrete Fourier Transform (DFT) of the real-valued
+   *    `srcImg`; the spectrum is packed (CCS), ie, half the complex spectrum
    * 2. Factor-out the DC component (by dividing each freq by size of `srcImg`)
-   * 3. Apply the filter/mask
-   * 4. Calulate the inverse DFT
-   * 5. Extract image that is (polar) magnitude of inverse DFT
-   * 6. Crop space domain image
+   * 3. Apply the packed filter/mask; step 2 is folded into this pass
+   * 4. Calulate the inverse DFT, complex-to-real
+   * 5. Convert the real-valued inverse DFT to 8-bit image
+   * 6. Crop space domain image; only the cropped region is converted in 5
    * 7. Call the OpenCV `resize` function.
+   *
+   * For interpolation method `spectral` (INTER_SPECTRAL), steps 3 through 7
+   * are fused: the filtered spectrum is cropped to the target-size frequency
+   * band and inverse transformed directly at target resolution.
+   *
+   * For filter engines `spatial` and `tiled` the source image is not padded
+   * and steps 1 through 6 are replaced, see set_filterEngine() and
+   * set_tiling().
    */
   cv::Mat resize( cv::Mat, NFIR::FilterMask*, Padding& ) override;
 
+  using Resample::resizeInto;
+  /**
+   * @brief Same as resize(), into the target.
+   *
+   * The target and the intermediate images are reused if already allocated
+   * at the same size; see Workspace.
+   */
+  void resizeInto( cv::Mat, cv::Mat&, NFIR::FilterMask*, Padding& ) override;
+
   /** @brief This instance configuration for logging. */
   std::vector<std::string> to_s(void) const override;
 
@@ -101,13 +166,53 @@ public:
    *      600 to 500ppi - BICUBIC     <=== MANUAL
    *     1000 to 500ppi - BICUBIC     <=== MANUAL
    *     1200 to 500ppi - BILINEAR    <=== BEST
+   *
+   * **SPECTRAL decimation (either LPF), must specify per config params.
    */
   void set_interpolationMethodAndFilterType( const std::string,
                                              const std::string ) override;
 
+  /**
+   * @brief Padded image width and height must be a multiple of this value.
+   *
+   * Always even; for `spectral` decimation, the padded size must also scale
+   * to an integer target size.
+   */
+  int get_padMultiple(void) const;
+
   /** @brief Get current instance filter type */
   std::string get_filterType(void) const;
 
+  /**
+   * @brief Select the lowpass filter engine: `fft`, `spatial`, or `auto`
+   *
+   * The spatial engine convolves the unpadded source image with the separable
+   * space-domain equivalent of the Gaussian filter/mask; it avoids the padding
+   * and the DFTs.  See resolveFilterEngine().
+   */
+  void set_filterEngine( const std::string );
+
+  /** @brief Choose `fft` or `spatial` once the image and mask are known */
+  void resolveFilterEngine( cv::Size, cv::Size, const NFIR::FilterMask* );
+
+  /** @brief Get current instance filter engine */
+  std::string get_filterEngine(void) const;
+
+  /**
+   * @brief Configure the tiled overlap-save engine.
+   *
+   * The image is filtered in square tiles that overlap by one eighth of the
+   * tile size on each side; only the center of each tile is kept.  Tiles are
+   * processed in parallel, as many at once as fit the memory budget.
+   */
+  void set_tiling( int, size_t );
+
+  /** @brief Tile width and height, a DFT-friendly even size */
+  int get_tileSize(void) const;
+
+  /** @brief Build the filter/mask at this size: one tile or the padded image */
+  cv::Size get_maskSize( cv::Size ) const;
+
   /** @brief This image is made available as 'optional'.
    *
    * It is not required to keep or maintain this image for the downsample
@@ -118,7 +223,7 @@ public:
   cv::Mat get_filteredImage(void) const;
 
   /** @brief Width x height of image before decimation */
-  uint32_t *get_filteredImageDimens(void) const;
+  const uint32_t *get_filteredImageDimens(void) const;
 
   /** @brief Implement a clone operation */
   Downsample Clone(void);
@@ -0,0 +1,158 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "resample.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace NFIR {
+
+/**
+ * @brief Polyphase FIR resampler for rational sample-rate ratios.
+ *
+ * The ratio of target to source rate is L/M in lowest terms, eg, 5/6 for
+ * 600 to 500ppi, 2/1 for 500 to 1000ppi.  Target pixel n is at source
+ * position `(n + 0.5) * M/L - 0.5`, the same pixel-centers as `cv::resize`.
+ * Writing n = q*L + r, that position is q*M plus an offset that depends on
+ * the phase r only; there are L distinct sets of filter taps.
+ *
+ * Each phase is a Kaiser-windowed sinc, cutoff at the lower of the source
+ * and target Nyquist frequencies; the lowpass filter and the interpolation
+ * are one FIR.  The phase table is built once per ratio and shared, see
+ * PhaseTable::acquire().  The same taps are applied along rows and columns.
+ *
+ * Rows are streamed: each source row is filtered horizontally on arrival into
+ * a ring buffer of `taps` rows; a target row is filtered vertically and
+ * emitted as soon as its last source row has arrived.  Memory is bounded by
+ * `taps` rows at target width, independent of image height.
+ *
+ * Image borders are replicated, as `cv::resize` does.
+ */
+class Polyphase : public Resample
+{
+public:
+  /**
+   * @brief Filter taps of all phases for one ratio; immutable once built.
+   */
+  struct PhaseTable
+  {
+    /** @brief Target to source ratio L/M, lowest terms */
+    int upFactor;
+    /** @brief Target to source ratio L/M, lowest terms */
+    int downFactor;
+    /** @brief Taps per phase, even */
+    int taps;
+    /** @brief Per phase r, first source pixel relative to q*M */
+    std::vector<int> first;
+    /** @brief Per phase r, `taps` weights that sum to one */
+    std::vector<float> weights;
+
+    /** @brief Get the shared table for ratio L/M; built on first use */
+    static std::shared_ptr<const PhaseTable> acquire( int, int );
+  };
+
+  /** @brief Receives target row index and its pixels */
+  typedef std::function<void( int, const uint8_t* )> RowSink;
+
+  /** @brief Default constructor */
+  Polyphase();
+
+  /** @brief Copy constructor */
+  Polyphase( const Polyphase& );
+
+  /** @brief Full constructor, acquires the phase table for the ratio */
+  Polyphase( int, int );
+
+  /** @brief Virtual destructor */
+  virtual ~Polyphase() {}
+
+
+  /** @brief Resample 8-bit, single-channel image, up or down */
+  cv::Mat resize( cv::Mat ) override;
+  /** @brief No filter/mask is used; exists to satisfy linker; NOT TO BE CALLED */
+  cv::Mat resize( cv::Mat, NFIR::FilterMask*, Padding& ) override;
+  using Resample::resizeInto;
+  /** @brief Resize into the target; no allocation if its size is unchanged */
+  void resizeInto( cv::Mat, cv::Mat& ) override;
+  /** @brief This instance configuration for logging. */
+  std::vector<std::string> to_s(void) const override;
+
+  /** @brief Accepts `polyphase` or empty only */
+  void set_interpolationMethod( const std::string ) override;
+
+  /** @brief Target size for source size, same as `cv::resize` */
+  cv::Size get_targetSize( cv::Size ) const;
+
+  /** @brief Start streaming a source image of given size */
+  void start( cv::Size, RowSink );
+  /** @brief Push the next source row, 8-bit, source width pixels */
+  void pushRow( const uint8_t* );
+  /** @brief Verify all rows were pushed and emitted */
+  void finish(void);
+
+  // Implement a clone operator.
+  Polyphase Clone(void);
+
+  // Implement an assigment operator.
+  Polyphase operator=( const Polyphase& );
+
+private:
+  /** @brief Shared by all instances with the same ratio */
+  std::shared_ptr<const PhaseTable> _table;
+
+  /** @brief Source image size of current stream */
+  cv::Size _srcSize;
+  /** @brief Target image size of current stream */
+  cv::Size _tgtSize;
+  /** @brief Per target column, `taps` source columns, borders replicated */
+  std::vector<int> _colIndex;
+  /** @brief Per target column, offset of its weights in the table */
+  std::vector<int> _colWeights;
+  /** @brief `taps` horizontally filtered rows, indexed by source row mod taps */
+  cv::Mat _ring;
+  /** @brief One target row, vertical filter accumulator */
+  std::vector<float> _accRow;
+  /** @brief One target row */
+  std::vector<uint8_t> _outRow;
+  /** @brief Receives target rows */
+  RowSink _sink;
+  /** @brief Source rows pushed so far */
+  int _rowsPushed{0};
+  /** @brief Next target row to emit */
+  int _nextRow{0};
+
+  /** @brief First source row, not clamped, of target row n */
+  int firstSourceIndex( int ) const;
+  /** @brief Emit target row n from the ring buffer */
+  void emitRow( int );
+};
+
+}   // End namespace
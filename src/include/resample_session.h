@@ -0,0 +1,120 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+
+#pragma once
+
+#include "filter_mask.h"
+#include "nfir_lib.h"
+#include "resample.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+/**
+ * @brief Resample process for one fixed geometry, set up once and run for
+ * many images.
+ *
+ * The constructor does everything that depends only on the sample rates,
+ * the interpolation method, the filter type, and the source image size:
+ * it instantiates the up- or down-sample object, acquires and keeps the
+ * filter/mask, chooses the filter engine and the padding.
+ *
+ * run() then resamples one image of that size.  The resampler keeps its
+ * intermediate images and the session keeps the padded image; once the
+ * first image has been run, subsequent images reuse all of them and the
+ * target, so that there is no allocation by NFIR in the steady state.
+ * Exceptions: the tiled engine allocates per tile, and the `fftw` FFT
+ * backend allocates per transform; `opencv` and `builtin` do not.
+ *
+ * One session is not to be run from more than one thread at a time.
+ */
+class Session
+{
+public:
+  /** @brief Build the resampler and filter/mask for this geometry */
+  Session( int, int, const std::string &, const std::string &, cv::Size,
+           const Options &options = Options{} );
+
+  /** @brief Destructor */
+  ~Session();
+
+  Session( const Session& ) = delete;
+  Session& operator=( const Session& ) = delete;
+
+  /** @brief Resample one single-channel image of the session size */
+  void run( const cv::Mat&, cv::Mat& );
+
+  /** @brief Source image size this session was built for */
+  cv::Size get_srcSize(void) const;
+
+  /** @brief Target image size of every run(), same as `cv::resize` */
+  cv::Size get_tgtSize(void) const;
+
+  /** @brief `UPSAMPLE`, `DOWNSAMPLE`, or `POLYPHASE` */
+  std::string get_stage(void) const;
+
+  /** @brief Downsample: resolved filter engine; empty otherwise */
+  std::string get_filterEngine(void) const;
+
+  /**
+   * @brief Downsample: the filtered image prior to decimation of the last
+   * run(); empty otherwise.
+   *
+   * The buffer is reused by the next run(); clone it to keep it.
+   */
+  cv::Mat get_filteredImage(void) const;
+
+  /** @brief Resampler configuration, filter/mask, and padding for logging */
+  std::vector<std::string> to_s(void) const;
+
+  /** @brief Relative compute cost of one run() for an image size */
+  static double estimateCost( int, int, cv::Size );
+
+private:
+  /** @brief Upsample, Downsample, or Polyphase */
+  std::unique_ptr<Resample> _resampler;
+  /** @brief Downsample only, null otherwise */
+  std::unique_ptr<FilterMask> _filterMask;
+  /** @brief Source image size */
+  cv::Size _srcSize;
+  /** @brief Target image size */
+  cv::Size _tgtSize;
+  /** @brief Downsample, fft engine: right and bottom padding; zero otherwise */
+  Padding _pads;
+  /** @brief Downsample, fft engine: source image, padded */
+  cv::Mat _paddedImage;
+  /** @brief Label for log and exception messages */
+  std::string _stage;
+  /** @brief Set up by the constructor, see to_s() */
+  std::vector<std::string> _log;
+};
+
+}   // End namespace
@@ -0,0 +1,85 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "nfir_lib.h"
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+class Session;
+
+/*
+ * The stages of the resample process of an encoded image, in order.
+ * resample() runs them back to back; NFIR::Pipeline runs each on its own
+ * threads.  Each is reentrant.
+ */
+
+/** @brief Decode an encoded image to a single-channel image */
+cv::Mat
+decodeImage( const uint8_t *, size_t, std::vector<std::string> & );
+
+/** @brief Image over raw pixels of dimensions known to the caller */
+cv::Mat
+decodeRawImage( const uint8_t *, size_t, uint32_t, uint32_t,
+                std::vector<std::string> & );
+
+/** @brief Resample a decoded image by a one-time NFIR::Session */
+Result
+resampleImage( const cv::Mat &, cv::Mat &, int, int,
+               const std::string &, const std::string &,
+               std::vector<std::string> &, const Options & );
+
+/**
+ * @brief Resample a decoded image by a session built for its size; the
+ * filtered image stays with the session
+ */
+Result
+resampleImage( Session &, const cv::Mat &, cv::Mat &,
+               std::vector<std::string> & );
+
+/** @brief Decode, resample, and encode by row bands; false if not possible */
+bool
+streamImage( const uint8_t *, size_t, int, int, const std::string &,
+             const std::string &, const std::string &, const std::string &,
+             const std::vector<std::string> &, std::vector<std::string> &,
+             std::vector<uint8_t> &, Result &, const Options & );
+
+/** @brief Encode the target image and, with NFIMM, write its metadata */
+void
+encodeImage( const cv::Mat &, const std::string &, int, int,
+             const std::string &, const std::string &,
+             const std::vector<std::string> &,
+             std::vector<std::string> &, std::vector<uint8_t> &,
+             const Options & );
+
+}   // End namespace
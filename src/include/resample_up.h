@@ -50,6 +50,9 @@ public:
 
   cv::Mat resize( cv::Mat ) override;
   cv::Mat resize( cv::Mat, NFIR::FilterMask*, Padding& ) override;
+  using Resample::resizeInto;
+  /** @brief Resize into the target; no allocation if its size is unchanged */
+  void resizeInto( cv::Mat, cv::Mat& ) override;
   /** @brief This instance configuration for logging. */
   std::vector<std::string> to_s(void) const override;
 
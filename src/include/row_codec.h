@@ -0,0 +1,104 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "image_metadata.h"
+
+#include <opencv2/core.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NFIR {
+
+/** @brief Rows per band of the streaming codecs */
+constexpr int streamBandRows{ 64 };
+
+/**
+ * @brief Decodes an encoded image band by band, top to bottom.
+ *
+ * Only the encoded image and the current band are in memory.  8-bit
+ * grayscale, non-interlaced PNG and binary PGM (maxval up to 255) are
+ * supported; other images are decoded whole, see open().  PNG requires a
+ * build with libpng (USE_LIBPNG).
+ */
+class RowReader
+{
+public:
+  /** @brief Virtual destructor */
+  virtual ~RowReader() {}
+
+  /** @brief Reader of the image; null if it cannot be streamed */
+  static std::unique_ptr<RowReader> open( const uint8_t *, size_t );
+
+  /** @brief Image width and height */
+  cv::Size get_size(void) const { return _size; }
+
+  /** @brief Decode the next `band.rows` rows into the 8-bit band */
+  virtual void read( cv::Mat & ) = 0;
+
+  /** @brief `png` or `pgm` */
+  virtual std::string get_format(void) const = 0;
+
+protected:
+  /** @brief Set by the derived class on open */
+  cv::Size _size;
+  /** @brief Rows decoded so far */
+  int _rowsRead{0};
+};
+
+/**
+ * @brief Encodes an 8-bit grayscale image band by band, top to bottom.
+ *
+ * Only the current band and the encoded output are in memory.  The PNG
+ * writer writes the metadata, pHYs and tEXt, as part of the one encode.
+ */
+class RowWriter
+{
+public:
+  /** @brief Virtual destructor */
+  virtual ~RowWriter() {}
+
+  /** @brief Format can be written by create() in this build */
+  static bool supports( const std::string & );
+
+  /** @brief Writer of `png`, `pgm`, or `raw`; null for other formats */
+  static std::unique_ptr<RowWriter> create( const std::string &, cv::Size,
+                                            const ImageMetadata *,
+                                            const std::vector<int> &,
+                                            std::vector<uint8_t> & );
+
+  /** @brief Encode the next `band.rows` rows of the 8-bit band */
+  virtual void write( const cv::Mat & ) = 0;
+
+  /** @brief Complete the encoded image once all rows are written */
+  virtual void finish(void) = 0;
+};
+
+}   // End namespace
@@ -0,0 +1,59 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace NFIR {
+
+/**
+ * @brief Row kernels of the frequency-domain filter, vectorized.
+ *
+ * The instruction set is chosen once at runtime: AVX-512, AVX2, or SSE2 on
+ * x86 with GCC or Clang, SSE2 on x64 with MSVC, plain C++ otherwise.  Each
+ * variant does the same float operations in the same order (no FMA), so
+ * results do not depend on the CPU.
+ */
+namespace SpectrumKernels {
+
+/** @brief row[j] *= a * profile[j] + b, in place */
+void multiplyAffine( float *row, const float *profile, float a, float b, int n );
+
+/** @brief row[j] *= s, in place */
+void scale( float *row, float s, int n );
+
+/** @brief dst[j] = src[j] rounded to nearest, saturated to 0..255 */
+void storeSaturated( const float *src, uint8_t *dst, int n );
+
+/** @brief Instruction set in use, for logging */
+std::string get_isa(void);
+
+}   // End namespace SpectrumKernels
+
+}   // End namespace
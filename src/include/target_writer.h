@@ -0,0 +1,190 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include "bounded_queue.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NFIR {
+
+/**
+ * @brief Threads, queue, and durability of NFIR::TargetWriter.
+ */
+struct TargetWriterOptions
+{
+  /** @brief Write threads; 0 writes in submit(), on the caller's thread */
+  size_t threads{1};
+  /** @brief Files queued before submit() waits; caps buffered memory */
+  size_t queueDepth{8};
+  /**
+   * @brief Write `<path>.tmp` and rename it to the path once complete
+   *
+   * A target is then either absent, or its prior version, or complete;
+   * never half written.  The temporary file is synced before it is
+   * renamed, whatever the `fsync` policy.
+   */
+  bool atomicRename{false};
+  /**
+   * @brief When written files reach the disk: `none`, left to the OS;
+   * `file`, each before it is reported written; `batch`, all in finish(),
+   * which with `atomicRename` also renames them, once synced
+   */
+  std::string fsync{"none"};
+};
+
+/**
+ * @brief Target file created at its full size and mapped, for the image to
+ * be written straight into; see TargetWriter::map().
+ *
+ * Once written it is submitted to the TargetWriter, which syncs and
+ * renames it.  Destroyed unsubmitted, or if that fails, the file is
+ * removed.
+ */
+class MappedTarget
+{
+public:
+  /** @brief Unmap and close; remove the file unless written */
+  ~MappedTarget();
+
+  MappedTarget( const MappedTarget& ) = delete;
+  MappedTarget& operator=( const MappedTarget& ) = delete;
+
+  /** @brief Start of the mapping */
+  uint8_t* data(void) const;
+  /** @brief Bytes of the file */
+  size_t size(void) const;
+
+private:
+  friend class TargetWriter;
+  MappedTarget() = default;
+
+  /** @brief Unmap; false on error, errno set */
+  bool unmap(void);
+
+  /** @brief Of the target */
+  std::string _path;
+  /** @brief File mapped: `<path>.tmp` with `atomicRename` */
+  std::string _writePath;
+  /** @brief Open until written */
+  int _fd{-1};
+  /** @brief Null once unmapped */
+  uint8_t *_data{nullptr};
+  /** @brief Bytes of the file */
+  size_t _size{0};
+  /** @brief Set once written, the file is then kept */
+  bool _written{false};
+};
+
+/**
+ * @brief Write-behind file writer of encoded target images.
+ *
+ * submit() takes ownership of the encoded buffer and returns as soon as it
+ * is queued; the write threads write it and then call its Completion.  The
+ * encoders thus never wait on storage, unless `queueDepth` files are
+ * already waiting to be written.
+ *
+ * An image of known encoded size, such as an uncompressed target, can
+ * instead be written in place: map() creates the file at that size, the
+ * image is written into its mapping, and submit() then only syncs and
+ * renames it.
+ */
+class TargetWriter
+{
+public:
+  /** @brief Called on a write thread; error is empty if written */
+  using Completion = std::function<void( const std::string & )>;
+
+  /** @brief Start the write threads */
+  explicit TargetWriter( const TargetWriterOptions &options = TargetWriterOptions{} );
+  /** @brief finish(), errors are lost */
+  ~TargetWriter();
+
+  TargetWriter( const TargetWriter& ) = delete;
+  TargetWriter& operator=( const TargetWriter& ) = delete;
+
+  /** @brief Queue the file for writing; waits while the queue is full */
+  void submit( const std::string &, std::vector<uint8_t> &&,
+               const Completion &completion = Completion{} );
+
+  /** @brief Create the file at the size given and map it; null if it cannot be */
+  std::shared_ptr<MappedTarget> map( const std::string &, size_t ) const;
+
+  /** @brief Queue the mapped file, once written, for sync and rename */
+  void submit( const std::shared_ptr<MappedTarget> &,
+               const Completion &completion = Completion{} );
+
+  /** @brief Write all queued files, and sync them per `fsync` */
+  void finish(void);
+
+  /** @brief Number of files written without error */
+  size_t get_written(void) const;
+
+private:
+  /** @brief One file to write */
+  struct Task
+  {
+    std::string path;
+    std::vector<uint8_t> data;
+    /** @brief Set for a mapped file, already written */
+    std::shared_ptr<MappedTarget> mapped;
+    Completion completion;
+  };
+
+  /** @brief Write now, without write threads, or queue the task */
+  void enqueue( std::unique_ptr<Task> && );
+  /** @brief Write thread */
+  void writeStage(void);
+  /** @brief Write the file, free its buffer, and call its Completion */
+  void complete( Task & );
+  /** @brief Write, sync, and rename one file; error is empty if written */
+  std::string write( const Task & );
+
+  /** @brief See NFIR::TargetWriterOptions */
+  const TargetWriterOptions _options;
+  /** @brief Submitted, not yet written */
+  BoundedQueue<std::unique_ptr<Task>> _queue;
+  /** @brief Write threads */
+  std::vector<std::thread> _threads;
+  /** @brief `batch`: files written, synced, and renamed, in finish() */
+  std::vector<std::string> _unsynced;
+  /** @brief Files written without error */
+  size_t _written{0};
+  /** @brief Set by finish() */
+  bool _finished{false};
+  /** @brief Guards `_unsynced`, `_written`, and `_finished` */
+  mutable std::mutex _mutex;
+};
+
+}   // End namespace
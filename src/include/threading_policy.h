@@ -0,0 +1,76 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace NFIR {
+
+/**
+ * @brief Threads of a batch: the pipeline stages, the target file writes,
+ * and OpenCV's pool.
+ *
+ * `cv::dft`, `cv::resize`, `cv::mulSpectrums`, and the tiled filter
+ * engine run on OpenCV's threads; the pipeline runs one image per worker.
+ * Both at full width oversubscribe the machine.  OpenCV's pool is
+ * process-wide: `cv::setNumThreads()` sizes one pool that every worker
+ * shares, not a number of threads per image.  The plan sizes it so that
+ * the workers plus the pool threads that help them fill the cores.
+ */
+struct ThreadingPlan
+{
+  /** @brief Resolved policy: `latency`, `throughput`, or `hybrid` */
+  std::string policy;
+  /** @brief Images resampled concurrently, see PipelineOptions::workers */
+  size_t workers{1};
+  /** @brief Size of OpenCV's shared pool, see PipelineOptions::openCVThreads */
+  int openCVThreads{1};
+  /** @brief Read-and-decode threads, see PipelineOptions::readers */
+  size_t readers{1};
+  /** @brief Encode threads, see PipelineOptions::writers */
+  size_t writers{1};
+  /** @brief Target file write threads, see TargetWriterOptions::threads */
+  size_t writeThreads{1};
+
+  /** @brief Summary for logging */
+  std::string to_s(void) const;
+};
+
+/**
+ * @brief Source images from this many pixels on are taken as large by the
+ * `auto` policy, eg, a 1000 PPI tenprint card.
+ */
+constexpr uint64_t largeImagePixels{ (uint64_t)16 * 1024 * 1024 };
+
+/** @brief Choose the threads of every stage of a batch */
+ThreadingPlan
+resolveThreadingPolicy( const std::string &, size_t, uint64_t,
+                        size_t workers = 0, unsigned cores = 0 );
+
+}   // End namespace
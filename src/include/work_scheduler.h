@@ -0,0 +1,70 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace NFIR {
+
+/**
+ * @brief Largest-first dispatch of a batch.
+ *
+ * The images are sorted by estimated cost, largest first, and handed out
+ * in that order to whichever reader asks next.  The readers feed one queue
+ * that all resample workers take from, so a free worker always gets the
+ * most costly image left: this is longest processing time first list
+ * scheduling, and the small images fill in at the end of the batch.
+ * at() tells what is read after a position, so that it can be prefetched.
+ *
+ * All methods are thread-safe.
+ */
+class WorkScheduler
+{
+public:
+  /** @brief Order the images by cost */
+  explicit WorkScheduler( const std::vector<double> & );
+
+  WorkScheduler( const WorkScheduler& ) = delete;
+  WorkScheduler& operator=( const WorkScheduler& ) = delete;
+
+  /** @brief Next image to read and its position; false when none is left */
+  bool next( size_t &, size_t & );
+
+  /** @brief Image at a position of the order */
+  size_t at( size_t ) const;
+
+private:
+  /** @brief Image indices, largest cost first */
+  std::vector<size_t> _order;
+  /** @brief Position in _order of the next image */
+  std::atomic<size_t> _next{0};
+};
+
+}   // End namespace
@@ -0,0 +1,343 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "fft_backend.h"
+#include "fft_backend_builtin.h"
+#include "fft_backend_opencv.h"
+
+#ifdef USE_FFTW
+  #include "fft_backend_fftw.h"
+#endif
+
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+static std::vector<NFIR::FFTBackend*>& registry(void);
+static NFIR::FFTBackend* find( const std::string& );
+
+/** @brief Guards preferred and wisdom */
+static std::mutex mtx;
+/** @brief `auto` or a backend name */
+static std::string preferred{ "opencv" };
+/** @brief Fastest backend per (rows, cols) */
+static std::map<std::pair<int,int>, std::string> wisdom;
+
+
+namespace NFIR {
+
+/**
+ * @param size of transform
+ * @return true
+ */
+bool FFTBackend::supports( cv::Size ) const
+{
+  return true;
+}
+
+/** @return "opencv", "builtin", and "fftw" if compiled in */
+std::vector<std::string> FFTBackend::get_available(void)
+{
+  std::vector<std::string> names;
+  for( auto backend : registry() ) {
+    names.push_back( backend->get_name() );
+  }
+  return names;
+}
+
+/**
+ * Default is `opencv`.
+ *
+ * @param name `auto` or a backend name
+ *
+ * @throw NFIR::Miscue unknown or not compiled in
+ */
+void FFTBackend::set_preferred( const std::string &name )
+{
+  if( ( name != "auto" ) && ( find( name ) == nullptr ) )
+    throw NFIR::Miscue( "NFIR lib: FFT backend not available: " + name );
+  std::lock_guard<std::mutex> lock( mtx );
+  preferred = name;
+}
+
+/** @return `auto` or a backend name */
+std::string FFTBackend::get_preferred(void)
+{
+  std::lock_guard<std::mutex> lock( mtx );
+  return preferred;
+}
+
+/**
+ * For `auto`, the backend recorded in the wisdom for this size; if there is
+ * none, each backend is timed once for this size and the fastest recorded.
+ * A backend that does not support the size falls back to OpenCV.
+ *
+ * @param size of transform
+ * @return backend
+ */
+FFTBackend& FFTBackend::select( cv::Size size )
+{
+  std::string name;
+  {
+    std::lock_guard<std::mutex> lock( mtx );
+    if( preferred != "auto" )
+      name = preferred;
+    else
+    {
+      auto it = wisdom.find( { size.height, size.width } );
+      if( it != wisdom.end() )
+        name = it->second;
+    }
+  }
+  if( name.empty() )
+  {
+    name = benchmark( size );
+    std::lock_guard<std::mutex> lock( mtx );
+    wisdom[{ size.height, size.width }] = name;
+  }
+
+  FFTBackend *backend = find( name );
+  if( ( backend == nullptr ) || !backend->supports( size ) )
+    backend = find( "opencv" );
+  return *backend;
+}
+
+/**
+ * Text file, one size per line: `rows cols backend`.  A missing file is not
+ * an error (first run); backends not compiled in are skipped.
+ *
+ * @param path wisdom file; backends may read a sidecar of it
+ */
+void FFTBackend::loadWisdom( const std::string &path )
+{
+  std::ifstream file( path );
+  if( file.is_open() )
+  {
+    std::string line;
+    while( std::getline( file, line ) )
+    {
+      std::istringstream fields( line );
+      int rows, cols;
+      std::string name;
+      if( ( line.empty() ) || ( line[0] == '#' ) || !( fields >> rows >> cols >> name ) )
+        continue;
+      if( find( name ) == nullptr )
+        continue;
+      std::lock_guard<std::mutex> lock( mtx );
+      wisdom[{ rows, cols }] = name;
+    }
+  }
+  for( auto backend : registry() ) {
+    backend->importWisdom( path );
+  }
+}
+
+/**
+ * @param path wisdom file; backends may write a sidecar of it
+ *
+ * @throw NFIR::Miscue cannot write file
+ */
+void FFTBackend::saveWisdom( const std::string &path )
+{
+  std::ofstream file( path );
+  if( !file.is_open() )
+    throw NFIR::Miscue( "NFIR lib: cannot write FFT wisdom file: " + path );
+  file << "# NFIR FFT wisdom: rows cols backend" << std::endl;
+  {
+    std::lock_guard<std::mutex> lock( mtx );
+    for( auto &entry : wisdom ) {
+      file << entry.first.first << " " << entry.first.second << " "
+           << entry.second << std::endl;
+    }
+  }
+  for( auto backend : registry() ) {
+    backend->exportWisdom( path );
+  }
+}
+
+/** @return one line for the runtime log */
+std::string FFTBackend::to_s(void)
+{
+  std::string s{ "FFT backend: preferred: " + get_preferred() };
+  {
+    std::lock_guard<std::mutex> lock( mtx );
+    s.append( ", wisdom sizes: " + std::to_string( wisdom.size() ) );
+  }
+  s.append( ", plans:" );
+  for( auto backend : registry() ) {
+    s.append( " " + backend->get_name() + " "
+              + std::to_string( backend->get_planCount() ) );
+  }
+  return s;
+}
+
+/**
+ * Column j of the packed spectrum holds column frequency (j+1)/2, real and
+ * imaginary parts in adjacent columns, except columns 0 and M-1 that hold
+ * the real-valued column frequencies 0 and M/2; those are conjugate-symmetric
+ * in the row frequency and packed the same way down the rows.
+ *
+ * @param half N x (M/2 + 1) complex, row-major
+ * @param packed OUT allocated N x M, CV_32F, both even
+ */
+void FFTBackend::packHalfSpectrum( const std::complex<float> *half, cv::Mat &packed )
+{
+  const int N = packed.rows;
+  const int M = packed.cols;
+  const int H = M/2 + 1;
+
+  for( int u=0; u<N; u++ )
+  {
+    float *row = packed.ptr<float>( u );
+    const std::complex<float> *in = half + (size_t)u * H;
+    for( int v=1; v<M/2; v++ ) {
+      row[2*v-1] = in[v].real();
+      row[2*v] = in[v].imag();
+    }
+  }
+  for( int v : { 0, M/2 } )
+  {
+    int j = ( v == 0 ) ? 0 : M-1;
+    packed.at<float>( 0, j ) = half[v].real();
+    for( int k=1; k<N/2; k++ ) {
+      packed.at<float>( 2*k-1, j ) = half[(size_t)k * H + v].real();
+      packed.at<float>( 2*k, j ) = half[(size_t)k * H + v].imag();
+    }
+    packed.at<float>( N-1, j ) = half[(size_t)( N/2 ) * H + v].real();
+  }
+}
+
+/**
+ * Reverse of packHalfSpectrum(); the rows of column frequencies 0 and M/2
+ * past N/2 are the conjugates of the rows mirrored about N/2.
+ *
+ * @param packed N x M, CV_32F, both even
+ * @param half OUT N x (M/2 + 1) complex, row-major
+ */
+void FFTBackend::unpackHalfSpectrum( const cv::Mat &packed, std::complex<float> *half )
+{
+  const int N = packed.rows;
+  const int M = packed.cols;
+  const int H = M/2 + 1;
+
+  for( int u=0; u<N; u++ )
+  {
+    const float *row = packed.ptr<float>( u );
+    std::complex<float> *out = half + (size_t)u * H;
+    for( int v=1; v<M/2; v++ ) {
+      out[v] = { row[2*v-1], row[2*v] };
+    }
+  }
+  for( int v : { 0, M/2 } )
+  {
+    int j = ( v == 0 ) ? 0 : M-1;
+    half[v] = { packed.at<float>( 0, j ), 0.f };
+    for( int k=1; k<N/2; k++ ) {
+      std::complex<float> value{ packed.at<float>( 2*k-1, j ),
+                                 packed.at<float>( 2*k, j ) };
+      half[(size_t)k * H + v] = value;
+      half[(size_t)( N-k ) * H + v] = std::conj( value );
+    }
+    half[(size_t)( N/2 ) * H + v] = { packed.at<float>( N-1, j ), 0.f };
+  }
+}
+
+/**
+ * Each backend is run once to build its plans, then timed over three runs
+ * of forward and inverse transforms; the best run counts.
+ *
+ * @param size of transform
+ * @return name of the fastest backend
+ */
+std::string FFTBackend::benchmark( cv::Size size )
+{
+  cv::Mat image( size, CV_32F );
+  cv::randu( image, 0.f, 255.f );
+
+  std::string fastest{ "opencv" };
+  int64 fastestTicks = std::numeric_limits<int64>::max();
+  for( auto backend : registry() )
+  {
+    if( !backend->supports( size ) )
+      continue;
+    cv::Mat spectrum, restored;
+    backend->forward( image, spectrum );
+    backend->inverse( spectrum, restored );
+
+    int64 ticks = std::numeric_limits<int64>::max();
+    for( int run=0; run<3; run++ )
+    {
+      int64 start = cv::getTickCount();
+      backend->forward( image, spectrum );
+      backend->inverse( spectrum, restored );
+      ticks = std::min( ticks, cv::getTickCount() - start );
+    }
+    if( ticks < fastestTicks )
+    {
+      fastestTicks = ticks;
+      fastest = backend->get_name();
+    }
+  }
+  return fastest;
+}
+
+}   // End namespace
+
+
+/**
+ * @brief All backends compiled in; OpenCV first.
+ *
+ * @return one instance of each, for the life of the process
+ */
+std::vector<NFIR::FFTBackend*>& registry(void)
+{
+  static NFIR::OpenCVFFT opencv;
+  static NFIR::BuiltinFFT builtin;
+  #ifdef USE_FFTW
+  static NFIR::FFTWBackend fftw;
+  static std::vector<NFIR::FFTBackend*> backends{ &opencv, &builtin, &fftw };
+  #else
+  static std::vector<NFIR::FFTBackend*> backends{ &opencv, &builtin };
+  #endif
+  return backends;
+}
+
+/**
+ * @param name of backend
+ * @return backend, nullptr if not compiled in
+ */
+NFIR::FFTBackend* find( const std::string &name )
+{
+  for( auto backend : registry() ) {
+    if( backend->get_name() == name )
+      return backend;
+  }
+  return nullptr;
+}
@@ -0,0 +1,360 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "fft_backend_builtin.h"
+
+#include <cmath>
+
+typedef std::complex<float> Complex;
+
+/**
+ * @brief Per-thread buffers of the transforms, kept between calls so that
+ * repeated transforms of one size allocate nothing.
+ */
+struct Workspace
+{
+  /** @brief Half spectrum, N x (M/2 + 1) */
+  std::vector<Complex> half;
+  /** @brief One row or column, input and output */
+  std::vector<Complex> z, Z;
+  /** @brief Conjugated input of the inverse transform */
+  std::vector<Complex> conjugated;
+  /** @brief Generic butterfly inputs */
+  std::vector<Complex> butterfly;
+};
+
+/** Library private methods declarations */
+static Workspace& threadWorkspace(void);
+static void transform( const NFIR::BuiltinFFT::Plan&, const Complex*, int, Complex*, bool,
+                       Workspace& );
+static void work( const NFIR::BuiltinFFT::Plan&, Complex*, const Complex*, int, int,
+                  const int*, std::vector<Complex>& );
+
+
+namespace NFIR {
+
+/** @return "builtin" */
+std::string BuiltinFFT::get_name(void) const
+{
+  return "builtin";
+}
+
+/**
+ * @param size transform rows and cols
+ * @return true if both even
+ */
+bool BuiltinFFT::supports( cv::Size size ) const
+{
+  return ( size.width % 2 == 0 ) && ( size.height % 2 == 0 );
+}
+
+/** @return plans cached, one per length */
+size_t BuiltinFFT::get_planCount(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  return _plans.size();
+}
+
+/**
+ * Row pass: two real rows a, b as one complex row z = a + ib; with Z its
+ * transform, A(k) = (Z(k) + conj Z(-k))/2 and B(k) = (Z(k) - conj Z(-k))/2i.
+ * Column pass: complex transform of each of the M/2 + 1 half spectrum columns.
+ *
+ * @param src real, CV_32F, N x M, both even
+ * @param dst OUT CCS packed spectrum, CV_32F, N x M
+ */
+void BuiltinFFT::forward( const cv::Mat &src, cv::Mat &dst )
+{
+  const int N = src.rows;
+  const int M = src.cols;
+  const int H = M/2 + 1;
+  auto rowPlan = acquire( M );
+  auto colPlan = acquire( N );
+
+  Workspace &ws = threadWorkspace();
+  ws.half.resize( (size_t)N * H );
+  ws.z.resize( std::max( N, M ) );
+  ws.Z.resize( std::max( N, M ) );
+  Complex *half = ws.half.data();
+  Complex *z = ws.z.data();
+  Complex *Z = ws.Z.data();
+
+  for( int r=0; r<N; r+=2 )
+  {
+    const float *a = src.ptr<float>( r );
+    const float *b = src.ptr<float>( r+1 );
+    for( int x=0; x<M; x++ ) {
+      z[x] = Complex( a[x], b[x] );
+    }
+    transform( *rowPlan, z, 1, Z, false, ws );
+    Complex *A = &half[(size_t)r * H];
+    Complex *B = A + H;
+    for( int k=0; k<H; k++ )
+    {
+      Complex zk = Z[k];
+      Complex zn = std::conj( Z[( M - k ) % M] );
+      A[k] = 0.5f * ( zk + zn );
+      B[k] = Complex( 0.f, -0.5f ) * ( zk - zn );
+    }
+  }
+
+  for( int v=0; v<H; v++ )
+  {
+    transform( *colPlan, &half[v], H, Z, false, ws );
+    for( int u=0; u<N; u++ ) {
+      half[(size_t)u * H + v] = Z[u];
+    }
+  }
+
+  dst.create( N, M, CV_32F );
+  packHalfSpectrum( half, dst );
+}
+
+/**
+ * Reverse of forward(): column inverse transforms of the half spectrum, then
+ * two real rows per complex row inverse transform, Z(k) = A(k) + iB(k).
+ *
+ * @param src CCS packed spectrum, CV_32F, N x M, both even
+ * @param dst OUT real, CV_32F, N x M
+ */
+void BuiltinFFT::inverse( const cv::Mat &src, cv::Mat &dst )
+{
+  const int N = src.rows;
+  const int M = src.cols;
+  const int H = M/2 + 1;
+  auto rowPlan = acquire( M );
+  auto colPlan = acquire( N );
+
+  Workspace &ws = threadWorkspace();
+  ws.half.resize( (size_t)N * H );
+  ws.z.resize( std::max( N, M ) );
+  ws.Z.resize( std::max( N, M ) );
+  Complex *half = ws.half.data();
+  Complex *z = ws.z.data();
+  Complex *Z = ws.Z.data();
+  unpackHalfSpectrum( src, half );
+
+  for( int v=0; v<H; v++ )
+  {
+    transform( *colPlan, &half[v], H, z, true, ws );
+    for( int u=0; u<N; u++ ) {
+      half[(size_t)u * H + v] = z[u];
+    }
+  }
+
+  dst.create( N, M, CV_32F );
+  for( int r=0; r<N; r+=2 )
+  {
+    const Complex *A = &half[(size_t)r * H];
+    const Complex *B = A + H;
+    for( int k=0; k<H; k++ ) {
+      Z[k] = A[k] + Complex( 0.f, 1.f ) * B[k];
+    }
+    for( int k=H; k<M; k++ ) {
+      Z[k] = std::conj( A[M-k] ) + Complex( 0.f, 1.f ) * std::conj( B[M-k] );
+    }
+    transform( *rowPlan, Z, 1, z, true, ws );
+    float *a = dst.ptr<float>( r );
+    float *b = dst.ptr<float>( r+1 );
+    for( int x=0; x<M; x++ )
+    {
+      a[x] = z[x].real();
+      b[x] = z[x].imag();
+    }
+  }
+}
+
+/**
+ * Factors 4, 2, 3, 5 first, then any other primes.
+ *
+ * @param n transform length
+ * @return shared, immutable plan
+ */
+std::shared_ptr<const BuiltinFFT::Plan> BuiltinFFT::acquire( int n )
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  auto it = _plans.find( n );
+  if( it != _plans.end() )
+    return it->second;
+
+  const double pi = 3.14159265358979323846;
+  auto plan = std::make_shared<Plan>();
+  plan->n = n;
+  int remaining = n;
+  for( int p : { 4, 2, 3, 5 } ) {
+    while( ( remaining > 1 ) && ( remaining % p == 0 ) ) {
+      remaining /= p;
+      plan->factors.push_back( p );
+      plan->factors.push_back( remaining );
+    }
+  }
+  for( int p=7; remaining>1; p+=2 ) {
+    while( remaining % p == 0 ) {
+      remaining /= p;
+      plan->factors.push_back( p );
+      plan->factors.push_back( remaining );
+    }
+  }
+  plan->twiddles.resize( n );
+  for( int k=0; k<n; k++ ) {
+    plan->twiddles[k] = std::polar( 1.0, -2.0 * pi * k / n );
+  }
+
+  _plans[n] = plan;
+  return plan;
+}
+
+}   // End namespace
+
+
+/**
+ * The BuiltinFFT instance is shared by all threads, see FFTBackend::select(),
+ * so its buffers are kept per thread.  They only grow.
+ *
+ * @return buffers of the calling thread
+ */
+Workspace& threadWorkspace(void)
+{
+  thread_local Workspace workspace;
+  return workspace;
+}
+
+/**
+ * @brief 1-D complex DFT, out of place.
+ *
+ * The inverse is conj(DFT(conj(x))), unscaled.
+ *
+ * @param plan for the length
+ * @param in input, strided
+ * @param inStride elements between inputs
+ * @param out OUT contiguous
+ * @param inverse direction
+ * @param ws buffers of the calling thread
+ */
+void transform( const NFIR::BuiltinFFT::Plan &plan, const Complex *in, int inStride,
+                Complex *out, bool inverse, Workspace &ws )
+{
+  if( !inverse )
+  {
+    work( plan, out, in, 1, inStride, plan.factors.data(), ws.butterfly );
+    return;
+  }
+  ws.conjugated.resize( plan.n );
+  Complex *conjugated = ws.conjugated.data();
+  for( int k=0; k<plan.n; k++ ) {
+    conjugated[k] = std::conj( in[(size_t)k * inStride] );
+  }
+  work( plan, out, conjugated, 1, 1, plan.factors.data(), ws.butterfly );
+  for( int k=0; k<plan.n; k++ ) {
+    out[k] = std::conj( out[k] );
+  }
+}
+
+/**
+ * @brief One decimation-in-time stage: transforms of the `radix`
+ * sub-sequences, then the butterflies.
+ *
+ * @param plan for the full length
+ * @param out OUT radix * m outputs
+ * @param in input of this stage
+ * @param fstride twiddle stride, product of the radices of the outer stages
+ * @param inStride elements between inputs of the full sequence
+ * @param factors radix, m of this stage, then those of the inner stages
+ * @param scratch generic butterfly buffer, kept by the caller
+ */
+void work( const NFIR::BuiltinFFT::Plan &plan, Complex *out, const Complex *in,
+           int fstride, int inStride, const int *factors, std::vector<Complex> &scratch )
+{
+  const int radix = factors[0];
+  const int m = factors[1];
+  const Complex *tw = plan.twiddles.data();
+
+  if( m == 1 ) {
+    for( int k=0; k<radix; k++ ) {
+      out[k] = in[(size_t)k * fstride * inStride];
+    }
+  }
+  else {
+    for( int k=0; k<radix; k++ ) {
+      work( plan, out + k*m, in + (size_t)k * fstride * inStride,
+            fstride * radix, inStride, factors + 2, scratch );
+    }
+  }
+
+  if( radix == 2 )
+  {
+    for( int k=0; k<m; k++ ) {
+      Complex t = out[k+m] * tw[k * fstride];
+      out[k+m] = out[k] - t;
+      out[k] += t;
+    }
+    return;
+  }
+
+  if( radix == 4 )
+  {
+    // Forward direction only, see transform(); the radix-4 kernel is
+    // 1, -i, -1, i.
+    for( int k=0; k<m; k++ ) {
+      Complex s0 = out[k];
+      Complex s1 = out[k+m] * tw[k * fstride];
+      Complex s2 = out[k+2*m] * tw[2 * k * fstride];
+      Complex s3 = out[k+3*m] * tw[3 * k * fstride];
+      Complex t0 = s0 + s2;
+      Complex t1 = s0 - s2;
+      Complex t2 = s1 + s3;
+      Complex t3( ( s1 - s3 ).imag(), -( s1 - s3 ).real() );   // -i (s1 - s3)
+      out[k] = t0 + t2;
+      out[k+m] = t1 + t3;
+      out[k+2*m] = t0 - t2;
+      out[k+3*m] = t1 - t3;
+    }
+    return;
+  }
+
+  // Generic butterfly; the twiddle index combines the stage twiddle and the
+  // radix-point DFT kernel.
+  scratch.resize( radix );
+  for( int u=0; u<m; u++ )
+  {
+    for( int q=0; q<radix; q++ ) {
+      scratch[q] = out[u + q*m];
+    }
+    for( int q1=0, k=u; q1<radix; q1++, k+=m )
+    {
+      int twidx = 0;
+      Complex sum = scratch[0];
+      for( int q=1; q<radix; q++ ) {
+        twidx += fstride * k;
+        if( twidx >= plan.n )
+          twidx -= plan.n;
+        sum += scratch[q] * tw[twidx];
+      }
+      out[k] = sum;
+    }
+  }
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#ifdef USE_FFTW
+
+#include "fft_backend_fftw.h"
+
+#include <algorithm>
+#include <complex>
+
+namespace NFIR {
+
+FFTWBackend::~FFTWBackend()
+{
+  for( auto &entry : _plans ) {
+    fftwf_destroy_plan( entry.second );
+  }
+}
+
+/** @return "fftw" */
+std::string FFTWBackend::get_name(void) const
+{
+  return "fftw";
+}
+
+/**
+ * @param size transform rows and cols
+ * @return true if both even
+ */
+bool FFTWBackend::supports( cv::Size size ) const
+{
+  return ( size.width % 2 == 0 ) && ( size.height % 2 == 0 );
+}
+
+/** @return plans cached */
+size_t FFTWBackend::get_planCount(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  return _plans.size();
+}
+
+/**
+ * @param src real, CV_32F, N x M, both even
+ * @param dst OUT CCS packed spectrum, CV_32F, N x M
+ */
+void FFTWBackend::forward( const cv::Mat &src, cv::Mat &dst )
+{
+  const int N = src.rows;
+  const int M = src.cols;
+  const int H = M/2 + 1;
+  fftwf_plan plan = acquire( N, M, false );
+
+  float *in = fftwf_alloc_real( (size_t)N * M );
+  fftwf_complex *out = fftwf_alloc_complex( (size_t)N * H );
+  for( int r=0; r<N; r++ ) {
+    std::copy( src.ptr<float>( r ), src.ptr<float>( r ) + M, in + (size_t)r * M );
+  }
+  fftwf_execute_dft_r2c( plan, in, out );
+
+  dst.create( N, M, CV_32F );
+  packHalfSpectrum( reinterpret_cast<std::complex<float>*>( out ), dst );
+  fftwf_free( in );
+  fftwf_free( out );
+}
+
+/**
+ * @param src CCS packed spectrum, CV_32F, N x M, both even
+ * @param dst OUT real, CV_32F, N x M
+ */
+void FFTWBackend::inverse( const cv::Mat &src, cv::Mat &dst )
+{
+  const int N = src.rows;
+  const int M = src.cols;
+  const int H = M/2 + 1;
+  fftwf_plan plan = acquire( N, M, true );
+
+  fftwf_complex *in = fftwf_alloc_complex( (size_t)N * H );
+  float *out = fftwf_alloc_real( (size_t)N * M );
+  unpackHalfSpectrum( src, reinterpret_cast<std::complex<float>*>( in ) );
+  fftwf_execute_dft_c2r( plan, in, out );
+
+  dst.create( N, M, CV_32F );
+  for( int r=0; r<N; r++ ) {
+    std::copy( out + (size_t)r * M, out + (size_t)( r+1 ) * M, dst.ptr<float>( r ) );
+  }
+  fftwf_free( in );
+  fftwf_free( out );
+}
+
+/**
+ * FFTW_MEASURE overwrites the arrays while planning; plan on scratch arrays.
+ *
+ * @param rows N
+ * @param cols M
+ * @param inverse complex-to-real if true
+ * @return plan, owned by this object
+ */
+fftwf_plan FFTWBackend::acquire( int rows, int cols, bool inverse )
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  auto key = std::make_tuple( rows, cols, inverse );
+  auto it = _plans.find( key );
+  if( it != _plans.end() )
+    return it->second;
+
+  float *real = fftwf_alloc_real( (size_t)rows * cols );
+  fftwf_complex *spectrum = fftwf_alloc_complex( (size_t)rows * ( cols/2 + 1 ) );
+  fftwf_plan plan = inverse
+    ? fftwf_plan_dft_c2r_2d( rows, cols, spectrum, real, FFTW_MEASURE )
+    : fftwf_plan_dft_r2c_2d( rows, cols, real, spectrum, FFTW_MEASURE );
+  fftwf_free( real );
+  fftwf_free( spectrum );
+
+  _plans[key] = plan;
+  return plan;
+}
+
+/**
+ * @param path NFIR wisdom file; FFTW wisdom is read from `path.fftw`
+ */
+void FFTWBackend::importWisdom( const std::string &path )
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  fftwf_import_wisdom_from_filename( ( path + ".fftw" ).c_str() );
+}
+
+/**
+ * @param path NFIR wisdom file; FFTW wisdom is written to `path.fftw`
+ */
+void FFTWBackend::exportWisdom( const std::string &path ) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  fftwf_export_wisdom_to_filename( ( path + ".fftw" ).c_str() );
+}
+
+}   // End namespace
+
+#endif
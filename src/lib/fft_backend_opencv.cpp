@@ -0,0 +1,119 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "fft_backend_opencv.h"
+
+#include <opencv2/core/hal/hal.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <tuple>
+#include <utility>
+
+/** @brief Plans created by all threads */
+static std::atomic<size_t> planCount{ 0 };
+/**
+ * @brief Plans kept per thread, most recently used; a forward and an
+ * inverse plan per size, for a few sizes
+ */
+static constexpr size_t planCapacity{ 8 };
+
+
+namespace NFIR {
+
+/** @return "opencv" */
+std::string OpenCVFFT::get_name(void) const
+{
+  return "opencv";
+}
+
+/**
+ * @param src real, CV_32F
+ * @param dst OUT CCS packed spectrum, CV_32F, same size
+ */
+void OpenCVFFT::forward( const cv::Mat &src, cv::Mat &dst )
+{
+  dst.create( src.size(), CV_32F );
+  apply( src, dst, 0 );
+}
+
+/**
+ * @param src CCS packed spectrum, CV_32F
+ * @param dst OUT real, CV_32F, same size
+ */
+void OpenCVFFT::inverse( const cv::Mat &src, cv::Mat &dst )
+{
+  dst.create( src.size(), CV_32F );
+  apply( src, dst, CV_HAL_DFT_INVERSE );
+}
+
+/** @return plans created, all threads */
+size_t OpenCVFFT::get_planCount(void) const
+{
+  return planCount;
+}
+
+/**
+ * Same flags as `cv::dft` passes to the HAL for real input/output.
+ *
+ * Each thread keeps its own plans, as a plan holds its scratch buffers;
+ * the least recently used is dropped beyond `planCapacity`, so that a long
+ * batch of mixed image sizes does not keep a plan for every size.
+ *
+ * @param src CV_32F
+ * @param dst OUT allocated, CV_32F, same size
+ * @param direction 0 or CV_HAL_DFT_INVERSE
+ */
+void OpenCVFFT::apply( const cv::Mat &src, cv::Mat &dst, int direction ) const
+{
+  int flags = direction;
+  if( src.isContinuous() && dst.isContinuous() )
+    flags |= CV_HAL_DFT_IS_CONTINUOUS;
+  if( src.data == dst.data )
+    flags |= CV_HAL_DFT_IS_INPLACE;
+
+  using Key = std::tuple<int,int,int>;
+  thread_local std::list<std::pair<Key, cv::Ptr<cv::hal::DFT2D>>> plans;
+  const Key key = std::make_tuple( src.rows, src.cols, flags );
+  auto it = std::find_if( plans.begin(), plans.end(),
+                          [&key]( const std::pair<Key, cv::Ptr<cv::hal::DFT2D>> &p ) {
+                            return p.first == key; } );
+  if( it != plans.end() )
+    plans.splice( plans.begin(), plans, it );
+  else
+  {
+    plans.emplace_front( key, cv::hal::DFT2D::create( src.cols, src.rows,
+                                                      CV_32F, 1, 1, flags, 0 ) );
+    planCount++;
+    if( plans.size() > planCapacity )
+      plans.pop_back();
+  }
+  plans.front().second->apply( src.data, src.step, dst.data, dst.step );
+}
+
+}   // End namespace
@@ -25,13 +25,16 @@ identification imply recommendation or endorsement by the National Institute
 of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
+#include "exceptions.h"
 #include "filter_mask.h"
+#include "filter_mask_cache.h"
 
 namespace NFIR {
 
 /** Set source and target rates to 500PPI, mask radius factor to 1.0. */
 void FilterMask::Init()
 {
+  _maskSize = cv::Size{};
   _srcSampleRate = 500;
   _tgtSampleRate = 500;
   _maskRadiusFactor = 1.0;
@@ -47,6 +50,7 @@ void FilterMask::Copy( const FilterMask& aCopy )
   _srcSampleRate = aCopy._srcSampleRate;
   _tgtSampleRate = aCopy._tgtSampleRate;
   _maskRadiusFactor = aCopy._maskRadiusFactor;
+  _maskSize = aCopy._maskSize;
 }
 
 FilterMask::FilterMask()
@@ -88,6 +92,104 @@ FilterMask::FilterType FilterMask::get_filterType(void) const
  */
 void FilterMask::build( cv::Size ) { }
 
+/**
+ * The filter/mask is looked up in the process-wide FilterMaskCache.
+ * On a miss, the mask is built and its compact representation, see
+ * get_cacheEntry(), is cached.
+ *
+ * On a hit, only that compact representation is restored; the full-size mask
+ * returned by the base class get_theFilterMask() is empty.  Cached data is
+ * shared with the cache and must not be modified.
+ *
+ * @param mask_size width and height in pixels
+ * @return true on cache hit
+ */
+bool FilterMask::acquire( cv::Size mask_size )
+{
+  FilterMaskCache::Key key{ mask_size.height, mask_size.width,
+                            _srcSampleRate, _tgtSampleRate, get_filterType() };
+  cv::Mat entry;
+  if( FilterMaskCache::instance().lookup( key, entry ) )
+  {
+    set_cacheEntry( mask_size, entry );
+    return true;
+  }
+
+  build( mask_size );
+  FilterMaskCache::instance().insert( key, get_cacheEntry() );
+  return false;
+}
+
+/**
+ * Default implementation multiplies by the packed filter/mask.  Since the
+ * mask is real-valued, the complex multiplication of each frequency reduces
+ * to an element-by-element multiplication of the packed arrays.
+ *
+ * @param packedSpectrum IN/OUT CCS packed spectrum, same size as the mask
+ * @param scale folded into the mask, eg, DFT normalization
+ */
+void FilterMask::applyPacked( cv::Mat &packedSpectrum, float scale ) const
+{
+  checkPackedSize( packedSpectrum );
+  cv::multiply( packedSpectrum, _thePackedFilterMask, packedSpectrum, scale );
+}
+
+/**
+ * Default implementation reads the packed filter/mask.
+ *
+ * @param u row frequency 0..N-1
+ * @param v column frequency 0..M-1
+ * @return mask value, (M(u,v) + M(-u,-v))/2
+ */
+float FilterMask::get_value( int u, int v ) const
+{
+  int N = _thePackedFilterMask.rows;
+  int M = _thePackedFilterMask.cols;
+  if( v > M/2 ) {               // point reflection has the same value
+    u = ( N - u ) % N;
+    v = M - v;
+  }
+  if( ( v == 0 ) || ( v == M/2 ) )
+  {
+    int j = ( v == 0 ) ? 0 : M-1;
+    if( u > N/2 )
+      u = N - u;
+    int i = ( u == 0 ) ? 0 : ( u == N/2 ) ? N-1 : 2*u-1;
+    return _thePackedFilterMask.at<float>( i, j );
+  }
+  return _thePackedFilterMask.at<float>( u, 2*v-1 );
+}
+
+/**
+ * Default implementation: no separable space-domain equivalent.
+ *
+ * @param kernelRows OUT unchanged
+ * @param kernelCols OUT unchanged
+ * @param offset OUT unchanged
+ * @return false
+ */
+bool FilterMask::get_spatialKernels( cv::Mat&, cv::Mat&, float& ) const
+{
+  return false;
+}
+
+/** @return default is the packed filter/mask */
+cv::Mat FilterMask::get_cacheEntry(void) const
+{
+  return _thePackedFilterMask;
+}
+
+/**
+ * @param mask_size width and height in pixels
+ * @param entry from get_cacheEntry()
+ */
+void FilterMask::set_cacheEntry( cv::Size mask_size, cv::Mat entry )
+{
+  _maskSize = mask_size;
+  _theFilterMask.release();
+  _thePackedFilterMask = entry;
+}
+
 /** @return value to configure the mask size */
 double FilterMask::get_maskRadiusFactor(void) const
 {
@@ -100,4 +202,78 @@ cv::Mat FilterMask::get_theFilterMask(void) const
   return _theFilterMask;
 }
 
+/** @return this instance mask in packed (CCS) layout, same size as the mask */
+cv::Mat FilterMask::get_thePackedFilterMask(void) const
+{
+  return _thePackedFilterMask;
+}
+
+/**
+ * The forward DFT of a real-valued image is conjugate-symmetric, so OpenCV
+ * stores only half of it in a single-channel, "packed" array (the
+ * CCS format) that is the same size as the image:
+ *
+ * ```
+ *  col  0        1        2       ...  M-2       M-1 (M even)
+ *  Re Y(0,0)  Re Y(0,1) Im Y(0,1) ... Im Y(0,M/2-1)  Re Y(0,M/2)
+ *  Re Y(1,0)  Re Y(1,1) Im Y(1,1) ... Im Y(1,M/2-1)  Re Y(1,M/2)
+ *  Im Y(1,0)  Re Y(2,1) Im Y(2,1) ... Im Y(2,M/2-1)  Im Y(1,M/2)
+ *  ...
+ *  Re Y(N/2,0) Re Y(N-1,1) ...        Im Y(N-1,M/2-1) Re Y(N/2,M/2) (N even)
+ * ```
+ *
+ * Since the filter/mask is real-valued, applying it to the spectrum is an
+ * element-by-element multiplication of the packed array by a packed mask
+ * whose every element holds the mask value of the frequency that element
+ * belongs to.
+ *
+ * The full-size mask is averaged with its point reflection, M(-u,-v).  The
+ * real part of the inverse DFT of the complex spectrum multiplied by M is
+ * identical to the inverse DFT of the spectrum multiplied by this symmetric
+ * part; therefore, the packed path generates the same image as the full,
+ * complex path.
+ */
+void FilterMask::pack(void)
+{
+  int N = _theFilterMask.rows;
+  int M = _theFilterMask.cols;
+  // Always allocate; the previous packed mask may be shared with the cache.
+  cv::Mat packed( N, M, CV_32F );
+
+  for( int i=0; i<N; i++ )
+  {
+    float *packedRow = packed.ptr<float>(i);
+    for( int j=0; j<M; j++ )
+    {
+      // Column 0 and, for even M, column M-1 hold the DC and Nyquist columns
+      // in packed row order; all other columns hold (Re,Im) pairs per row.
+      bool isPackedCol = ( j == 0 ) || ( ( M % 2 == 0 ) && ( j == M-1 ) );
+      int u = isPackedCol ? ( i == 0 ? 0 : (i+1)/2 ) : i;
+      int v = ( j == 0 ) ? 0 : (j+1)/2;
+      packedRow[j] = 0.5f * ( _theFilterMask.at<float>( u, v )
+                           + _theFilterMask.at<float>( (N-u) % N, (M-v) % M ) );
+    }
+  }
+  _thePackedFilterMask = packed;
+}
+
+/**
+ * The mask is applied row by row over its own size; a spectrum of another
+ * size, eg, one tile of an image masked for the whole, would be overrun.
+ *
+ * @param packedSpectrum CCS packed spectrum to be multiplied by the mask
+ *
+ * @throw NFIR::Miscue spectrum and mask sizes differ
+ */
+void FilterMask::checkPackedSize( const cv::Mat &packedSpectrum ) const
+{
+  if( packedSpectrum.size() != _maskSize )
+    throw NFIR::Miscue( "NFIR lib: spectrum size "
+                        + std::to_string(packedSpectrum.cols) + "x"
+                        + std::to_string(packedSpectrum.rows)
+                        + " differs from filter/mask size "
+                        + std::to_string(_maskSize.width) + "x"
+                        + std::to_string(_maskSize.height) );
+}
+
 }   // End namespace
@@ -0,0 +1,166 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "filter_mask_cache.h"
+
+static size_t byteSize( const cv::Mat& );
+
+namespace NFIR {
+
+FilterMaskCache::FilterMaskCache()
+  : _size{0}, _capacity{defaultCapacity}, _hits{0}, _misses{0}
+{ }
+
+/** @return reference to the function-local static instance */
+FilterMaskCache& FilterMaskCache::instance(void)
+{
+  static FilterMaskCache theCache;
+  return theCache;
+}
+
+/**
+ * On a hit the mask becomes the most-recently-used.
+ *
+ * @param key of the mask
+ * @param mask OUT shares data with the cached mask; unchanged on miss
+ *
+ * @return true if found
+ */
+bool FilterMaskCache::lookup( const Key &key, cv::Mat &mask )
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  auto it = _index.find( key );
+  if( it == _index.end() )
+  {
+    _misses++;
+    return false;
+  }
+  _hits++;
+  _lru.splice( _lru.begin(), _lru, it->second );
+  mask = it->second->second;
+  return true;
+}
+
+/**
+ * Replaces a mask with the same key.  The cache keeps a reference to the
+ * mask data; the caller must not modify it afterwards.
+ *
+ * @param key of the mask
+ * @param mask to cache
+ */
+void FilterMaskCache::insert( const Key &key, const cv::Mat &mask )
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  size_t bytes = byteSize( mask );
+  if( mask.empty() || ( bytes > _capacity ) )
+    return;
+
+  auto it = _index.find( key );
+  if( it != _index.end() )
+  {
+    _size -= byteSize( it->second->second );
+    _lru.erase( it->second );
+    _index.erase( it );
+  }
+  _lru.emplace_front( key, mask );
+  _index[key] = _lru.begin();
+  _size += bytes;
+  evict();
+}
+
+void FilterMaskCache::clear(void)
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  _lru.clear();
+  _index.clear();
+  _size = 0;
+}
+
+/**
+ * Masks are evicted immediately if the cache is over the new capacity.
+ *
+ * @param bytes memory cap
+ */
+void FilterMaskCache::set_capacity( size_t bytes )
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  _capacity = bytes;
+  evict();
+}
+
+size_t FilterMaskCache::get_capacity(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  return _capacity;
+}
+
+uint64_t FilterMaskCache::get_hits(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  return _hits;
+}
+
+uint64_t FilterMaskCache::get_misses(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  return _misses;
+}
+
+/** @return hits, misses, entries, and bytes */
+std::string FilterMaskCache::to_s(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  std::string s{"FILTER MASK cache: "};
+  s.append(   "hits: "     + std::to_string(_hits) );
+  s.append( ", misses: "   + std::to_string(_misses) );
+  s.append( ", entries: "  + std::to_string(_lru.size()) );
+  s.append( ", bytes: "    + std::to_string(_size) );
+  s.append( ", capacity: " + std::to_string(_capacity) );
+  return s;
+}
+
+/** Caller holds the lock. */
+void FilterMaskCache::evict(void)
+{
+  while( ( _size > _capacity ) && !_lru.empty() )
+  {
+    _size -= byteSize( _lru.back().second );
+    _index.erase( _lru.back().first );
+    _lru.pop_back();
+  }
+}
+
+}   // End namespace
+
+/**
+ * @param m matrix
+ * @return bytes of matrix data
+ */
+size_t byteSize( const cv::Mat &m )
+{
+  return m.total() * m.elemSize();
+}
@@ -26,10 +26,15 @@ of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #include "filter_mask_gaussian.h"
+#include "spectrum_kernels.h"
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <cmath>
+
 static void quadrantSwap( cv::Mat );
+static cv::Mat periodicKernel( const cv::Mat & );
+static int truncationRadius( const cv::Mat &, double );
 
 namespace NFIR {
 
@@ -63,12 +68,28 @@ FilterMask::FilterType Gaussian::get_filterType(void) const
 
 /**
  * Gaussian "curve" is based on size of source image in both x- and y- directions.
- * Normalize and shift (ie, quadrant swap) the mask.
  *
- * @param mask_size width and height in pixels
+ * The full mask is the min-max normalized outer product of the two kernels,
+ * quadrant swapped (shifted), see get_theFilterMask().  Instead of building
+ * it, keep each kernel as a 1-D profile that is already shifted, ie, indexed
+ * by frequency.  Since the mask is applied to the spectrum of a real-valued
+ * image, each profile is averaged with its reflection, p(k) = p(-k).
+ *
+ * With kernel extrema kmin and kmax, the normalized mask is
+ * `(kx*ky - kminx*kminy) / (kmaxx*kmaxy - kminx*kminy)`; the scale is folded
+ * into the row profile and the remainder is a constant offset.
+ *
+ * The column profile is stored by packed (CCS) column so that a row of the
+ * packed spectrum is multiplied by `a * colProfile[j] + offset`.
+ *
+ * @param mask_size width and height in pixels, both even
  */
 void Gaussian::build( cv::Size mask_size )
 {
+  _maskSize = mask_size;
+  int N = mask_size.height;
+  int M = mask_size.width;
+
   double sigmaHeight = _maskRadiusFactor * mask_size.height / 2.0;
   double sigmaWidth = _maskRadiusFactor * mask_size.width / 2.0;
 
@@ -76,6 +97,175 @@ void Gaussian::build( cv::Size mask_size )
   cv::Mat kernelX = cv::getGaussianKernel( mask_size.height, sigmaHeight, CV_32F );
   cv::Mat kernelY = cv::getGaussianKernel( mask_size.width,  sigmaWidth,  CV_32F );
 
+  // Extrema of the outer product are the products of the extrema.
+  double minX, maxX, minY, maxY;
+  cv::minMaxLoc( kernelX, &minX, &maxX );
+  cv::minMaxLoc( kernelY, &minY, &maxY );
+  double minXY = minX * minY;
+  double gain = 1.0 / ( maxX * maxY - minXY );
+
+  cv::Mat profiles( 1, N + M + 1, CV_32F );
+  float *rowProfile = profiles.ptr<float>();
+  float *colProfile = rowProfile + N;
+  const float *kx = kernelX.ptr<float>();
+  const float *ky = kernelY.ptr<float>();
+
+  // Shift: frequency k is at kernel index (k + N/2) mod N.
+  for( int u=0; u<N; u++ ) {
+    rowProfile[u] = (float)( gain * 0.5
+                  * ( kx[(N/2 + u) % N] + kx[(N/2 - u + N) % N] ) );
+  }
+  for( int j=0; j<M; j++ ) {
+    int v = ( j == 0 ) ? 0 : (j+1)/2;
+    colProfile[j] = 0.5f * ( ky[(M/2 + v) % M] + ky[(M/2 - v + M) % M] );
+  }
+  rowProfile[N + M] = (float)( -minXY * gain );    // offset
+
+  _profiles = profiles;
+}
+
+/**
+ * Packed row i holds row frequency i, except packed columns 0 and M-1 (DC
+ * and Nyquist column frequencies) that hold row frequency (i+1)/2.
+ *
+ * The scale is folded into the row gain and the offset; each row is then one
+ * vectorized pass, see SpectrumKernels::multiplyAffine().
+ *
+ * @param packedSpectrum IN/OUT CCS packed spectrum, same size as the mask
+ * @param scale folded into the mask, eg, DFT normalization
+ */
+void Gaussian::applyPacked( cv::Mat &packedSpectrum, float scale ) const
+{
+  checkPackedSize( packedSpectrum );
+  int N = _maskSize.height;
+  int M = _maskSize.width;
+  const float *rowProfile = _profiles.ptr<float>();
+  const float *colProfile = rowProfile + N;
+  const float offset = rowProfile[N + M] * scale;
+
+  for( int i=0; i<N; i++ )
+  {
+    float *row = packedSpectrum.ptr<float>(i);
+    const float a = rowProfile[i] * scale;
+    SpectrumKernels::multiplyAffine( row + 1, colProfile + 1, a, offset, M-2 );
+    const float ap = rowProfile[ ( i == 0 ) ? 0 : (i+1)/2 ] * scale;
+    row[0] *= ap * colProfile[0] + offset;
+    row[M-1] *= ap * colProfile[M-1] + offset;
+  }
+}
+
+/**
+ * @param u row frequency 0..N-1
+ * @param v column frequency 0..M-1
+ * @return mask value
+ */
+float Gaussian::get_value( int u, int v ) const
+{
+  int N = _maskSize.height;
+  int M = _maskSize.width;
+  const float *rowProfile = _profiles.ptr<float>();
+  const float *colProfile = rowProfile + N;
+
+  if( v > M/2 )                 // profiles are symmetric
+    v = M - v;
+  int j = ( v == 0 ) ? 0 : ( v == M/2 ) ? M-1 : 2*v-1;
+  return rowProfile[u] * colProfile[j] + rowProfile[N + M];
+}
+
+/**
+ * Since the mask is `rowProfile(u) * colProfile(v) + offset`, multiplication
+ * in the frequency domain equals the separable convolution with the inverse
+ * DFT of each profile plus `offset` times the image.
+ *
+ * A Gaussian of standard deviation `factor * N/2` frequency bins would
+ * transform to a Gaussian of standard deviation `1/(pi * factor)` pixels;
+ * but for mild ratios the profile is cut off well above zero at the Nyquist
+ * frequency, and the kernel has a long, slowly decaying tail.  So each
+ * kernel is the full inverse DFT of its profile, truncated where the
+ * absolute mass left outside falls below 1e-3 of the profile peak; the
+ * frequency response is then that close to the mask, per axis.
+ *
+ * @param kernelRows OUT column vector, applied along image columns (y)
+ * @param kernelCols OUT column vector, applied along image rows (x)
+ * @param offset OUT weight of the image itself
+ * @return false if a kernel is not short, ie, needs half the mask size or
+ *         more; the mask is then applied in the frequency domain only
+ */
+bool Gaussian::get_spatialKernels( cv::Mat &kernelRows, cv::Mat &kernelCols,
+                                   float &offset ) const
+{
+  const double tolerance = 1e-3;
+  int N = _maskSize.height;
+  int M = _maskSize.width;
+  const float *rowProfile = _profiles.ptr<float>();
+  const float *colProfile = rowProfile + N;
+
+  // Both profiles indexed by frequency, 0..N-1 and 0..M-1.
+  cv::Mat rows( 1, N, CV_64F ), cols( 1, M, CV_64F );
+  for( int u=0; u<N; u++ ) {
+    rows.at<double>( u ) = rowProfile[u];
+  }
+  for( int v=0; v<M; v++ ) {
+    int w = ( v > M/2 ) ? M - v : v;
+    int j = ( w == 0 ) ? 0 : ( w == M/2 ) ? M-1 : 2*w-1;
+    cols.at<double>( v ) = colProfile[j];
+  }
+
+  cv::Mat fullRows = periodicKernel( rows );
+  cv::Mat fullCols = periodicKernel( cols );
+  double peakRows, peakCols;    // the profiles are positive
+  cv::minMaxLoc( rows, nullptr, &peakRows );
+  cv::minMaxLoc( cols, nullptr, &peakCols );
+  int radiusY = truncationRadius( fullRows, tolerance * peakRows );
+  int radiusX = truncationRadius( fullCols, tolerance * peakCols );
+  if( ( radiusY < 0 ) || ( radiusX < 0 ) )
+    return false;
+
+  kernelRows.create( 2*radiusY + 1, 1, CV_32F );
+  kernelCols.create( 2*radiusX + 1, 1, CV_32F );
+  for( int x=-radiusY; x<=radiusY; x++ ) {
+    kernelRows.at<float>( x + radiusY ) = (float)fullRows.at<double>( ( x + N ) % N );
+  }
+  for( int x=-radiusX; x<=radiusX; x++ ) {
+    kernelCols.at<float>( x + radiusX ) = (float)fullCols.at<double>( ( x + M ) % M );
+  }
+  offset = rowProfile[N + M];
+  return true;
+}
+
+/** @return 1 x (N + M + 1) profiles and offset */
+cv::Mat Gaussian::get_cacheEntry(void) const
+{
+  return _profiles;
+}
+
+/**
+ * @param mask_size width and height in pixels
+ * @param entry from get_cacheEntry()
+ */
+void Gaussian::set_cacheEntry( cv::Size mask_size, cv::Mat entry )
+{
+  _maskSize = mask_size;
+  _profiles = entry;
+}
+
+/**
+ * Build the full mask as originally specified: min-max normalize the outer
+ * product of the kernels and shift (ie, quadrant swap) it.
+ *
+ * Not used by the downsample; available for inspection of the filter/mask.
+ *
+ * @return mask, same size as the padded image
+ */
+cv::Mat Gaussian::get_theFilterMask(void) const
+{
+  double sigmaHeight = _maskRadiusFactor * _maskSize.height / 2.0;
+  double sigmaWidth = _maskRadiusFactor * _maskSize.width / 2.0;
+
+  // OpenCV Gaussian kernel generator
+  cv::Mat kernelX = cv::getGaussianKernel( _maskSize.height, sigmaHeight, CV_32F );
+  cv::Mat kernelY = cv::getGaussianKernel( _maskSize.width,  sigmaWidth,  CV_32F );
+
   // create 2d gaus - must transpose the col-vector to row-vector.
   cv::Mat kernel = kernelX * kernelY.t();
   cv::Mat normKernel;
@@ -83,12 +273,58 @@ void Gaussian::build( cv::Size mask_size )
 
   quadrantSwap( normKernel );
 
-  _theFilterMask = normKernel.clone();
+  return normKernel;
 }
 
 }   // End namespace
  
 
+/**
+ * @brief Inverse DFT of a real, symmetric profile, p(k) = p(-k).
+ *
+ * Its spectrum is real and symmetric too, so the forward DFT, scaled,
+ * gives the same taps.
+ *
+ * @param profile 1 x N, indexed by frequency
+ * @return 1 x N kernel, tap x at index x mod N
+ */
+cv::Mat periodicKernel( const cv::Mat &profile )
+{
+  cv::Mat spectrum;
+  cv::dft( profile, spectrum, cv::DFT_COMPLEX_OUTPUT );
+  cv::Mat planes[2];
+  cv::split( spectrum, planes );
+  cv::Mat kernel;
+  planes[0].convertTo( kernel, CV_64F, 1.0 / profile.total() );
+  return kernel;
+}
+
+/**
+ * @brief Smallest radius r such that the absolute mass of the taps beyond
+ * -r..r is at most the tolerance.
+ *
+ * @param kernel 1 x N, tap x at index x mod N
+ * @param tolerance absolute mass
+ * @return radius; -1 if it would reach N/2
+ */
+int truncationRadius( const cv::Mat &kernel, double tolerance )
+{
+  const int N = (int)kernel.total();
+  const double *k = kernel.ptr<double>();
+  double outside = 0.0;
+  for( int x=1; x<N; x++ ) {
+    outside += std::abs( k[x] );
+  }
+  for( int r=0; r<N/2; r++ )
+  {
+    if( r > 0 )
+      outside -= std::abs( k[r] ) + std::abs( k[N-r] );
+    if( outside <= tolerance )
+      return r;
+  }
+  return -1;
+}
+
 /**
  * @brief Also known as a "shift".
  *
@@ -26,9 +26,13 @@ of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #include "filter_mask_ideal.h"
+#include "spectrum_kernels.h"
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace NFIR {
 
 Ideal::Ideal( const Ideal& aCopy ) : FilterMask::FilterMask( aCopy )
@@ -59,26 +63,25 @@ FilterMask::FilterType Ideal::get_filterType(void) const
 }
 
 /**
- * Use Meshgrid for mask shape using the ellipse.
- *
- * Per "classical" ellipse theory, the major-axis is the longer of the two.
- * For example, for an image/mask that is wider than higher, the x-axis is
- * the major-axis and the y-axis is the minor axis.
- * This is the ellipse formula:  `x^2/a^2  +  y^2/b^2  = 1   when a > b`
+ * Closed-form mask shape using the ellipse.
  *
- * However, using the meshgrid technique, there is no need to keep track of
- * major/minor axes.
+ * Frequencies are signed, ie, in FFT (unshifted) order, column j holds
+ * frequency `x = j` for `j <= M/2`, else `j - M`; likewise row i holds `y`.
  *
- * Scale the meshgrid arrays by the ellipse horizontal (a) and vertical (b)
- * vertices.  The vertices are one-half the width and height of the
+ * The ellipse vertices (semi-axes) are one-half the width and height of the
  * 2-dimensional mask (where the mask is same cv::Size as the padded source
- * image).
+ * image) scaled by the mask radius factor:
+ *
+ * `a = factor * M/2`, `b = factor * N/2`, and a frequency is inside
+ * (passed by the lowpass filter) when `x^2/a^2 + y^2/b^2 < 1`.
  *
- * Calculate the magnitude of the scaled meshgrids using cv::magnitude(a,b).
- * It is this `meshgridScaledMagnitude' array that is "traversed" and "checked"
- * against a "distance" -OR- cut-off frequency.
+ * This is the same cut-off as the original meshgrid technique, which
+ * compared the magnitude of the meshgrids scaled by `N/(2*factor)` and
+ * `M/(2*factor)` to a "distance discriminator" of `M*N/4`.  That inequality
+ * is kept as-is (in double precision) to decide the boundary frequencies.
  *
- * Save filter/mask to instance variable.
+ * Per row, the frequencies inside form the interval `[-x_max, x_max]`; only
+ * `x_max` is saved.  No meshgrid or mask plane is allocated.
  *
  * @param mask_size `width` x `height` that is same size as image to resample
  */
@@ -87,85 +90,124 @@ void Ideal::build( cv::Size mask_size )
   // M x N  :  width x height
   int M = mask_size.width;     // count cols
   int N = mask_size.height;    // count rows
-
-  cv::Mat meshgridRows = cv::Mat( N, M, CV_32F );
-  cv::Mat meshgridCols = cv::Mat( N, M, CV_32F );
-
-  for(int i=0; i<N; i++)
+  _maskSize = mask_size;
+
+  // Scale factors of the meshgrid technique and its distance discriminator.
+  double scaleX = N / (2.0 * _maskRadiusFactor);
+  double scaleY = M / (2.0 * _maskRadiusFactor);
+  double distDiscriminator = M * (double)N / 4.0;
+  double distSquared = distDiscriminator * distDiscriminator;
+
+  auto inside = [&]( int x, int y ) {
+    double sx = scaleX * x;
+    double sy = scaleY * y;
+    return ( sx*sx + sy*sy ) < distSquared;
+  };
+
+  cv::Mat halfWidths( 1, N, CV_32S );
+  int *xMax = halfWidths.ptr<int>();
+  for( int i=0; i<N; i++ )
   {
-    for(int j=0; j<M; j++)
-    {
-      if(j <= M/2)
-        meshgridRows.at<float>(i,j) = (float)(j);
-      else
-        meshgridRows.at<float>(i,j) = (float)(j) - M;
+    int y = ( i <= N/2 ) ? i : i - N;
+    double sy = scaleY * y;
+    double remaining = distSquared - sy*sy;
+    if( remaining <= 0.0 ) {
+      xMax[i] = -1;
+      continue;
     }
+    // Largest x strictly inside, then settle any rounding at the boundary.
+    int x = (int)std::ceil( std::sqrt( remaining ) / scaleX ) - 1;
+    x = std::min( std::max( x, -1 ), M/2 );
+    while( ( x < M/2 ) && inside( x+1, y ) ) { x++; }
+    while( ( x >= 0 ) && !inside( x, y ) ) { x--; }
+    xMax[i] = x;
   }
+  _halfWidths = halfWidths;
+}
+
+/**
+ * Packed row i holds row frequency i, except packed columns 0 and M-1 (DC
+ * and Nyquist column frequencies) that hold row frequency (i+1)/2.  In
+ * other columns, packed column j holds column frequency (j+1)/2; so, all
+ * columns after 2*x_max are outside the ellipse.
+ *
+ * Inside, the spectrum is multiplied by the scale only.
+ *
+ * @param packedSpectrum IN/OUT CCS packed spectrum, same size as the mask
+ * @param scale folded into the mask, eg, DFT normalization
+ */
+void Ideal::applyPacked( cv::Mat &packedSpectrum, float scale ) const
+{
+  checkPackedSize( packedSpectrum );
+  int N = _maskSize.height;
+  int M = _maskSize.width;
+  const int *xMax = _halfWidths.ptr<int>();
 
-  for(int i=0; i<N; i++)
+  for( int i=0; i<N; i++ )
   {
-    for(int j=0; j<M; j++)
-    {
-      if(i <= N/2)
-        meshgridCols.at<float>(i,j) = (float)(i);
-      else
-        meshgridCols.at<float>(i,j) = (float)(i) - N;
-    }
+    float *row = packedSpectrum.ptr<float>(i);
+    int firstOutside = std::min( M-1, std::max( 1, 2*xMax[i] + 1 ) );
+    SpectrumKernels::scale( row, scale, firstOutside );
+    std::fill( row + firstOutside, row + M-1, 0.0f );
+    int u = ( i == 0 ) ? 0 : (i+1)/2;
+    if( xMax[u] < 0 )
+      row[0] = 0.0f;
+    row[M-1] = ( xMax[u] < M/2 ) ? 0.0f : row[M-1] * scale;
   }
- 
-  // Calc distance as Ellipse
-  cv::Mat meshgridScaledMagnitude;  // this is OK,  = cv::Mat(N, M, CV_32F);
-  cv::Mat meshgridScaledRows, meshgridScaledCols;
-
-  // Get the vertices based on the dimensions of the mask.
-  double aVertex, bVertex;
-  aVertex = mask_size.width / (2.0 * _maskRadiusFactor);
-  bVertex = mask_size.height / (2.0 * _maskRadiusFactor);
-
-  // Scale the meshgrid arrays by the ellipse horizontal (a) and vertical (b)
-  // vertices.
-  cv::multiply( bVertex, meshgridRows, meshgridScaledRows );
-  cv::multiply( aVertex, meshgridCols, meshgridScaledCols );
-  cv::magnitude( meshgridScaledRows, meshgridScaledCols, meshgridScaledMagnitude );
-
-  // Find the maximum value in row(0); this either of the semi-major axis
-  // or semi-minor axis.  It's the major axis if the image width is greater
-  // than the height.  However, based on this technique, this is no longer
-  // a concern.
-  double rowMin, rowMax;
-  cv::minMaxLoc( meshgridScaledMagnitude.row(0), &rowMin, &rowMax );
-
-  // Find the maximum value in col(0); this either of the semi-major axis
-  // or semi-minor axis.  It's the major axis if the image height is greater
-  // than the width.  However, based on this technique, this is no longer
-  // a concern.
-  double colMin, colMax;
-  cv::minMaxLoc( meshgridScaledMagnitude.col(0), &colMin, &colMax );
-
-  // Finally, the "radius" is the smaller of the semi-major axes.
-  // The desired filter cutoff, ie Nyquist, is then 1/2 of the "radius".
-  // Because of this technique, the "max" value is IDENTICAL in both
-  // the zero-row and zero-column.  However, this code was left intact
-  // since the IDENTICAL values were only discovered to be so upon testing.
-  double distDiscriminator = std::min( rowMax, colMax ) * _maskRadiusFactor;
-
-  // Set mask value based on distance-frequency (cutoff distance).
-  cv::Mat tmp = cv::Mat( N, M, CV_32F );
-  for(int i=0; i<N; i++)
+}
+
+/**
+ * @param u row frequency 0..N-1
+ * @param v column frequency 0..M-1
+ * @return 1.0 inside the ellipse, 0.0 outside
+ */
+float Ideal::get_value( int u, int v ) const
+{
+  int M = _maskSize.width;
+  if( v > M/2 )                 // ellipse is symmetric
+    v = M - v;
+  return ( v <= _halfWidths.ptr<int>()[u] ) ? 1.0f : 0.0f;
+}
+
+/** @return 1 x N half-widths */
+cv::Mat Ideal::get_cacheEntry(void) const
+{
+  return _halfWidths;
+}
+
+/**
+ * @param mask_size width and height in pixels
+ * @param entry from get_cacheEntry()
+ */
+void Ideal::set_cacheEntry( cv::Size mask_size, cv::Mat entry )
+{
+  _maskSize = mask_size;
+  _halfWidths = entry;
+}
+
+/**
+ * Fill, per row, the spans inside the ellipse.
+ *
+ * Not used by the downsample; available for inspection of the filter/mask.
+ *
+ * @return mask, same size as the padded image, in FFT (unshifted) order
+ */
+cv::Mat Ideal::get_theFilterMask(void) const
+{
+  int N = _maskSize.height;
+  int M = _maskSize.width;
+  const int *xMax = _halfWidths.ptr<int>();
+
+  cv::Mat mask = cv::Mat::zeros( N, M, CV_32F );
+  for( int i=0; i<N; i++ )
   {
-    for(int j=0; j<M; j++)
-    {
-      if(meshgridScaledMagnitude.at<float>(i,j) < distDiscriminator)
-      {
-        tmp.at<float>(i,j) = (float)(1.0);
-      }
-      else
-      {
-        tmp.at<float>(i,j) = (float)(0.0);
-      }
-    }
+    if( xMax[i] < 0 )
+      continue;
+    float *row = mask.ptr<float>(i);
+    std::fill( row, row + xMax[i] + 1, 1.0f );             // 0..x_max
+    std::fill( row + M - xMax[i], row + M, 1.0f );         // -x_max..-1
   }
-  _theFilterMask = tmp.clone();
+  return mask;
 }
 
 }   // End namespace
@@ -0,0 +1,226 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "exceptions.h"
+#include "image_metadata.h"
+
+#include <cmath>
+#include <cstring>
+
+/** Library private methods declarations */
+static uint32_t crc32( const uint8_t *, size_t );
+static uint32_t readBigEndian32( const uint8_t * );
+static void writeBigEndian32( uint8_t *, uint32_t );
+static void appendPngChunk( std::vector<uint8_t> &, const char *,
+                            const uint8_t *, size_t );
+
+
+namespace NFIR {
+
+/**
+ * An inch is 0.0254 meter; the rate is rounded to the nearest integer.
+ *
+ * @return pixels per meter for `inch` and `meter`, the sample rate otherwise
+ */
+uint32_t
+ImageMetadata::get_pixelsPerUnit(void) const
+{
+  if( srUnits == "inch" )
+    return (uint32_t)std::lround( sampleRate / 0.0254 );
+  return (uint32_t)sampleRate;
+}
+
+/** @return one line */
+std::string
+ImageMetadata::to_s(void) const
+{
+  return "Metadata written inline: " + std::to_string(get_pixelsPerUnit())
+         + ( ( srUnits == "inch" || srUnits == "meter" ) ? " pixels per meter"
+                                                        : " pixels per unit" )
+         + ", " + std::to_string(textChunks.size()) + " tEXt chunk(s)";
+}
+
+/**
+ * For an image encoded by `cv::imencode()`; with libpng the encode writes
+ * the chunks itself, see RowWriter.  OpenCV writes no pHYs; should there be
+ * one, it is updated in place.  The image is then copied once, into a
+ * buffer of its final size, as signature and IHDR, the new chunks, and the
+ * rest; it is not parsed into chunks and serialized again.  PNG requires
+ * pHYs before the first IDAT; tEXt may be anywhere.
+ *
+ * @param png IN/OUT encoded PNG
+ * @param metadata resolution and text
+ *
+ * @throw NFIR::Miscue not a PNG, truncated chunk, or invalid text chunk
+ */
+void
+writePngMetadata( std::vector<uint8_t> &png, const ImageMetadata &metadata )
+{
+  static const uint8_t signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  const size_t ihdrEnd{ 8 + 12 + 13 };
+  if( ( png.size() < ihdrEnd )
+      || ( std::memcmp( png.data(), signature, 8 ) != 0 )
+      || ( std::memcmp( png.data() + 12, "IHDR", 4 ) != 0 ) )
+    throw NFIR::Miscue( "NFIR lib: metadata: target is not a PNG image" );
+
+  // pHYs: pixels per unit X and Y, unit specifier 1 for meter, 0 unknown.
+  uint8_t phys[9];
+  writeBigEndian32( phys, metadata.get_pixelsPerUnit() );
+  writeBigEndian32( phys + 4, metadata.get_pixelsPerUnit() );
+  phys[8] = ( metadata.srUnits == "inch" || metadata.srUnits == "meter" ) ? 1 : 0;
+
+  bool physUpdated{false};
+  for( size_t pos = 8; pos + 12 <= png.size(); )
+  {
+    size_t length = readBigEndian32( &png[pos] );
+    if( pos + 12 + length > png.size() )
+      throw NFIR::Miscue( "NFIR lib: metadata: truncated PNG chunk" );
+    if( ( std::memcmp( &png[pos+4], "pHYs", 4 ) == 0 ) && ( length == 9 ) )
+    {
+      std::memcpy( &png[pos+8], phys, 9 );
+      writeBigEndian32( &png[pos+17], crc32( &png[pos+4], 13 ) );
+      physUpdated = true;
+    }
+    if( std::memcmp( &png[pos+4], "IDAT", 4 ) == 0 )
+      break;
+    pos += 12 + length;
+  }
+
+  std::vector<uint8_t> chunks;
+  if( !physUpdated )
+    appendPngChunk( chunks, "pHYs", phys, 9 );
+  for( const auto &s : metadata.textChunks )
+  {
+    // Keyword of 1 to 79 bytes, a null separator, and the text.
+    size_t colon = s.find( ':' );
+    if( ( colon == std::string::npos ) || ( colon == 0 ) || ( colon > 79 ) )
+      throw NFIR::Miscue( "NFIR lib: metadata: text chunk not 'keyword:text': '"
+                          + s + "'" );
+    std::string data = s.substr( 0, colon ) + '\0' + s.substr( colon + 1 );
+    appendPngChunk( chunks, "tEXt",
+                    reinterpret_cast<const uint8_t*>( data.data() ), data.size() );
+  }
+
+  std::vector<uint8_t> out;
+  out.reserve( png.size() + chunks.size() );
+  out.insert( out.end(), png.begin(), png.begin() + ihdrEnd );
+  out.insert( out.end(), chunks.begin(), chunks.end() );
+  out.insert( out.end(), png.begin() + ihdrEnd, png.end() );
+  png.swap( out );
+}
+
+/**
+ * The header is patched in place; the pixels are not touched.  With units
+ * other than inch or meter the pixels per meter are unknown, and written
+ * as 0.
+ *
+ * @param bmp IN/OUT encoded BMP
+ * @param metadata resolution; text is not supported by BMP and is ignored
+ *
+ * @throw NFIR::Miscue not a BMP with a BITMAPINFOHEADER or later
+ */
+void
+writeBmpMetadata( std::vector<uint8_t> &bmp, const ImageMetadata &metadata )
+{
+  if( ( bmp.size() < 14 + 40 ) || ( bmp[0] != 'B' ) || ( bmp[1] != 'M' )
+      || ( ( bmp[14] | bmp[15] << 8 ) < 40 ) )
+    throw NFIR::Miscue( "NFIR lib: metadata: target is not a BMP image" );
+
+  // biXPelsPerMeter and biYPelsPerMeter, little endian.
+  const bool meter = ( metadata.srUnits == "inch" ) || ( metadata.srUnits == "meter" );
+  uint32_t ppm = meter ? metadata.get_pixelsPerUnit() : 0;
+  for( size_t at : { (size_t)38, (size_t)42 } )
+    for( int i = 0; i < 4; i++ )
+      bmp[at + i] = (uint8_t)( ppm >> ( 8 * i ) );
+}
+
+}   // End namespace
+
+
+/**
+ * @brief CRC-32 (ISO 3309) as required by PNG for each chunk.
+ *
+ * @param data chunk type and data
+ * @param length bytes
+ *
+ * @return crc
+ */
+uint32_t crc32( const uint8_t *data, size_t length )
+{
+  static const std::vector<uint32_t> table = [] {
+    std::vector<uint32_t> t( 256 );
+    for( uint32_t n = 0; n < 256; n++ )
+    {
+      uint32_t c = n;
+      for( int k = 0; k < 8; k++ )
+        c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+
+  uint32_t c = 0xFFFFFFFFu;
+  for( size_t i = 0; i < length; i++ )
+    c = table[( c ^ data[i] ) & 0xFF] ^ ( c >> 8 );
+  return c ^ 0xFFFFFFFFu;
+}
+
+/** @return value of the 4 bytes, most significant first */
+uint32_t readBigEndian32( const uint8_t *p )
+{
+  return ( (uint32_t)p[0] << 24 ) | ( (uint32_t)p[1] << 16 )
+       | ( (uint32_t)p[2] << 8 ) | (uint32_t)p[3];
+}
+
+/** @brief Store the value in 4 bytes, most significant first */
+void writeBigEndian32( uint8_t *p, uint32_t value )
+{
+  p[0] = (uint8_t)( value >> 24 );
+  p[1] = (uint8_t)( value >> 16 );
+  p[2] = (uint8_t)( value >> 8 );
+  p[3] = (uint8_t)value;
+}
+
+/**
+ * @brief Append length, type, data, and CRC of one PNG chunk.
+ *
+ * @param out IN/OUT chunks
+ * @param type 4 characters
+ * @param data chunk data
+ * @param length bytes of data
+ */
+void appendPngChunk( std::vector<uint8_t> &out, const char *type,
+                     const uint8_t *data, size_t length )
+{
+  size_t start = out.size();
+  out.resize( start + 12 + length );
+  writeBigEndian32( &out[start], (uint32_t)length );
+  std::memcpy( &out[start+4], type, 4 );
+  if( length > 0 )
+    std::memcpy( &out[start+8], data, length );
+  writeBigEndian32( &out[start+8+length], crc32( &out[start+4], 4 + length ) );
+}
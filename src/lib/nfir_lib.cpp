@@ -26,11 +26,15 @@ of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
 // #include "exceptions.h"
-#include "filter_mask_gaussian.h"
-#include "filter_mask_ideal.h"
+#include "fft_backend.h"
+#include "filter_mask_cache.h"
+#include "image_metadata.h"
 #include "nfir_lib.h"
-#include "resample_down.h"
-#include "resample_up.h"
+#include "raw_image.h"
+#include "resample_polyphase.h"
+#include "resample_session.h"
+#include "resample_stages.h"
+#include "row_codec.h"
 
 #ifdef USE_NFIMM
   #include "nfimm.h"
@@ -38,21 +42,25 @@ identified are necessarily the best available for the purpose.
 
 #include <opencv2/opencv.hpp>
 
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <map>
+
 /** Library private methods declarations */
 static std::string getImageDepthStr( const int );
-static cv::Mat padImage( cv::Mat, Padding& );
-static void validateUserSpecifiedSampleRates( int, int );
+static void deliverTarget( std::vector<uint8_t>&, NFIR::TargetBuffer& );
+static std::string resolveMetadataWriter( const std::string& );
+static std::vector<int> getPngEncodeParams( const NFIR::Options&, std::string& );
 
 
 namespace NFIR {
 
-/** @brief W x H of filteredImgPriorToDownsample */
-uint32_t *filteredImgPriorToDownsampleDimens;
-
 /**
  * @brief Filtered source-image prior to downsample by *resize factor*.
  *
- * This image is space-domain, png format. Was generated by the inverse DFT
+ * This image is space-domain. Was generated by the inverse DFT
  * of the frequency domain product of:
  *  - the padded image
  *  - the lowpass filter
@@ -64,15 +72,26 @@ uint32_t *filteredImgPriorToDownsampleDimens;
  * will not introduce aliasing where high spacial frequencies appear
  * as low spacial frequencies.
  */
-cv::Mat filteredImgPriorToDownsample;
+struct Result::FilteredImage
+{
+  cv::Mat image;
+};
+
+/**
+ * @brief Result of the last call on this thread of a resample() overload
+ * that does not return one; read by get_filteredImage().
+ */
+static thread_local Result lastResult;
 
 /**
- * @param srcImage IN pointer to source image
+ * @param srcImage IN pointer to encoded source image; read in place, not
+ *                 copied
  * @param tgtImage OUT pointer to generated, target image
  * @param srcSampleRate value must reflect srUnits
  * @param tgtSampleRate value must reflect srUnits
  * @param srUnits sample rate [ inch | meter | other ]
- * @param interpolationMethod [ bilinear | bicubic ]
+ * @param interpolationMethod [ bilinear | bicubic | spectral (downsample only)
+ *                            | polyphase ]
  * @param filterType [ ideal | Gaussian ]
  * @param imageWidth  IN -  width of source image,
                       OUT - width of generated, target image
@@ -88,7 +107,7 @@ cv::Mat filteredImgPriorToDownsample;
  *              downsample filter type, or cannot resize image
  */
 void
-resample( uint8_t *srcImage, uint8_t **tgtImage,
+resample( const uint8_t *srcImage, uint8_t **tgtImage,
           int srcSampleRate, int tgtSampleRate, const std::string &srUnits,
           const std::string &interpolationMethod, const std::string &filterType,
           uint32_t *imageWidth, uint32_t *imageHeight,
@@ -98,15 +117,377 @@ resample( uint8_t *srcImage, uint8_t **tgtImage,
           std::vector<std::string> &log
         )
 {
-  std::vector<uint8_t> vecSrcImg;
-  // Copy the srcImage into vector for decoding
-  for( size_t i=0; i<*imgBufSize; i++ ) {
-    vecSrcImg.push_back( srcImage[i] );
+  resample( srcImage, tgtImage, srcSampleRate, tgtSampleRate, srUnits,
+            interpolationMethod, filterType, imageWidth, imageHeight,
+            imgBufSize, srcComp, tgtComp, vecPngTextChunk, log, Options{} );
+}
+
+/**
+ * Same as the overload above, with processing options.
+ *
+ * The target image is allocated with `new[]`; the caller must `delete[]`
+ * it.  See the overload with NFIR::TargetBuffer to avoid this copy.
+ *
+ * @param options see NFIR::Options
+ */
+void
+resample( const uint8_t *srcImage, uint8_t **tgtImage,
+          int srcSampleRate, int tgtSampleRate, const std::string &srUnits,
+          const std::string &interpolationMethod, const std::string &filterType,
+          uint32_t *imageWidth, uint32_t *imageHeight,
+          size_t *imgBufSize,
+          const std::string &srcComp, const std::string &tgtComp,
+          std::vector<std::string> &vecPngTextChunk,
+          std::vector<std::string> &log,
+          const Options &options
+        )
+{
+  TargetBuffer target;
+  target.allocate = []( size_t size ) { return new uint8_t[size]; };
+  lastResult = Result{};
+  lastResult = resample( srcImage, *imgBufSize, target, srcSampleRate,
+                         tgtSampleRate, srUnits, interpolationMethod,
+                         filterType, imageWidth, imageHeight,
+                         srcComp, tgtComp, vecPngTextChunk, log, options );
+
+  // Update the function parameters for caller to use to write image.
+  *tgtImage = target.data;
+  *imgBufSize = target.size;
+}
+
+/**
+ * @param srcImage IN pointer to encoded source image; read in place, not
+ *                 copied
+ * @param srcBufSize length of the source image buffer
+ * @param target OUT receives the encoded target image, see NFIR::TargetBuffer
+ * @param srcSampleRate value must reflect srUnits
+ * @param tgtSampleRate value must reflect srUnits
+ * @param srUnits sample rate [ inch | meter | other ]
+ * @param interpolationMethod [ bilinear | bicubic | spectral (downsample only)
+ *                            | polyphase ]
+ * @param filterType [ ideal | Gaussian ]
+ * @param imageWidth OUT width of generated, target image
+ * @param imageHeight OUT height of generated, target image
+ * @param srcComp compression format of source image; not `raw`, which has
+ *                no dimensions, see the overload with raw pixels
+ * @param tgtComp compression format of target image; empty for that of the
+ *                source.  `raw` and `pgm` are written without a codec.
+ * @param vecPngTextChunk PNG text chunks, with NFIMM
+ * @param log resample-process metadata for reporting to caller
+ * @param options see NFIR::Options
+ *
+ * @return target dimensions and the filtered image prior to downsample
+ *
+ * @throw NFIR::Miscue for invalid sample rate(s), interpolation method,
+ *              downsample filter type, raw source, cannot resize image, or
+ *              cannot deliver the target image
+ */
+Result
+resample( const uint8_t *srcImage, size_t srcBufSize, TargetBuffer &target,
+          int srcSampleRate, int tgtSampleRate, const std::string &srUnits,
+          const std::string &interpolationMethod, const std::string &filterType,
+          uint32_t *imageWidth, uint32_t *imageHeight,
+          const std::string &srcComp, const std::string &tgtComp,
+          std::vector<std::string> &vecPngTextChunk,
+          std::vector<std::string> &log,
+          const Options &options
+        )
+{
+  if( srcComp == "raw" )
+    throw NFIR::Miscue( "NFIR lib: raw source has no dimensions; resample its pixels" );
+  const std::string &encodeComp = tgtComp.empty() ? srcComp : tgtComp;
+
+  std::vector<uint8_t> vecTgtImage;
+  Result streamed;
+  if( streamImage( srcImage, srcBufSize, srcSampleRate, tgtSampleRate, srUnits,
+                   interpolationMethod, filterType, encodeComp, vecPngTextChunk,
+                   log, vecTgtImage, streamed, options ) )
+  {
+    *imageWidth = streamed.width;
+    *imageHeight = streamed.height;
+    deliverTarget( vecTgtImage, target );
+    return streamed;
+  }
+
+  cv::Mat srcImageMtx = decodeImage( srcImage, srcBufSize, log );
+  cv::Mat tgtImageMatrix{};
+
+  Result result = resampleImage( srcImageMtx, tgtImageMatrix,
+                                 srcSampleRate, tgtSampleRate,
+                                 interpolationMethod, filterType,
+                                 log, options );
+
+  // Save dims to OUT pointers
+  *imageWidth = tgtImageMatrix.cols;
+  *imageHeight = tgtImageMatrix.rows;
+
+  encodeImage( tgtImageMatrix, result.stage, srcSampleRate, tgtSampleRate,
+               srUnits, encodeComp, vecPngTextChunk, log, vecTgtImage, options );
+
+  deliverTarget( vecTgtImage, target );
+  return result;
+}
+
+/**
+ * Same as the PNG/BMP encoders with default parameters, plus room for the
+ * metadata NFIMM may add.  PGM and raw: exact, they carry no metadata.
+ *
+ * @param width pixels
+ * @param height pixels
+ * @param compression `png`, `bmp`, `pgm`, or `raw`
+ *
+ * @return bytes
+ *
+ * @throw NFIR::Miscue no bound for the compression format
+ */
+size_t
+get_encodedSizeBound( uint32_t width, uint32_t height,
+                      const std::string &compression )
+{
+  std::string comp = compression;
+  std::transform( comp.begin(), comp.end(), comp.begin(), ::tolower );
+  const size_t metadata{ 64 * 1024 };
+
+  if( comp == "bmp" )
+  {
+    // Header, 256-entry gray palette, rows padded to 4 bytes.
+    size_t rowBytes = ( (size_t)width + 3 ) / 4 * 4;
+    return 54 + 1024 + rowBytes * height + metadata;
+  }
+  if( comp == "png" )
+  {
+    // zlib stored blocks at worst, as deflateBound(): 5 bytes per 16 KiB
+    // block, of rows with a filter byte each; signature, IHDR, IEND, and
+    // chunk header and CRC per 8 KiB IDAT.
+    size_t raw = ( (size_t)width + 1 ) * height;
+    size_t zlib = raw + 5 * ( raw / 16383 + 1 ) + 13;
+    return 8 + 25 + 12 * ( zlib / 8192 + 1 ) + zlib + 12 + metadata;
+  }
+  if( comp == "pgm" )
+    return writePgmHeader( width, height ).size() + (size_t)width * height;
+  if( comp == "raw" )
+    return (size_t)width * height;
+  throw NFIR::Miscue( "NFIR lib: no encoded size bound for compression: "
+                      + compression );
+}
+
+
+/**
+ * The source pixels are not copied; the target is resampled directly into
+ * the caller storage.
+ *
+ * @param srcPixels IN source image, row-major
+ * @param srcWidth pixels
+ * @param srcHeight pixels
+ * @param srcStride bytes between source rows; 0 for `srcWidth`
+ * @param tgtPixels OUT target image, row-major
+ * @param tgtStride bytes between target rows; 0 for target width
+ * @param tgtBufSize bytes available at `tgtPixels`
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param interpolationMethod [ bilinear | bicubic | spectral (downsample only)
+ *                            | polyphase ]
+ * @param filterType [ ideal | Gaussian ]
+ * @param tgtWidth OUT pixels
+ * @param tgtHeight OUT pixels
+ * @param log resample-process metadata for reporting to caller
+ * @param options see NFIR::Options
+ *
+ * @return target dimensions and the filtered image prior to downsample
+ *
+ * @throw NFIR::Miscue for invalid sample rate(s), interpolation method,
+ *              downsample filter type, stride, or too small target storage,
+ *              or cannot resize image
+ */
+Result
+resample( const uint8_t *srcPixels, uint32_t srcWidth, uint32_t srcHeight,
+          size_t srcStride,
+          uint8_t *tgtPixels, size_t tgtStride, size_t tgtBufSize,
+          int srcSampleRate, int tgtSampleRate,
+          const std::string &interpolationMethod, const std::string &filterType,
+          uint32_t *tgtWidth, uint32_t *tgtHeight,
+          std::vector<std::string> &log,
+          const Options &options )
+{
+  get_targetSize( srcSampleRate, tgtSampleRate, srcWidth, srcHeight,
+                  tgtWidth, tgtHeight );
+  if( srcStride == 0 )
+    srcStride = srcWidth;
+  if( tgtStride == 0 )
+    tgtStride = *tgtWidth;
+  if( ( srcStride < srcWidth ) || ( tgtStride < *tgtWidth ) )
+    throw NFIR::Miscue( "NFIR lib: row stride less than image width" );
+  if( ( *tgtHeight > 0 )
+      && ( tgtBufSize < tgtStride * ( *tgtHeight - 1 ) + *tgtWidth ) )
+    throw NFIR::Miscue( "NFIR lib: target buffer too small for "
+                        + std::to_string(*tgtWidth) + "x"
+                        + std::to_string(*tgtHeight) + " image" );
+
+  // Non-owning headers; OpenCV neither copies nor frees the pixels.
+  const cv::Mat srcImageMtx( srcHeight, srcWidth, CV_8UC1,
+                             const_cast<uint8_t*>( srcPixels ), srcStride );
+  cv::Mat tgtImageMatrix( *tgtHeight, *tgtWidth, CV_8UC1, tgtPixels, tgtStride );
+
+  log.push_back( "SRC img WxH: " + std::to_string(srcWidth) + "x"
+                + std::to_string(srcHeight) );
+  Result result = resampleImage( srcImageMtx, tgtImageMatrix,
+                                 srcSampleRate, tgtSampleRate,
+                                 interpolationMethod, filterType,
+                                 log, options );
+
+  // The resamplers write into a target of the right size and type in place;
+  // should one have reallocated, copy.
+  if( tgtImageMatrix.data != tgtPixels )
+  {
+    cv::Mat callerImage( *tgtHeight, *tgtWidth, CV_8UC1, tgtPixels, tgtStride );
+    tgtImageMatrix.copyTo( callerImage );
+  }
+  log.push_back( result.stage + " target img WxH: "
+                + std::to_string(*tgtWidth) + "x"
+                + std::to_string(*tgtHeight) );
+  return result;
+}
+
+/**
+ * The resize factor is computed as by NFIR::Resample.
+ *
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param srcWidth pixels
+ * @param srcHeight pixels
+ * @param tgtWidth OUT pixels
+ * @param tgtHeight OUT pixels
+ *
+ * @throw NFIR::Miscue sample rate not positive
+ */
+void
+get_targetSize( int srcSampleRate, int tgtSampleRate,
+                uint32_t srcWidth, uint32_t srcHeight,
+                uint32_t *tgtWidth, uint32_t *tgtHeight )
+{
+  if( ( srcSampleRate <= 0 ) || ( tgtSampleRate <= 0 ) )
+    throw NFIR::Miscue( "NFIR lib: src and/or target sample rate cannot be negative" );
+
+  double resizeFactor = (float)tgtSampleRate / (float)srcSampleRate;
+  *tgtWidth = cvRound( srcWidth * resizeFactor );
+  *tgtHeight = cvRound( srcHeight * resizeFactor );
+}
+
+/**
+ * PNG: the IHDR chunk follows the signature.  BMP: BITMAPINFOHEADER, height
+ * negative for top-down rows.  PGM: see readPgmHeader().  Raw images have
+ * no header.
+ *
+ * @param encoded IN start of the encoded image
+ * @param encodedSize bytes available at `encoded`
+ * @param width OUT pixels
+ * @param height OUT pixels
+ *
+ * @return false if not recognized
+ */
+bool
+get_imageSize( const uint8_t *encoded, size_t encodedSize,
+               uint32_t *width, uint32_t *height )
+{
+  static const uint8_t pngSignature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  auto bigEndian32 = [encoded]( size_t at ) {
+    return ( (uint32_t)encoded[at] << 24 ) | ( (uint32_t)encoded[at+1] << 16 )
+         | ( (uint32_t)encoded[at+2] << 8 ) | (uint32_t)encoded[at+3];
+  };
+  auto littleEndian32 = [encoded]( size_t at ) {
+    return ( (uint32_t)encoded[at+3] << 24 ) | ( (uint32_t)encoded[at+2] << 16 )
+         | ( (uint32_t)encoded[at+1] << 8 ) | (uint32_t)encoded[at];
+  };
+
+  if( ( encodedSize >= 24 )
+      && std::equal( pngSignature, pngSignature + 8, encoded )
+      && ( std::memcmp( encoded + 12, "IHDR", 4 ) == 0 ) )
+  {
+    *width = bigEndian32( 16 );
+    *height = bigEndian32( 20 );
+    return true;
   }
 
+  if( ( encodedSize >= 26 ) && ( encoded[0] == 'B' ) && ( encoded[1] == 'M' ) )
+  {
+    int32_t h = (int32_t)littleEndian32( 22 );
+    *width = littleEndian32( 18 );
+    *height = (uint32_t)( h < 0 ? -(int64_t)h : h );
+    return true;
+  }
+
+  PgmHeader pgm;
+  if( readPgmHeader( encoded, encodedSize, pgm ) )
+  {
+    *width = pgm.width;
+    *height = pgm.height;
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param width pixels
+ * @param height pixels
+ *
+ * @return relative cost, see Session::estimateCost()
+ */
+double
+get_resampleCost( int srcSampleRate, int tgtSampleRate,
+                  uint32_t width, uint32_t height )
+{
+  if( ( srcSampleRate <= 0 ) || ( tgtSampleRate <= 0 )
+      || ( width > (uint32_t)INT_MAX ) || ( height > (uint32_t)INT_MAX ) )
+    return 0.0;
+  return Session::estimateCost( srcSampleRate, tgtSampleRate,
+                                cv::Size( (int)width, (int)height ) );
+}
+
+
+/**
+ * An 8-bit binary PGM is not decoded: the image is a header over its
+ * pixels in the encoded buffer, which must then outlive it.
+ *
+ * @param encoded IN encoded image; read in place, not copied
+ * @param encodedSize length of the encoded image
+ * @param log resample-process metadata for reporting to caller
+ *
+ * @return single-channel image; shares the decoded pixels if the source is
+ *         single-channel, the encoded buffer if an 8-bit PGM
+ *
+ * @throw NFIR::Miscue empty or too large buffer, truncated PGM, or
+ *              unsupported channels
+ */
+cv::Mat
+decodeImage( const uint8_t *encoded, size_t encodedSize,
+             std::vector<std::string> &log )
+{
+  if( encodedSize == 0 )
+    throw NFIR::Miscue( "NFIR lib: SRC img buffer is empty" );
+
+  cv::Mat pgmImage;
+  if( mapPgmImage( encoded, encodedSize, pgmImage ) )
+  {
+    log.push_back( "SRC img buffer size: " + std::to_string(encodedSize) );
+    log.push_back( "SRC img WxH: " + std::to_string(pgmImage.cols) + "x"
+                  + std::to_string(pgmImage.rows) );
+    log.push_back( "SRC img read in place: pgm, 8-bit, 1 channel" );
+    return pgmImage;
+  }
+
+  if( encodedSize > (size_t)INT_MAX )
+    throw NFIR::Miscue( "NFIR lib: SRC img buffer too large to decode" );
+
+  // Decode straight from the caller's buffer through a non-owning header;
+  // the encoded image is not copied.
   cv::Mat srcImageMtx;
-  cv::Mat tmpImageMtx = cv::imdecode( cv::Mat(vecSrcImg), cv::IMREAD_UNCHANGED );
-  log.push_back( "SRC img std::vector size: " + std::to_string(vecSrcImg.size()) );
+  const cv::Mat encodedSrcImg( 1, (int)encodedSize, CV_8UC1,
+                               const_cast<uint8_t*>( encoded ) );
+  cv::Mat tmpImageMtx = cv::imdecode( encodedSrcImg, cv::IMREAD_UNCHANGED );
+  log.push_back( "SRC img buffer size: " + std::to_string(encodedSize) );
   log.push_back( "SRC img cv::matrix size: "
                 + std::to_string(tmpImageMtx.total()) );
   log.push_back( "SRC img WxH: "
@@ -116,9 +497,6 @@ resample( uint8_t *srcImage, uint8_t **tgtImage,
   log.push_back( "SRC img num channels: " + std::to_string(tmpImageMtx.channels()) );
 
 
-  cv::Mat tgtImageMatrix{};
-  tgtImageMatrix.release();
-
   if( tmpImageMtx.channels() > 1 )
   {
     cv::cvtColor( tmpImageMtx, srcImageMtx, cv::COLOR_BGR2GRAY );
@@ -126,7 +504,7 @@ resample( uint8_t *srcImage, uint8_t **tgtImage,
   }
   else if( tmpImageMtx.channels() == 1 )
   {
-    srcImageMtx = tmpImageMtx.clone();
+    srcImageMtx = tmpImageMtx;   // shares the decoded pixels
     log.push_back( "SRC IMG converted to single-channel: FALSE" );
   }
   else
@@ -135,301 +513,390 @@ resample( uint8_t *srcImage, uint8_t **tgtImage,
   }
   tmpImageMtx.release();
 
+  return srcImageMtx;
+}
+
+/**
+ * Nothing is decoded: the image is a header over the pixels in the buffer,
+ * which must outlive it.
+ *
+ * @param pixels IN raw image, 8-bit, row-major, no padding
+ * @param size length of the raw image
+ * @param width pixels, as the caller knows them
+ * @param height pixels, as the caller knows them
+ * @param log resample-process metadata for reporting to caller
+ *
+ * @return single-channel image over the pixels
+ *
+ * @throw NFIR::Miscue size is not width times height
+ */
+cv::Mat
+decodeRawImage( const uint8_t *pixels, size_t size,
+                uint32_t width, uint32_t height, std::vector<std::string> &log )
+{
+  cv::Mat image = mapRawImage( pixels, size, width, height );
+  log.push_back( "SRC img buffer size: " + std::to_string(size) );
+  log.push_back( "SRC img WxH: " + std::to_string(width) + "x"
+                + std::to_string(height) );
+  log.push_back( "SRC img read in place: raw, 8-bit, 1 channel" );
+  return image;
+}
 
-  // int errCode{0};
-  try
+/**
+ * Runs a one-time NFIR::Session; all state of the call is in the returned
+ * result, nothing is kept by the library.
+ *
+ * @param srcImg single-channel
+ * @param tgtImg OUT target image; written in place if of the target size
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param interpolationMethod see NFIR::resample()
+ * @param filterType see NFIR::resample()
+ * @param log resample-process metadata for reporting to caller
+ * @param options see NFIR::Options
+ *
+ * @return stage, target dimensions, and the filtered image prior to
+ *         downsample
+ */
+Result
+resampleImage( const cv::Mat &srcImg, cv::Mat &tgtImg,
+               int srcSampleRate, int tgtSampleRate,
+               const std::string &interpolationMethod,
+               const std::string &filterType,
+               std::vector<std::string> &log,
+               const Options &options )
+{
+  // The session is set up for this one image; see NFIR::Session for reuse
+  // across images of the same geometry.
+  NFIR::Session session( srcSampleRate, tgtSampleRate, interpolationMethod,
+                         filterType, srcImg.size(), options );
+  Result result = resampleImage( session, srcImg, tgtImg, log );
+
+  // The session ends here, so its buffer is never reused: share it.
+  cv::Mat image = session.get_filteredImage();
+  if( !image.empty() )
   {
-    validateUserSpecifiedSampleRates( srcSampleRate, tgtSampleRate );
+    auto filtered = std::make_shared<NFIR::Result::FilteredImage>();
+    filtered->image = image;
+    result.filteredImage = filtered;
   }
-  catch( const NFIR::Miscue &e ) {
-    throw e;
+  return result;
+}
+
+/**
+ * The filtered image is the buffer of the session, overwritten by its next
+ * run, see Session::get_filteredImage(); so the result has its dimensions
+ * but not the image, which a result shares immutably.
+ *
+ * @param session built for the size of srcImg
+ * @param srcImg single-channel
+ * @param tgtImg OUT target image; written in place if of the target size
+ * @param log resample-process metadata for reporting to caller
+ *
+ * @return stage, target dimensions, and those of the filtered image prior
+ *         to downsample
+ */
+Result
+resampleImage( NFIR::Session &session, const cv::Mat &srcImg, cv::Mat &tgtImg,
+               std::vector<std::string> &log )
+{
+  NFIR::Result result;
+  result.stage = session.get_stage();
+  for( auto s : session.to_s() ) { log.push_back(s); }
+
+  session.run( srcImg, tgtImg );
+  result.width = tgtImg.cols;
+  result.height = tgtImg.rows;
+
+  // The polyphase and spectral resamplers never generate the full-size,
+  // filtered image; neither does upsample.
+  cv::Mat filtered = session.get_filteredImage();
+  result.filteredWidth = filtered.cols;
+  result.filteredHeight = filtered.rows;
+  if( result.stage == "DOWNSAMPLE" )
+  {
+    if( session.get_filterEngine() != "spatial" )
+      log.push_back( NFIR::FFTBackend::to_s() );
+    log.push_back( "LOW-PASS-FILTERED target image PRIOR to decimation - WxH: "
+                  + std::to_string(result.filteredWidth) + "x"
+                  + std::to_string(result.filteredHeight) );
   }
+  return result;
+}
+
+/**
+ * The target sample rate and the PNG text chunks are written into the PNG
+ * or BMP metadata per Options::metadataWriter: inline, by the one encode
+ * of a PNG with libpng, else into its buffer; or by NFIMM.  `raw` and `pgm` targets are not encoded:
+ * their rows are copied after the header, if any, and carry no metadata.
+ *
+ * @param tgtImageMatrix resampled image
+ * @param stage label for the log, see NFIR::Result
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param srUnits sample rate [ inch | meter | other ]
+ * @param tgtComp compression format of target image
+ * @param vecPngTextChunk PNG text chunks, with NFIMM
+ * @param log resample-process metadata for reporting to caller
+ * @param encoded OUT encoded target image
+ * @param options see NFIR::Options
+ *
+ * @throw NFIR::Miscue invalid metadata writer or text chunk, or NFIMM
+ *              cannot modify the metadata
+ */
+void
+encodeImage( const cv::Mat &tgtImageMatrix, const std::string &stage,
+             int srcSampleRate, int tgtSampleRate, const std::string &srUnits,
+             const std::string &tgtComp,
+             const std::vector<std::string> &vecPngTextChunk,
+             std::vector<std::string> &log, std::vector<uint8_t> &encoded,
+             const Options &options )
+{
+  const std::string metadataWriter = resolveMetadataWriter( options.metadataWriter );
 
-  cv::Mat paddedImg;
-  Padding actualPadSize;
-  uint8_t *tgtImageResampled;
-  std::vector<uint8_t> vecTgtImage, vecTgtImageNFIMM;
+  std::vector<uint8_t> vecTgtImage;
   std::string encComp{"."};
-  std::vector<std::string> resample_metadata;
 
-  // Declare the pointers to metadata params and metadata modifier objects.
-  // NFIMM is the base class for PNG and BMP derived classes.
-  #ifdef USE_NFIMM
-  std::shared_ptr<NFIMM::MetadataParameters> mp;
-  std::unique_ptr<NFIMM::NFIMM> nfimm_mp;
-  #endif
+  // Encode image to stream of bytes.
+  std::string ncTgtComp = tgtComp;  // nc = non-const; for tolower() below
+  std::transform( ncTgtComp.begin(), ncTgtComp.end(),
+                  ncTgtComp.begin(), ::tolower );
+  encComp.append( tgtComp );
+  std::vector<int> encodeParams;
+  std::string encodeSettings{"OpenCV defaults"};
+  if( ncTgtComp == "png" )
+    encodeParams = getPngEncodeParams( options, encodeSettings );
 
+  const bool hasMetadata = ( ncTgtComp == "png" || ncTgtComp == "bmp" );
+  const bool inlineMetadata = hasMetadata && ( metadataWriter == "inline" );
+  ImageMetadata metadata;
+  metadata.sampleRate = tgtSampleRate;
+  metadata.srUnits = srUnits;
+  if( ncTgtComp == "png" )
+    metadata.textChunks = vecPngTextChunk;
+  // With libpng the PNG chunks are written by the encode itself, with the
+  // zlib settings and row filter of cv::imencode().
+  const bool metadataInEncode = inlineMetadata && ( ncTgtComp == "png" )
+                                && ( tgtImageMatrix.type() == CV_8UC1 )
+                                && RowWriter::supports( ncTgtComp );
 
-  // Based on UP or DOWN sample, instantiate the proper object.
-  if( tgtSampleRate > srcSampleRate )   // Upsample
+  auto encodeStart = std::chrono::steady_clock::now();
+  if( ( ncTgtComp == "raw" ) || ( ncTgtComp == "pgm" ) )
   {
-    std::unique_ptr<Upsample> resampler(new Upsample( srcSampleRate, tgtSampleRate ));
-    resampler->set_interpolationMethod( interpolationMethod );
-
-    resample_metadata.clear();
-    resample_metadata = resampler->to_s();
-    for( auto s : resample_metadata ) { log.push_back(s); }
+    encodeRawImage( tgtImageMatrix, ncTgtComp, vecTgtImage );
+    encodeSettings = "uncompressed, no codec";
+  }
+  else if( metadataInEncode )
+  {
+    std::unique_ptr<RowWriter> writer =
+      RowWriter::create( ncTgtComp, tgtImageMatrix.size(), &metadata,
+                         encodeParams, vecTgtImage );
+    writer->write( tgtImageMatrix );
+    writer->finish();
+    encodeSettings.append( ", libpng, metadata in the encode" );
+  }
+  else
+    cv::imencode( encComp, tgtImageMatrix, vecTgtImage, encodeParams );
+  std::chrono::duration<double, std::milli> encodeTime =
+    std::chrono::steady_clock::now() - encodeStart;
+  log.push_back( stage + " target img encode (" + encodeSettings + "): "
+                + std::to_string(encodeTime.count()) + " ms, "
+                + std::to_string(vecTgtImage.size()) + " bytes" );
 
-    try {
-      tgtImageMatrix = resampler->resize( srcImageMtx );
-    }
-    catch( const cv::Exception& ex ) {
-      std::string err{"NFIR lib: Upsample failed resize(): "};
-      err.append( ex.what() );
-      throw NFIR::Miscue( err );
-    }
+  log.push_back( stage + " target img vector size: "
+                + std::to_string(vecTgtImage.size()) );
+  log.push_back( stage + " target img matrix size: "
+                + std::to_string(tgtImageMatrix.total()) );
+  log.push_back( stage + " target img WxH: "
+                + std::to_string(tgtImageMatrix.cols) + "x"
+                + std::to_string(tgtImageMatrix.rows) );
+  log.push_back( stage + " target img num channels: "
+                + std::to_string(tgtImageMatrix.channels()) );
 
-    if( tgtImageMatrix.empty() ) {
-      throw NFIR::Miscue( "NFIR lib: Upsample failed resized target == 0" );
-    }
+  if( inlineMetadata )
+  {
+    if( ncTgtComp == "bmp" )
+      writeBmpMetadata( vecTgtImage, metadata );
+    else if( !metadataInEncode )
+      writePngMetadata( vecTgtImage, metadata );
+    log.push_back( metadata.to_s() );
+  }
 
-    // Save dims to OUT pointers
-    *imageWidth = tgtImageMatrix.cols;
-    *imageHeight = tgtImageMatrix.rows;
-    log.push_back( "UPSAMPLE target img WxH: " + std::to_string(tgtImageMatrix.cols) + "x" + std::to_string(tgtImageMatrix.rows) );
-    log.push_back( "UPSAMPLE target img matrix size: " + std::to_string(tgtImageMatrix.total()) );
-
-    // Encode image to stream of bytes.
-    std::string ncSrcComp = srcComp;  // nc = non-const; for tolower() below
-    std::transform( ncSrcComp.begin(), ncSrcComp.end(),
-                    ncSrcComp.begin(), ::tolower );
-    encComp.append( srcComp );
-    cv::imencode( encComp, tgtImageMatrix, vecTgtImage );
-    // Copy the vector to an array of bytes(uint8_t) for call to NFIMM.
-
-    log.push_back( "UPSAMPLE target img vector size: "
-                  + std::to_string(vecTgtImage.size()) );
-    log.push_back( "UPSAMPLE target img matrix size: "
-                  + std::to_string(tgtImageMatrix.total()) );
-    log.push_back( "UPSAMPLE target img WxH: "
-                  + std::to_string(tgtImageMatrix.cols) + "x"
-                  + std::to_string(tgtImageMatrix.rows) );
-    log.push_back( "UPSAMPLE target img num channels: "
-                  + std::to_string(tgtImageMatrix.channels()) );
-
-    if( ncSrcComp == "png" || ncSrcComp == "bmp" )
+  #ifdef USE_NFIMM
+  if( hasMetadata && ( metadataWriter == "nfimm" ) )
+  {
+    // Declare the pointers to metadata params and metadata modifier objects.
+    // NFIMM is the base class for PNG and BMP derived classes.
+    std::shared_ptr<NFIMM::MetadataParameters> mp;
+    std::unique_ptr<NFIMM::NFIMM> nfimm_mp;
+    std::vector<uint8_t> vecTgtImageNFIMM;
+    try
     {
-      #ifdef USE_NFIMM
-      try
-      {
-        // NFIMM (NIST Fingerprint Image Metadata Modifier library)
-        // START Create the metadata
-        mp.reset( new NFIMM::MetadataParameters( ncSrcComp ) );
-        mp->srcImg.resolution.horiz = srcSampleRate;
-        mp->srcImg.resolution.vert = srcSampleRate;
-        mp->set_srcImgSampleRateUnits( srUnits );
-        mp->destImg.resolution.horiz = tgtSampleRate;
-        mp->destImg.resolution.vert = tgtSampleRate;
-        mp->set_destImgSampleRateUnits( srUnits );
-        mp->destImg.textChunk = vecPngTextChunk;
-        // END Create the metadata
-
-        if( ncSrcComp == "bmp" )
-          nfimm_mp.reset( new NFIMM::BMP( mp ) );
-        else
-          nfimm_mp.reset( new NFIMM::PNG( mp ) );
-
-        nfimm_mp->readImageFileIntoBuffer( vecTgtImage );
-        nfimm_mp->modify();
-        nfimm_mp->retrieveWriteImageBuffer( vecTgtImageNFIMM );
-        // Push the NFIMM logging data to the NFIR log
-        log.push_back( mp->to_s() );
-        for( std::string s : mp->log ) { log.push_back( s ); }
-        // mp->log.clear();
-      }
-      catch( const NFIMM::Miscue &err ) {
-        log.push_back( "NFIMM modify() failed, log prior to exception below:" );
-        log.push_back( mp->to_s() );
-        throw NFIR::Miscue( err.what() );
-      }
+      // NFIMM (NIST Fingerprint Image Metadata Modifier library)
+      // START Create the metadata
+      mp.reset( new NFIMM::MetadataParameters( ncTgtComp ) );
+      mp->srcImg.resolution.horiz = srcSampleRate;
+      mp->srcImg.resolution.vert = srcSampleRate;
+      mp->set_srcImgSampleRateUnits( srUnits );
+      mp->destImg.resolution.horiz = tgtSampleRate;
+      mp->destImg.resolution.vert = tgtSampleRate;
+      mp->set_destImgSampleRateUnits( srUnits );
+      mp->destImg.textChunk = vecPngTextChunk;
+      // END Create the metadata
 
-      // copy the image buffer to be written to disk from NFIMM object
-      uint64 tgtImgSize{vecTgtImageNFIMM.size()};
-      tgtImageResampled = new uint8_t[tgtImgSize];
-      for( size_t i=0; i<tgtImgSize; i++ ) {
-        tgtImageResampled[i] = vecTgtImageNFIMM[i];
-      }
-      *tgtImage = tgtImageResampled;
-      *imgBufSize = tgtImgSize;
-
-      #else
-      // copy the image buffer to be written to disk from NFIR object
-      tgtImageResampled = new uint8_t[vecTgtImage.size()];
-      for( size_t i=0; i<vecTgtImage.size(); i++ ) {
-        tgtImageResampled[i] = vecTgtImage.at(i);
-      }
-      // Update the function parameter for caller to use to write image.
-      *tgtImage = tgtImageResampled;
-      *imgBufSize = vecTgtImage.size();
+      if( ncTgtComp == "bmp" )
+        nfimm_mp.reset( new NFIMM::BMP( mp ) );
+      else
+        nfimm_mp.reset( new NFIMM::PNG( mp ) );
 
-      #endif
+      nfimm_mp->readImageFileIntoBuffer( vecTgtImage );
+      nfimm_mp->modify();
+      nfimm_mp->retrieveWriteImageBuffer( vecTgtImageNFIMM );
+      // Push the NFIMM logging data to the NFIR log
+      log.push_back( mp->to_s() );
+      for( std::string s : mp->log ) { log.push_back( s ); }
+      // mp->log.clear();
     }
-    else
-    {
-      // copy the image buffer to be written to disk from NFIR object
-      tgtImageResampled = new uint8_t[vecTgtImage.size()];
-      for( size_t i=0; i<vecTgtImage.size(); i++ ) {
-        tgtImageResampled[i] = vecTgtImage.at(i);
-      }
-      // Update the function parameter for caller to use to write image.
-      *tgtImage = tgtImageResampled;
-      *imgBufSize = vecTgtImage.size();
+    catch( const NFIMM::Miscue &err ) {
+      log.push_back( "NFIMM modify() failed, log prior to exception below:" );
+      log.push_back( mp->to_s() );
+      throw NFIR::Miscue( err.what() );
     }
-    return;
+    // The image to be written to disk is the one from the NFIMM object.
+    vecTgtImage.swap( vecTgtImageNFIMM );
   }
+  #else
+  (void)srcSampleRate;   // source metadata is written by NFIMM only
+  #endif
 
-  // Not an UPSAMPLE, so start the DOWNSAMPLE process.
-  FilterMask *currentFilter;
-  // std::unique_ptr<FilterMask> currentFilter;
-  paddedImg = padImage( srcImageMtx, actualPadSize );
-  log.push_back( actualPadSize.to_s() );
+  encoded.swap( vecTgtImage );
+}
 
-  // Build the filter/mask for freq domain mulSpectums.
-  // The filter/mask is same dimension (WxH) as the padded, source image.
-  try
-  {
-    // auto resampler = new Downsample( srcSampleRate, tgtSampleRate );
-    std::unique_ptr<Downsample> resampler( new Downsample( srcSampleRate, tgtSampleRate ) );
-    resampler->set_interpolationMethodAndFilterType( interpolationMethod,
-                                                     filterType );
-    if( resampler->get_filterType() == "Gaussian" )
-    {
-      currentFilter = new Gaussian( srcSampleRate, tgtSampleRate );
-      // currentFilter.reset( new Gaussian( srcSampleRate, tgtSampleRate ));
-      currentFilter->build( paddedImg.size() );
-    }
-    else if( resampler->get_filterType() == "ideal" )
-    {
-      currentFilter = new Ideal( srcSampleRate, tgtSampleRate );
-      // currentFilter.reset( new Ideal( srcSampleRate, tgtSampleRate ));
-      currentFilter->build( paddedImg.size() );
-    }
-    else
-    {
-      throw NFIR::Miscue( "NFIR lib: invalid parameter filter type: '"
-                         + resampler->get_filterType() + "'");
-    }
+/**
+ * Polyphase is the one resampler that consumes and emits rows, see
+ * NFIR::Polyphase::start(); the source is decoded and the target encoded
+ * by bands of NFIR::streamBandRows rows, so that neither full image is ever
+ * in memory.  The target pixels are those of resampleImage(); the encoded
+ * bytes may differ from those of `cv::imencode()`.
+ *
+ * Nothing is done, and false returned, unless all apply:
+ *   Options::streamRows is set, the interpolation is `polyphase`, the
+ *   source is an 8-bit grayscale, non-interlaced PNG or a binary PGM, the
+ *   target compression is `png`, `pgm`, or `raw`, and the metadata is not
+ *   written by NFIMM.  The caller then runs the whole-image stages.
+ *
+ * @param encoded IN encoded source image; read in place, not copied
+ * @param encodedSize length of the encoded image
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param srUnits sample rate [ inch | meter | other ]
+ * @param interpolationMethod see NFIR::resample()
+ * @param filterType see NFIR::resample()
+ * @param tgtComp compression format of target image
+ * @param vecPngTextChunk PNG text chunks
+ * @param log resample-process metadata for reporting to caller
+ * @param tgtEncoded OUT encoded target image
+ * @param result OUT stage and target dimensions; no filtered image
+ * @param options see NFIR::Options
+ *
+ * @return true if the image was streamed
+ *
+ * @throw NFIR::Miscue for invalid sample rate(s), corrupt source image, or
+ *              invalid text chunk
+ */
+bool
+streamImage( const uint8_t *encoded, size_t encodedSize,
+             int srcSampleRate, int tgtSampleRate, const std::string &srUnits,
+             const std::string &interpolationMethod,
+             const std::string &filterType, const std::string &tgtComp,
+             const std::vector<std::string> &vecPngTextChunk,
+             std::vector<std::string> &log, std::vector<uint8_t> &tgtEncoded,
+             Result &result, const Options &options )
+{
+  std::string ncTgtComp = tgtComp;
+  std::transform( ncTgtComp.begin(), ncTgtComp.end(),
+                  ncTgtComp.begin(), ::tolower );
+  const std::string metadataWriter = resolveMetadataWriter( options.metadataWriter );
+  if( !options.streamRows || ( interpolationMethod != "polyphase" )
+      || !RowWriter::supports( ncTgtComp ) || ( metadataWriter == "nfimm" ) )
+    return false;
 
-    // Now that the padded, source image and current filter/mask are available,
-    // ready to downsample.
-    resample_metadata.clear();
-    log.push_back( ">> START DOWNSAMPLE (resampler) metadata:" );
-    resample_metadata = resampler->to_s();
-    for( auto s : resample_metadata ) { log.push_back(s); }
-    log.push_back( ">> END DOWNSAMPLE (resampler) metadata" );
-
-    tgtImageMatrix = resampler->resize( paddedImg, currentFilter, actualPadSize );
-    if( tgtImageMatrix.empty() ) {
-      throw NFIR::Miscue( "NFIR lib: Downsample failed resize(), target image empty" );
-    }
+  std::unique_ptr<RowReader> reader = RowReader::open( encoded, encodedSize );
+  if( !reader )
+    return false;
+  const cv::Size srcSize = reader->get_size();
+  log.push_back( "SRC img buffer size: " + std::to_string(encodedSize) );
+  log.push_back( "SRC img WxH: " + std::to_string(srcSize.width) + "x"
+                + std::to_string(srcSize.height) );
+  log.push_back( "SRC img streamed: " + reader->get_format()
+                + ", 8-bit, 1 channel" );
 
-    NFIR::filteredImgPriorToDownsampleDimens = resampler->get_filteredImageDimens();
-    NFIR::filteredImgPriorToDownsample = resampler->get_filteredImage();
-    log.push_back( "LOW-PASS-FILTERED target image PRIOR to decimation - WxH: "
-                  + std::to_string(NFIR::filteredImgPriorToDownsampleDimens[0]) + "x"
-                  + std::to_string(NFIR::filteredImgPriorToDownsampleDimens[1]) );
-
-    // Save dims to OUT pointers
-    *imageWidth = tgtImageMatrix.cols;
-    *imageHeight = tgtImageMatrix.rows;
-
-    std::string ncSrcComp = srcComp;  // nc = non-const; for tolower() below
-    std::transform( ncSrcComp.begin(), ncSrcComp.end(),
-                    ncSrcComp.begin(), ::tolower );
-    encComp.append( srcComp );
-    cv::imencode( encComp, tgtImageMatrix, vecTgtImage );
-
-    log.push_back( "DOWNSAMPLE target img vector size: "
-                  + std::to_string(vecTgtImage.size()) );
-    log.push_back( "DOWNSAMPLE target img matrix size: "
-                  + std::to_string(tgtImageMatrix.total()) );
-    log.push_back( "DOWNSAMPLE target img WxH: "
-                  + std::to_string(tgtImageMatrix.cols) + "x"
-                  + std::to_string(tgtImageMatrix.rows) );
-    log.push_back( "DOWNSAMPLE target img num channels: "
-                  + std::to_string(tgtImageMatrix.channels()) );
-
-    if( ncSrcComp == "png" || ncSrcComp == "bmp" )
-    {
-      #ifdef USE_NFIMM
-      try
-      {
-        // NFIMM (NIST Fingerprint Image Metadata Modifier library)
-        // START Create the metadata
-        mp.reset( new NFIMM::MetadataParameters( ncSrcComp ) );
-        mp->srcImg.resolution.horiz = srcSampleRate;
-        mp->srcImg.resolution.vert = srcSampleRate;
-        mp->set_srcImgSampleRateUnits( srUnits );
-        mp->destImg.resolution.horiz = tgtSampleRate;
-        mp->destImg.resolution.vert = tgtSampleRate;
-        mp->set_destImgSampleRateUnits( srUnits );
-        mp->destImg.textChunk = vecPngTextChunk;
-        // END Create the metadata
-
-        if( ncSrcComp == "bmp" )
-          nfimm_mp.reset( new NFIMM::BMP( mp ) );
-        else
-          nfimm_mp.reset( new NFIMM::PNG( mp ) );
-
-        nfimm_mp->readImageFileIntoBuffer( vecTgtImage );
-        nfimm_mp->modify();
-        nfimm_mp->retrieveWriteImageBuffer( vecTgtImageNFIMM );
-        // Push the NFIMM logging data to the NFIR log
-        log.push_back( mp->to_s() );
-        for( std::string s : mp->log ) { log.push_back( s ); }
-        // mp->log.clear();
-      }
-      catch( const NFIMM::Miscue &err ) {
-        log.push_back( "NFIMM modify() failed, log prior to exception below:" );
-        log.push_back( mp->to_s() );
-        throw NFIR::Miscue( err.what() );
-      }
+  // The session validates the rates and size, and logs the configuration;
+  // the rows are pushed through a resampler of the same ratio.
+  NFIR::Session session( srcSampleRate, tgtSampleRate, interpolationMethod,
+                         filterType, srcSize, options );
+  for( auto s : session.to_s() ) { log.push_back(s); }
+  NFIR::Polyphase polyphase( srcSampleRate, tgtSampleRate );
+  const cv::Size tgtSize = polyphase.get_targetSize( srcSize );
 
-      // copy the image buffer to be written to disk from NFIMM object
-      uint64 tgtImgSize{vecTgtImageNFIMM.size()};
-      tgtImageResampled = new uint8_t[tgtImgSize];
-      for( size_t i=0; i<tgtImgSize; i++ ) {
-        tgtImageResampled[i] = vecTgtImageNFIMM[i];
-      }
-      *tgtImage = tgtImageResampled;
-      *imgBufSize = tgtImgSize;
-
-      #else
-      // copy the image buffer to be written to disk from NFIR object
-      tgtImageResampled = new uint8_t[vecTgtImage.size()];
-      for( size_t i=0; i<vecTgtImage.size(); i++ ) {
-        tgtImageResampled[i] = vecTgtImage.at(i);
-      }
-      // Update the function parameter for caller to use to write image.
-      *tgtImage = tgtImageResampled;
-      *imgBufSize = vecTgtImage.size();
+  ImageMetadata metadata;
+  metadata.sampleRate = tgtSampleRate;
+  metadata.srUnits = srUnits;
+  metadata.textChunks = vecPngTextChunk;
+  const bool inlineMetadata = ( ncTgtComp == "png" ) && ( metadataWriter == "inline" );
+  std::string encodeSettings{"OpenCV defaults"};
+  std::vector<int> encodeParams;
+  if( ncTgtComp == "png" )
+    encodeParams = getPngEncodeParams( options, encodeSettings );
 
-      #endif
-    }
-    else
-    {
-      // copy the image buffer to be written to disk from NFIR object
-      tgtImageResampled = new uint8_t[vecTgtImage.size()];
-      for( size_t i=0; i<vecTgtImage.size(); i++ ) {
-        tgtImageResampled[i] = vecTgtImage.at(i);
+  auto encodeStart = std::chrono::steady_clock::now();
+  std::vector<uint8_t> vecTgtImage;
+  std::unique_ptr<RowWriter> writer =
+    RowWriter::create( ncTgtComp, tgtSize, inlineMetadata ? &metadata : nullptr,
+                       encodeParams, vecTgtImage );
+
+  // Target rows fill a band; a full band, and the last, is encoded.
+  cv::Mat tgtBand( std::min( streamBandRows, tgtSize.height ), tgtSize.width, CV_8UC1 );
+  int bandStart{0};
+  polyphase.start( srcSize,
+    [&]( int row, const uint8_t *pixels ) {
+      std::memcpy( tgtBand.ptr<uint8_t>( row - bandStart ), pixels, tgtSize.width );
+      if( ( row - bandStart + 1 == tgtBand.rows ) || ( row + 1 == tgtSize.height ) )
+      {
+        writer->write( tgtBand.rowRange( 0, row - bandStart + 1 ) );
+        bandStart = row + 1;
       }
-      // Update the function parameter for caller to use to write image.
-      *tgtImage = tgtImageResampled;
-      *imgBufSize = vecTgtImage.size();
-    }
+    } );
 
-    // Clean up
-    delete currentFilter;
-    currentFilter = nullptr;
-  }
-  catch( const cv::Exception& ex ) {
-    std::string err{"NFIR lib: Downsample failed resize(): "};
-    err.append( ex.what() );
-    throw NFIR::Miscue( err );
+  cv::Mat srcBand( std::min( streamBandRows, srcSize.height ), srcSize.width, CV_8UC1 );
+  for( int y = 0; y < srcSize.height; y += srcBand.rows )
+  {
+    cv::Mat band = srcBand.rowRange( 0, std::min( srcBand.rows, srcSize.height - y ) );
+    reader->read( band );
+    for( int i = 0; i < band.rows; i++ )
+      polyphase.pushRow( band.ptr<uint8_t>( i ) );
   }
-  return;
-}
+  polyphase.finish();
+  writer->finish();
+  std::chrono::duration<double, std::milli> streamTime =
+    std::chrono::steady_clock::now() - encodeStart;
 
+  result.stage = session.get_stage();
+  result.width = tgtSize.width;
+  result.height = tgtSize.height;
+  log.push_back( result.stage + " target img streamed by bands of "
+                + std::to_string(streamBandRows) + " rows (" + encodeSettings
+                + "): " + std::to_string(streamTime.count()) + " ms, "
+                + std::to_string(vecTgtImage.size()) + " bytes" );
+  log.push_back( result.stage + " target img WxH: "
+                + std::to_string(tgtSize.width) + "x"
+                + std::to_string(tgtSize.height) );
+  if( inlineMetadata )
+    log.push_back( metadata.to_s() );
+
+  tgtEncoded.swap( vecTgtImage );
+  return true;
+}
 
 std::string
 printVersion()
@@ -451,6 +918,50 @@ getVersion()
   return NFIR_VERSION;
 }
 
+void
+set_maskCacheCapacity( size_t bytes )
+{
+  FilterMaskCache::instance().set_capacity( bytes );
+}
+
+void
+set_fftBackend( const std::string &name )
+{
+  FFTBackend::set_preferred( name );
+}
+
+void
+loadFFTWisdom( const std::string &path )
+{
+  FFTBackend::loadWisdom( path );
+}
+
+void
+saveFFTWisdom( const std::string &path )
+{
+  FFTBackend::saveWisdom( path );
+}
+
+/**
+ * @param encoded OUT filtered image, encoded
+ * @param encodeCompression desired compression, eg, `png`
+ *
+ * @throw NFIR::Miscue filtered image not generated by this call
+ */
+void
+Result::get_filteredImage( std::vector<uint8_t> &encoded,
+                           const std::string &encodeCompression ) const
+{
+  // Spectral decimation, polyphase, and upsample never generate the
+  // full-size, filtered image.
+  if( !filteredImage || filteredImage->image.empty() ) {
+    throw NFIR::Miscue( "NFIR lib: filtered image prior to downsample not "
+                        "available for this interpolation method, or not "
+                        "kept by a reused session" );
+  }
+  cv::imencode( "." + encodeCompression, filteredImage->image, encoded );
+}
+
 void get_filteredImage( uint8_t** filteredImage,
                         const std::string &encodeCompression,
                         size_t   *imgBufSize,
@@ -458,22 +969,14 @@ void get_filteredImage( uint8_t** filteredImage,
                         uint32_t *imageHeight )
 {
   std::vector<uint8_t> vecFilteredImage;
-  uint8_t *filteredImageTmp;
-
-  std::string encCompLocal{"."};
-  encCompLocal.append( encodeCompression );
+  lastResult.get_filteredImage( vecFilteredImage, encodeCompression );
 
-  *imageWidth  = filteredImgPriorToDownsampleDimens[0];
-  *imageHeight = filteredImgPriorToDownsampleDimens[1];
-
-  cv::imencode( encCompLocal, filteredImgPriorToDownsample, vecFilteredImage );
+  *imageWidth  = lastResult.filteredWidth;
+  *imageHeight = lastResult.filteredHeight;
   *imgBufSize = vecFilteredImage.size();
 
-  filteredImageTmp = new uint8_t[vecFilteredImage.size()];
-  for( size_t i=0; i<vecFilteredImage.size(); i++ ) {
-    filteredImageTmp[i] = vecFilteredImage.at(i);
-  }
-  *filteredImage = filteredImageTmp;
+  *filteredImage = new uint8_t[vecFilteredImage.size()];
+  std::copy( vecFilteredImage.begin(), vecFilteredImage.end(), *filteredImage );
 }
 
 }   // End namespace
@@ -525,59 +1028,141 @@ std::string getImageDepthStr( const int depth )
   return img_depth_str;
 }
 
+/**
+ * @brief Hand the encoded target image to the caller per its TargetBuffer.
+ *
+ * @param encoded target image; moved-from in `vector` mode
+ * @param target see NFIR::TargetBuffer
+ *
+ * @throw NFIR::Miscue no mode set, caller buffer too small, or allocator
+ *              returned null; `target.size` is set in every case
+ */
+void deliverTarget( std::vector<uint8_t> &encoded, NFIR::TargetBuffer &target )
+{
+  target.size = encoded.size();
+  if( target.vector != nullptr )
+  {
+    *target.vector = std::move( encoded );
+    target.data = target.vector->data();
+    return;
+  }
+
+  if( target.buffer != nullptr )
+  {
+    if( target.bufferSize < target.size )
+      throw NFIR::Miscue( "NFIR lib: target buffer too small, "
+                          + std::to_string(target.size) + " bytes required" );
+    target.data = target.buffer;
+  }
+  else if( target.allocate )
+  {
+    target.data = target.allocate( target.size );
+    if( target.data == nullptr )
+      throw NFIR::Miscue( "NFIR lib: target allocator failed, "
+                          + std::to_string(target.size) + " bytes" );
+  }
+  else
+    throw NFIR::Miscue( "NFIR lib: no target buffer specified" );
+
+  std::copy( encoded.begin(), encoded.end(), target.data );
+}
 
 /**
- * @brief Utilize the OpenCV optimal padding function.
+ * @brief Resolve `auto` and check NFIR::Options::metadataWriter.
  *
- * If either (or both) of the optimal rows or columns are odd, one row or column
- * is added to the padding. This must be done to ensure that the ideal filter/mask
- * rightmost column and bottommost row contain all zeros.
+ * @param name [ auto | inline | nfimm | none ]
  *
- * @param image to pad
- * @param actual OUT padding values
+ * @return `inline`, `nfimm`, or `none`
  *
- * @return the padded image
+ * @throw NFIR::Miscue unknown writer, or `nfimm` in a build without NFIMM
  */
-cv::Mat padImage( cv::Mat image, Padding &actual )
+std::string resolveMetadataWriter( const std::string &name )
 {
-  cv::Mat padded;
-  int optimalRows = cv::getOptimalDFTSize( image.rows );
-  if (optimalRows % 2)  // odd
-    optimalRows++;
-  int optimalCols = cv::getOptimalDFTSize( image.cols );
-  if (optimalCols % 2)  // odd
-    optimalCols++;
-  int pad_rows = optimalRows - image.rows;
-  int pad_cols = optimalCols - image.cols;
-  cv::copyMakeBorder( image, padded, 0, pad_rows, 0, pad_cols,
-                      cv::BORDER_CONSTANT, cv::Scalar::all(255) );
-  actual.top = 0;
-  actual.bottom = pad_rows;
-  actual.left = 0;
-  actual.right = pad_cols;
-
-  return padded;
+  if( name == "auto" )
+  {
+    #ifdef USE_NFIMM
+    return "nfimm";
+    #else
+    return "none";
+    #endif
+  }
+  if( name == "nfimm" )
+  {
+    #ifndef USE_NFIMM
+    throw NFIR::Miscue( "NFIR lib: metadata writer 'nfimm' requires a build with NFIMM" );
+    #endif
+    return name;
+  }
+  if( ( name == "inline" ) || ( name == "none" ) )
+    return name;
+  throw NFIR::Miscue( "NFIR lib: invalid metadata writer: '" + name + "'" );
 }
 
 /**
- * @brief Validate the sample rates not handled by CLI11.
+ * @brief `cv::imencode()` parameters for a PNG target.
  *
- * Rates cannot be equal to each other or less than zero.
+ * The level and the strategy, when set, override those of the preset.
  *
- * @param srcSampleRate source image
- * @param tgtSampleRate target image
+ * @param options see NFIR::Options pngPreset, pngCompressionLevel, and
+ *                pngStrategy
+ * @param settings OUT description for the log
+ *
+ * @return key and value pairs; empty for OpenCV defaults
  *
- * @throw NFIR::Miscue send appropriate message
+ * @throw NFIR::Miscue unknown preset or strategy, or level out of range
  */
-void validateUserSpecifiedSampleRates( int srcSampleRate, int tgtSampleRate )
+std::vector<int> getPngEncodeParams( const NFIR::Options &options,
+                                     std::string &settings )
 {
-  if( tgtSampleRate == srcSampleRate )
-  {
-    throw NFIR::Miscue( "NFIR lib: source and target sample rates cannot be equal" );
+  static const std::map<std::string, int> strategies{
+    { "default",  cv::IMWRITE_PNG_STRATEGY_DEFAULT },
+    { "filtered", cv::IMWRITE_PNG_STRATEGY_FILTERED },
+    { "huffman",  cv::IMWRITE_PNG_STRATEGY_HUFFMAN_ONLY },
+    { "rle",      cv::IMWRITE_PNG_STRATEGY_RLE },
+    { "fixed",    cv::IMWRITE_PNG_STRATEGY_FIXED }
+  };
+
+  int level{-1};
+  std::string strategy{""};
+  if( options.pngPreset == "fast" ) {
+    level = 1;
+    strategy = "huffman";
+  }
+  else if( options.pngPreset == "store" ) {
+    level = 0;
+    strategy = "default";
   }
+  else if( options.pngPreset == "small" ) {
+    level = 9;
+    strategy = "filtered";
+  }
+  else if( options.pngPreset != "default" )
+    throw NFIR::Miscue( "NFIR lib: invalid PNG preset: '" + options.pngPreset + "'" );
+
+  if( options.pngCompressionLevel >= 0 )
+    level = options.pngCompressionLevel;
+  if( !options.pngStrategy.empty() )
+    strategy = options.pngStrategy;
+  if( level > 9 )
+    throw NFIR::Miscue( "NFIR lib: PNG compression level must be 0 to 9" );
 
-  if( (srcSampleRate <= 0 ) || ( tgtSampleRate <= 0 ) )
+  std::vector<int> params;
+  if( level >= 0 )
   {
-    throw NFIR::Miscue( "NFIR lib: src and/or target sample rate cannot be negative" );
+    params.push_back( cv::IMWRITE_PNG_COMPRESSION );
+    params.push_back( level );
+  }
+  if( !strategy.empty() )
+  {
+    auto it = strategies.find( strategy );
+    if( it == strategies.end() )
+      throw NFIR::Miscue( "NFIR lib: invalid PNG strategy: '" + strategy + "'" );
+    params.push_back( cv::IMWRITE_PNG_STRATEGY );
+    params.push_back( it->second );
   }
+
+  settings = "preset " + options.pngPreset
+           + ", level " + ( level >= 0 ? std::to_string(level) : "OpenCV default" )
+           + ", strategy " + ( strategy.empty() ? "OpenCV default" : strategy );
+  return params;
 }
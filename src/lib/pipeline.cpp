@@ -0,0 +1,507 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "bounded_queue.h"
+#include "exceptions.h"
+#include "pipeline.h"
+#include "raw_image.h"
+#include "resample_session.h"
+#include "resample_stages.h"
+#include "work_scheduler.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <list>
+#include <sstream>
+#include <mutex>
+#include <thread>
+
+namespace NFIR {
+
+struct Pipeline::Job
+{
+  /** @brief Handed to the caller */
+  PipelineItem item;
+  /** @brief Decoded source, released once resampled */
+  cv::Mat srcImage;
+  /** @brief Resampled target, released once encoded */
+  cv::Mat tgtImage;
+  /** @brief Target encoded by the worker, see Options::streamRows */
+  bool encoded{false};
+};
+
+struct Pipeline::Batch
+{
+  Batch( size_t count, size_t queueDepth )
+    : count{count}, decoded{queueDepth}, resampled{queueDepth} {}
+
+  /** @brief Number of images */
+  const size_t count;
+  /** @brief Next image to read, in list order */
+  std::atomic<size_t> next{0};
+  /** @brief Largest first instead of list order, if set */
+  std::unique_ptr<WorkScheduler> scheduler;
+  /** @brief Set when the Writer returns false or throws */
+  std::atomic<bool> stop{false};
+  /** @brief Images written without error */
+  std::atomic<size_t> completed{0};
+
+  /** @brief Readers to workers */
+  BoundedQueue<std::unique_ptr<Job>> decoded;
+  /** @brief Workers to writers */
+  BoundedQueue<std::unique_ptr<Job>> resampled;
+
+  /** @brief Seconds spent resampling, per worker; each writes its own */
+  std::vector<double> workerBusy;
+
+  /** @brief First exception thrown by the Writer, rethrown by run() */
+  std::exception_ptr writerError;
+  /** @brief Guards writerError */
+  std::mutex mutex;
+};
+
+struct Pipeline::SessionCache
+{
+  /** @brief Sessions kept; each holds the buffers of one source size */
+  static constexpr size_t capacity{4};
+  /** @brief Most recently used first */
+  std::list<std::unique_ptr<Session>> sessions;
+};
+
+/**
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param srUnits sample rate [ inch | meter | other ]
+ * @param interpolationMethod see NFIR::resample()
+ * @param filterType see NFIR::resample()
+ * @param srcComp compression format of source images; `raw` sources have
+ *                their dimensions set by the Reader
+ * @param tgtComp compression format of target images; empty for that of
+ *                the source
+ * @param vecPngTextChunk PNG text chunks, with NFIMM
+ * @param options see NFIR::Options
+ * @param pipelineOptions see NFIR::PipelineOptions
+ */
+Pipeline::Pipeline( int srcSampleRate, int tgtSampleRate,
+                    const std::string &srUnits,
+                    const std::string &interpolationMethod,
+                    const std::string &filterType,
+                    const std::string &srcComp,
+                    const std::string &tgtComp,
+                    const std::vector<std::string> &vecPngTextChunk,
+                    const Options &options,
+                    const PipelineOptions &pipelineOptions )
+  : _srcSampleRate{srcSampleRate}, _tgtSampleRate{tgtSampleRate},
+    _srUnits{srUnits}, _interpolationMethod{interpolationMethod},
+    _filterType{filterType}, _srcComp{srcComp},
+    _tgtComp{ tgtComp.empty() ? srcComp : tgtComp },
+    _vecPngTextChunk{vecPngTextChunk}, _options{options},
+    _pipelineOptions{pipelineOptions}
+{
+  // Decode and encode are single-threaded per image; by default there is
+  // one of each per resample worker, so that they keep pace.
+  const size_t workers = std::max( (size_t)1, _pipelineOptions.workers );
+  if( _pipelineOptions.readers == 0 )
+    _pipelineOptions.readers = workers;
+  if( _pipelineOptions.writers == 0 )
+    _pipelineOptions.writers = workers;
+}
+
+/**
+ * Returns once every image read has reached the Writer.
+ *
+ * @param count number of images; the Reader is called with index 0 to
+ *              count-1
+ * @param reader called on the reader threads
+ * @param writer called on the writer threads
+ *
+ * @return number of images handed to the Writer without error
+ *
+ * @throw whatever the Writer threw first; the batch is then stopped
+ */
+size_t
+Pipeline::run( size_t count, const Reader &reader, const Writer &writer )
+{
+  Batch batch( count, _pipelineOptions.queueDepth );
+  return runBatch( batch, reader, writer );
+}
+
+/**
+ * @param costs estimated cost per image, see NFIR::get_resampleCost(); the
+ *              Reader is called with index 0 to costs.size()-1
+ * @param reader called on the reader threads
+ * @param writer called on the writer threads
+ *
+ * @return number of images handed to the Writer without error
+ *
+ * @throw whatever the Writer threw first; the batch is then stopped
+ */
+size_t
+Pipeline::run( const std::vector<double> &costs,
+               const Reader &reader, const Writer &writer )
+{
+  Batch batch( costs.size(), _pipelineOptions.queueDepth );
+  batch.scheduler.reset( new WorkScheduler( costs ) );
+  return runBatch( batch, reader, writer );
+}
+
+/** @return copy */
+PipelineStats
+Pipeline::get_stats(void) const
+{
+  return _stats;
+}
+
+/**
+ * Called on the worker threads, once the target size is known, for each
+ * `raw` or `pgm` target; other targets are encoded.  The PGM header is
+ * written first, then the target is resampled in place behind it, and the
+ * item reaches the Writer with `target` empty.
+ *
+ * @param allocator returns storage of the encoded size, and sets
+ *                  `targetHold` to keep it; empty to encode every target
+ */
+void
+Pipeline::set_targetAllocator( const TargetAllocator &allocator )
+{
+  _targetAllocator = allocator;
+}
+
+/**
+ * @param batch queues and counters, see run()
+ * @param reader called on the reader threads
+ * @param writer called on the writer threads
+ *
+ * @return number of images handed to the Writer without error
+ */
+size_t
+Pipeline::runBatch( Batch &batch, const Reader &reader, const Writer &writer )
+{
+  size_t numReaders = std::max( (size_t)1,
+                                std::min( _pipelineOptions.readers, batch.count ) );
+  size_t numWorkers = std::max( (size_t)1, _pipelineOptions.workers );
+  size_t numWriters = std::max( (size_t)1, _pipelineOptions.writers );
+  batch.workerBusy.assign( numWorkers, 0.0 );
+
+  // The workers and OpenCV's threads share the cores, see ThreadingPlan.
+  const int priorThreads = cv::getNumThreads();
+  if( _pipelineOptions.openCVThreads > 0 )
+    cv::setNumThreads( _pipelineOptions.openCVThreads );
+
+  std::vector<std::thread> readers, workers, writers;
+  for( size_t i = 0; i < numWriters; i++ )
+    writers.emplace_back( [&] { writeStage( batch, writer ); } );
+  for( size_t i = 0; i < numWorkers; i++ )
+    workers.emplace_back( [&, i] { computeStage( batch, i ); } );
+  for( size_t i = 0; i < numReaders; i++ )
+    readers.emplace_back( [&] { readStage( batch, reader ); } );
+
+  // Each stage ends once the stage before it has ended and its queue is
+  // drained.
+  for( auto &t : readers ) t.join();
+  batch.decoded.close();
+  for( auto &t : workers ) t.join();
+  batch.resampled.close();
+  for( auto &t : writers ) t.join();
+
+  if( _pipelineOptions.openCVThreads > 0 )
+    cv::setNumThreads( priorThreads );
+  _stats.workerBusy = batch.workerBusy;
+
+  if( batch.writerError )
+    std::rethrow_exception( batch.writerError );
+  return batch.completed;
+}
+
+/**
+ * Claims images, in order or from the scheduler, until the batch is read or
+ * stopped.  A Reader or decode failure is recorded in the item, which is
+ * passed on regardless.  With Options::streamRows the source is passed on
+ * encoded, for the worker to stream or decode.
+ */
+void
+Pipeline::readStage( Batch &batch, const Reader &reader )
+{
+  while( !batch.stop )
+  {
+    size_t index, position;
+    if( batch.scheduler )
+    {
+      if( !batch.scheduler->next( index, position ) )
+        break;
+    }
+    else
+    {
+      index = position = batch.next++;
+      if( index >= batch.count )
+        break;
+    }
+
+    std::unique_ptr<Job> job( new Job );
+    job->item.index = index;
+    for( size_t p = position + 1;
+         ( p < batch.count ) && ( p <= position + _pipelineOptions.readAhead ); p++ ) {
+      job->item.readAhead.push_back( batch.scheduler ? batch.scheduler->at( p ) : p );
+    }
+    try {
+      reader( job->item );
+      if( _srcComp == "raw" )
+        job->srcImage = decodeRawImage( job->item.source, job->item.sourceSize,
+                                        job->item.sourceWidth,
+                                        job->item.sourceHeight, job->item.log );
+      else if( !_options.streamRows )
+        job->srcImage = decodeImage( job->item.source, job->item.sourceSize,
+                                     job->item.log );
+    }
+    catch( const std::exception &e ) {
+      job->item.error = e.what();
+    }
+    // A decoded image does not refer to the encoded source; a raw or PGM
+    // image read in place does, as does a source left to stream.
+    const uint8_t *sourceEnd = job->item.source + job->item.sourceSize;
+    const bool inPlace = ( job->srcImage.data >= job->item.source )
+                         && ( job->srcImage.data < sourceEnd );
+    const bool toStream = _options.streamRows && job->srcImage.empty();
+    if( !job->item.error.empty() || !( inPlace || toStream ) )
+    {
+      job->item.source = nullptr;
+      job->item.sourceHold.reset();
+    }
+
+    batch.decoded.push( std::move( job ) );
+  }
+}
+
+/**
+ * A source still encoded is streamed straight to the encoded target if
+ * possible, see streamImage(), and decoded otherwise.  An uncompressed
+ * target is resampled into the storage of the TargetAllocator, if any.
+ */
+void
+Pipeline::computeStage( Batch &batch, size_t workerId )
+{
+  SessionCache sessions;
+  std::unique_ptr<Job> job;
+  while( batch.decoded.pop( job ) )
+  {
+    if( job->item.error.empty() )
+    {
+      auto start = std::chrono::steady_clock::now();
+      try {
+        if( _options.streamRows && job->srcImage.empty() )
+        {
+          job->encoded = streamImage( job->item.source, job->item.sourceSize,
+                                      _srcSampleRate, _tgtSampleRate, _srUnits,
+                                      _interpolationMethod, _filterType, _tgtComp,
+                                      _vecPngTextChunk, job->item.log,
+                                      job->item.target, job->item.result,
+                                      _options );
+          if( !job->encoded )
+            job->srcImage = decodeImage( job->item.source, job->item.sourceSize,
+                                         job->item.log );
+        }
+        if( !job->encoded )
+        {
+          Session &session = acquireSession( sessions, job->srcImage.cols,
+                                             job->srcImage.rows );
+          const cv::Size tgtSize = session.get_tgtSize();
+          uint8_t *tgtPixels = allocateTarget( job->item, tgtSize.width,
+                                               tgtSize.height );
+          if( tgtPixels )
+            job->tgtImage = cv::Mat( tgtSize, CV_8UC1, tgtPixels );
+          job->item.result = resampleImage( session, job->srcImage, job->tgtImage,
+                                            job->item.log );
+
+          if( tgtPixels )
+          {
+            // The resamplers write into a target of the right size and type
+            // in place; should one have reallocated, copy.
+            if( job->tgtImage.data != tgtPixels )
+            {
+              if( job->tgtImage.size() != tgtSize )
+                throw NFIR::Miscue( "NFIR lib: target image size differs from session size" );
+              cv::Mat callerImage( tgtSize, CV_8UC1, tgtPixels );
+              job->tgtImage.copyTo( callerImage );
+            }
+            job->encoded = true;
+            job->item.log.push_back( job->item.result.stage
+                                     + " target img written in place (uncompressed, no codec): "
+                                     + std::to_string(tgtSize.area()) + " pixels" );
+          }
+        }
+      }
+      catch( const std::exception &e ) {
+        job->item.error = e.what();
+      }
+      batch.workerBusy[workerId] += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start ).count();
+    }
+    job->srcImage.release();
+    job->item.source = nullptr;
+    job->item.sourceHold.reset();
+
+    batch.resampled.push( std::move( job ) );
+  }
+}
+
+/**
+ * Every item is handed to the Writer, also after a stop, so that the
+ * caller learns the outcome of each image read.  After the Writer has
+ * thrown it is no longer called.
+ */
+void
+Pipeline::writeStage( Batch &batch, const Writer &writer )
+{
+  std::unique_ptr<Job> job;
+  while( batch.resampled.pop( job ) )
+  {
+    if( job->item.error.empty() && !job->encoded )
+    {
+      try {
+        encodeImage( job->tgtImage, job->item.result.stage,
+                     _srcSampleRate, _tgtSampleRate, _srUnits, _tgtComp,
+                     _vecPngTextChunk, job->item.log, job->item.target,
+                     _options );
+      }
+      catch( const std::exception &e ) {
+        job->item.error = e.what();
+      }
+    }
+    job->tgtImage.release();
+
+    {
+      std::lock_guard<std::mutex> lock( batch.mutex );
+      if( batch.writerError )
+        continue;
+    }
+    try {
+      bool proceed = writer( job->item );
+      if( job->item.error.empty() )
+        batch.completed++;
+      if( !proceed )
+        batch.stop = true;
+    }
+    catch( ... ) {
+      std::lock_guard<std::mutex> lock( batch.mutex );
+      if( !batch.writerError )
+        batch.writerError = std::current_exception();
+      batch.stop = true;
+    }
+  }
+}
+
+/**
+ * The batch shares the sample rates, interpolation method, filter type,
+ * and options, so a session is found by the source size alone.  Batches
+ * of mixed sizes keep the most recently used sessions.
+ *
+ * @param cache of the calling worker
+ * @param width source image
+ * @param height source image
+ * @return session for that size, moved to the front of the cache
+ */
+Session&
+Pipeline::acquireSession( SessionCache &cache, int width, int height ) const
+{
+  auto &sessions = cache.sessions;
+  const cv::Size size( width, height );
+  auto it = std::find_if( sessions.begin(), sessions.end(),
+                          [&size]( const std::unique_ptr<Session> &s ) {
+                            return s->get_srcSize() == size; } );
+  if( it != sessions.end() )
+    sessions.splice( sessions.begin(), sessions, it );
+  else
+  {
+    sessions.emplace_front( new Session( _srcSampleRate, _tgtSampleRate,
+                                         _interpolationMethod, _filterType,
+                                         size, _options ) );
+    if( sessions.size() > SessionCache::capacity )
+      sessions.pop_back();
+  }
+  return *sessions.front();
+}
+
+/**
+ * @param item whose target is to be written
+ * @param width target image
+ * @param height target image
+ *
+ * @return first target pixel, behind the PGM header; null for the target
+ *         to be encoded, then `targetHold` is reset
+ */
+uint8_t*
+Pipeline::allocateTarget( PipelineItem &item, int width, int height ) const
+{
+  if( !_targetAllocator || ( width <= 0 ) || ( height <= 0 )
+      || ( ( _tgtComp != "raw" ) && ( _tgtComp != "pgm" ) ) )
+    return nullptr;
+
+  const std::string header = ( _tgtComp == "pgm" ) ? writePgmHeader( width, height )
+                                                   : std::string();
+  uint8_t *storage = _targetAllocator( item, header.size() + (size_t)width * height );
+  if( !storage )
+  {
+    item.targetHold.reset();
+    return nullptr;
+  }
+  std::memcpy( storage, header.data(), header.size() );
+  return storage + header.size();
+}
+
+/** @return 1 with fewer than two workers or no work */
+double
+PipelineStats::get_balance(void) const
+{
+  double total{0.0}, most{0.0};
+  for( double b : workerBusy ) {
+    total += b;
+    most = std::max( most, b );
+  }
+  if( ( workerBusy.size() < 2 ) || ( most <= 0.0 ) )
+    return 1.0;
+  return total / workerBusy.size() / most;
+}
+
+/** @return one line */
+std::string
+PipelineStats::to_s(void) const
+{
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(2)
+     << "Load balance (mean/max worker busy): " << get_balance()
+     << ", busy seconds per worker:";
+  for( double b : workerBusy ) { ss << " " << b; }
+  return ss.str();
+}
+
+}   // End namespace
@@ -0,0 +1,166 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "exceptions.h"
+#include "raw_image.h"
+
+#include <cctype>
+#include <climits>
+#include <cstring>
+
+namespace NFIR {
+
+/**
+ * Magic `P5`, then width, height, and maxval, separated by whitespace and
+ * `#` comments, then a single whitespace.  The pixels are not checked.
+ *
+ * @param encoded IN start of the image
+ * @param encodedSize bytes available at `encoded`
+ * @param header OUT fields
+ *
+ * @return false if not a binary PGM, or its header is incomplete
+ */
+bool
+readPgmHeader( const uint8_t *encoded, size_t encodedSize, PgmHeader &header )
+{
+  if( ( encodedSize < 2 ) || ( encoded[0] != 'P' ) || ( encoded[1] != '5' ) )
+    return false;
+
+  size_t pos{2};
+  uint64_t fields[3]{ 0, 0, 0 };
+  for( uint64_t &field : fields )
+  {
+    while( pos < encodedSize )
+    {
+      if( encoded[pos] == '#' )
+        while( ( pos < encodedSize ) && ( encoded[pos] != '\n' ) ) pos++;
+      else if( std::isspace( encoded[pos] ) )
+        pos++;
+      else
+        break;
+    }
+    if( ( pos >= encodedSize ) || !std::isdigit( encoded[pos] ) )
+      return false;
+    while( ( pos < encodedSize ) && std::isdigit( encoded[pos] ) )
+    {
+      field = field * 10 + ( encoded[pos++] - '0' );
+      if( field > INT_MAX )
+        return false;
+    }
+  }
+  if( ( pos >= encodedSize ) || !std::isspace( encoded[pos] ) )
+    return false;
+
+  header.width = (uint32_t)fields[0];
+  header.height = (uint32_t)fields[1];
+  header.maxval = (uint32_t)fields[2];
+  header.pixelOffset = pos + 1;
+  return true;
+}
+
+/** @return `P5`, width, height, and maxval 255, one line each */
+std::string
+writePgmHeader( uint32_t width, uint32_t height )
+{
+  return "P5\n" + std::to_string(width) + " " + std::to_string(height)
+         + "\n255\n";
+}
+
+/**
+ * @param pixels IN row-major, no padding; must outlive the image
+ * @param size bytes at `pixels`
+ * @param width pixels
+ * @param height pixels
+ *
+ * @return 8-bit, single-channel image; OpenCV neither copies nor frees the
+ *         pixels
+ *
+ * @throw NFIR::Miscue size is not width times height
+ */
+cv::Mat
+mapRawImage( const uint8_t *pixels, size_t size, uint32_t width, uint32_t height )
+{
+  if( ( width == 0 ) || ( height == 0 ) || ( width > INT_MAX ) || ( height > INT_MAX )
+      || ( size != (size_t)width * height ) )
+    throw NFIR::Miscue( "NFIR lib: raw image of " + std::to_string(size)
+                        + " bytes is not " + std::to_string(width) + "x"
+                        + std::to_string(height) );
+  return cv::Mat( (int)height, (int)width, CV_8UC1, const_cast<uint8_t*>( pixels ) );
+}
+
+/**
+ * @param encoded IN binary PGM; must outlive the image
+ * @param encodedSize bytes at `encoded`
+ * @param image OUT 8-bit, single-channel, over the pixels in place
+ *
+ * @return false if not an 8-bit binary PGM
+ *
+ * @throw NFIR::Miscue truncated pixels
+ */
+bool
+mapPgmImage( const uint8_t *encoded, size_t encodedSize, cv::Mat &image )
+{
+  PgmHeader header;
+  if( !readPgmHeader( encoded, encodedSize, header )
+      || ( header.maxval == 0 ) || ( header.maxval > 255 ) )
+    return false;
+  if( encodedSize - header.pixelOffset < (size_t)header.width * header.height )
+    throw NFIR::Miscue( "NFIR lib: truncated PGM image" );
+  image = mapRawImage( encoded + header.pixelOffset,
+                       (size_t)header.width * header.height,
+                       header.width, header.height );
+  return true;
+}
+
+/**
+ * @param image 8-bit, single-channel
+ * @param compression `raw` or `pgm`
+ * @param encoded OUT header, if any, and rows; sized once
+ *
+ * @throw NFIR::Miscue not 8-bit single-channel, or other compression
+ */
+void
+encodeRawImage( const cv::Mat &image, const std::string &compression,
+                std::vector<uint8_t> &encoded )
+{
+  if( image.type() != CV_8UC1 )
+    throw NFIR::Miscue( "NFIR lib: raw/PGM target must be 8-bit, single-channel" );
+
+  std::string header;
+  if( compression == "pgm" )
+    header = writePgmHeader( image.cols, image.rows );
+  else if( compression != "raw" )
+    throw NFIR::Miscue( "NFIR lib: not an uncompressed format: " + compression );
+
+  encoded.resize( header.size() + image.total() );
+  std::memcpy( encoded.data(), header.data(), header.size() );
+  uint8_t *row = encoded.data() + header.size();
+  for( int y = 0; y < image.rows; y++, row += image.cols )
+    std::memcpy( row, image.ptr<uint8_t>( y ), image.cols );
+}
+
+}   // End namespace
@@ -27,6 +27,8 @@ identified are necessarily the best available for the purpose.
 *******************************************************************************/
 #include "resample.h"
 
+#include <numeric>
+
 namespace NFIR {
 
 // Initialization function that resets all values.
@@ -36,6 +38,8 @@ void Resample::Init()
   _resizeFactor = 1.0;
   _srcSampleRate = 500;
   _tgtSampleRate = 500;
+  _filteredImageDimens[0] = 0;
+  _filteredImageDimens[1] = 0;
 }
 
 // Copy function to make clones of an object.
@@ -47,6 +51,8 @@ void Resample::Copy( const Resample& aCopy )
   _resizeFactor = aCopy._resizeFactor;
   _srcSampleRate = aCopy._srcSampleRate;
   _tgtSampleRate = aCopy._tgtSampleRate;
+  _filteredImageDimens[0] = aCopy._filteredImageDimens[0];
+  _filteredImageDimens[1] = aCopy._filteredImageDimens[1];
 }
 
 // Default constructor.
@@ -66,7 +72,8 @@ Resample::Resample( int srcSampleRate, int tgtSampleRate )
   _tgtSampleRate = tgtSampleRate;
 
   _resizeFactor = (float)_tgtSampleRate / (float)_srcSampleRate;
-
+  _filteredImageDimens[0] = 0;
+  _filteredImageDimens[1] = 0;
 }
 
 
@@ -81,6 +88,17 @@ cv::Mat Resample::resize( cv::Mat, NFIR::FilterMask*, Padding& )   // downsample
   cv::Mat mat;
   return mat;
 }
+// Derived classes override these to write into the target buffer; the
+// defaults allocate a new target.
+void Resample::resizeInto( cv::Mat srcImg, cv::Mat &tgtImg )
+{
+  tgtImg = resize( srcImg );
+}
+void Resample::resizeInto( cv::Mat srcImg, cv::Mat &tgtImg,
+                           NFIR::FilterMask* filterMask, Padding& pads )
+{
+  tgtImg = resize( srcImg, filterMask, pads );
+}
 std::vector<std::string> Resample::to_s() const { std::vector<std::string> v; return v; }
 
 // Define all the set methods.
@@ -117,6 +135,16 @@ double Resample::get_resizeFactor(void) const
 {
   return _resizeFactor;
 }
+/** @return target rate / gcd of the rates, eg, 5 for 600 to 500ppi */
+int Resample::get_upFactor(void) const
+{
+  return _tgtSampleRate / std::gcd( _srcSampleRate, _tgtSampleRate );
+}
+/** @return source rate / gcd of the rates, eg, 6 for 600 to 500ppi */
+int Resample::get_downFactor(void) const
+{
+  return _srcSampleRate / std::gcd( _srcSampleRate, _tgtSampleRate );
+}
 
 // std::string Resample::get_filterType(void) const { std::string s{ "" }; return s; }
 
@@ -25,9 +25,24 @@ identification imply recommendation or endorsement by the National Institute
 of Standards and Technology, nor does it imply that the products and equipment
 identified are necessarily the best available for the purpose.
 *******************************************************************************/
+#include "fft_backend.h"
 #include "resample_down.h"
+#include "spectrum_kernels.h"
 
-static cv::Mat applyFilterFreqDomain( cv::Mat complexI, cv::Mat mask );
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+static void cropSpectrumToTarget( const cv::Mat&, const NFIR::FilterMask*,
+                                  cv::Size, double, float,
+                                  NFIR::Downsample::Workspace& );
+static void storeSaturated( const cv::Mat&, cv::Rect, cv::Mat& );
+static void filterSpatialDomain( const cv::Mat&, NFIR::Downsample::Workspace&,
+                                 cv::Mat& );
+static cv::Mat filterTiled( cv::Mat, const NFIR::FilterMask*, int, size_t );
+static size_t fftWorkingSetBytes( cv::Size );
+static std::complex<float> packedValue( const cv::Mat&, int, int );
+static void setPackedValue( cv::Mat&, int, int, std::complex<float> );
 
 
 namespace NFIR {
@@ -54,8 +69,9 @@ Downsample::Downsample( int srcSampleRate, int tgtSampleRate )
   _srcSampleRate = srcSampleRate;
   _tgtSampleRate = tgtSampleRate;
   _resizeFactor = (float)_tgtSampleRate / (float)_srcSampleRate;
-
-  _filteredImageDimens = new uint32_t[2];
+  _filterEngine = "fft";
+  _tileSize = 1024;
+  _memoryBudget = 0;
 }
 
 /**
@@ -73,56 +89,117 @@ cv::Mat Downsample::resize( cv::Mat srcImg,
                             Padding& pads )
 {
   cv::Mat resampledImg;
+  resizeInto( srcImg, resampledImg, filterMask, pads );
+
+  // resampledImg.release();  // Force test NFIR::Miscue
+  return resampledImg;
+}
+
+/**
+ * @param srcImg to be downsampled
+ * @param resampledImg OUT final downsampled, resized image
+ * @param filterMask that is multiplied with the freq domain image
+ * @param pads amount to crop the space domain image
+ * @throw cv::Exception on any/all possible OpenCV exceptions
+ */
+void Downsample::resizeInto( cv::Mat srcImg, cv::Mat &resampledImg,
+                             NFIR::FilterMask* filterMask,
+                             Padding& pads )
+{
   try
   {
-    // ------ STEP #1) DFT.
-    cv::Mat planes[2] = { cv::Mat_<float>(srcImg), cv::Mat::zeros( srcImg.size(), CV_32F ) };
-    cv::Mat complexI;
-    cv::merge(planes, 2, complexI);
+    if( ( _filterEngine == "spatial" ) || ( _filterEngine == "tiled" ) )
+    {
+      // ------ STEP #1-6) Separable lowpass filter in the space domain, or
+      // overlap-save per tile; the source image is not padded, see
+      // resolveFilterEngine().
+      if( _filterEngine == "spatial" )
+      {
+        if( _work.kernelRows.empty() )
+          filterMask->get_spatialKernels( _work.kernelRows, _work.kernelCols,
+                                          _work.offset );
+        filterSpatialDomain( srcImg, _work, _filteredImagePriorToDownsample );
+      }
+      else
+        _filteredImagePriorToDownsample = filterTiled( srcImg, filterMask,
+                                                       _tileSize, _memoryBudget );
+      _filteredImageDimens[0] = _filteredImagePriorToDownsample.cols;
+      _filteredImageDimens[1] = _filteredImagePriorToDownsample.rows;
+
+      // ------ STEP #7) Downsize to target ppi.
+      cv::resize( _filteredImagePriorToDownsample, resampledImg, cv::Size(0, 0), _resizeFactor, _resizeFactor, _interpolationMethod );
+      return;
+    }
 
-    cv::Mat fourierTransform;
-    cv::dft( complexI, fourierTransform, cv::DFT_COMPLEX_OUTPUT );
+    // ------ STEP #1) DFT.
+    // The image is real-valued; its spectrum is conjugate-symmetric and is
+    // returned packed (CCS format) in a single-channel array of image size.
+    // The FFT backend is chosen per transform size, see FFTBackend::select().
+    NFIR::FFTBackend &fft = NFIR::FFTBackend::select( srcImg.size() );
+    srcImg.convertTo( _work.floatImage, CV_32F );
+    fft.forward( _work.floatImage, _work.spectrum );
 
     // ------ STEP #2) Scale/normalize by dividing by the DC component.
-    cv::Mat scaledFwdDFT;
-    cv::multiply( fourierTransform, (float)1/srcImg.total(), scaledFwdDFT );
+    // Folded into the filter/mask of step 3; no separate pass.
+    const float scale = (float)1/srcImg.total();
 
-    // ------ STEP #3) Apply filter/mask to image spectrum in freq domain.
-    // Multiplication in freq domain where the (multiplicands/factors) spectrums
-    // have DC term in center.  The filter/mask was constructed to have DC term
-    // in center, therefore, shift the fourier transform signal.
-    cv::Mat filteredSpectrum = applyFilterFreqDomain( scaledFwdDFT, filterMask->get_theFilterMask() );
-
-    // ------ STEP #4) Inverse Fourier transform (iDFT).
-    cv::Mat inverseTransform;
-    cv::dft( filteredSpectrum, inverseTransform, cv::DFT_INVERSE );
-
-    // ------ STEP #5) extract image that is (polar) magnitude of inverse Fourier transform.
-    cv::Mat planes2[] = { cv::Mat::zeros( inverseTransform.size(), CV_32F ), cv::Mat::zeros( inverseTransform.size(), CV_32F ) };
-    cv::split(inverseTransform, planes2);  // planes2[0] = Re(DFT(I), planes2[1] = Im(DFT(I))
-    cv::Mat finalImage;
-    planes2[0].convertTo(finalImage, CV_8U);  // cast bit depth for each pixel to 8-bits (0..255) from CV_32F
-
-    // ------ STEP #6) Crop padding.
-    int startX=pads.left;  // since padding only right and bottom, this is 0.
-    int startY=pads.top;   // since padding only right and bottom, this is 0.
     int cropWidth=srcImg.cols - pads.right;
     int cropHeight=srcImg.rows - pads.bottom;
-    cv::Mat croppedImage( finalImage, cv::Rect(startX, startY, cropWidth, cropHeight) );
 
-    _filteredImagePriorToDownsample = croppedImage.clone();
+    if( _interpolationMethod == INTER_SPECTRAL )
+    {
+      // ------ STEP #3-7) Fused filter and decimate.  The target-size band
+      // of the filtered spectrum is inverse transformed at target resolution.
+      // The padded size was chosen (see get_padMultiple()) so that it
+      // scales to the target size exactly.
+      int num = get_upFactor();
+      int den = get_downFactor();
+      cv::Size bandSize( srcImg.cols / den * num, srcImg.rows / den * num );
+      // Sample at the same pixel-centers as cv::resize, ie, target pixel n
+      // is at source position (n + 0.5)/resizeFactor - 0.5.
+      double shift = ( (double)den / num - 1.0 ) / 2.0;
+      cropSpectrumToTarget( _work.spectrum, filterMask, bandSize, shift, scale,
+                            _work );
+
+      NFIR::FFTBackend::select( bandSize ).inverse( _work.band, _work.bandImage );
+
+      // Same target size as cv::resize( ..., cv::Size(0, 0), fx, fy ).
+      cv::Rect tgtRect( 0, 0, cvRound( cropWidth * _resizeFactor ),
+                              cvRound( cropHeight * _resizeFactor ) );
+      storeSaturated( _work.bandImage, tgtRect, resampledImg );
+
+      // The full-size, filtered image is never generated.
+      _filteredImagePriorToDownsample.release();
+      _filteredImageDimens[0] = 0;
+      _filteredImageDimens[1] = 0;
+      return;
+    }
+
+    // ------ STEP #3) Apply filter/mask to image spectrum in freq domain.
+    // IMPLEMENT THE LOWPASS FILTER by multiplication in the frequency domain.
+    // The filter/mask is real-valued and shifted to match the packed image
+    // spectrum; multiply in place, scaled per step 2.
+    filterMask->applyPacked( _work.spectrum, scale );
+
+    // ------ STEP #4) Inverse Fourier transform (iDFT) of the packed spectrum
+    // is real-valued.
+    fft.inverse( _work.spectrum, _work.inverse );
+
+    // ------ STEP #5-6) Extract the 8-bit image from the inverse Fourier
+    // transform, cropped of its padding; the padding is never converted.
+    int startX=pads.left;  // since padding only right and bottom, this is 0.
+    int startY=pads.top;   // since padding only right and bottom, this is 0.
+    storeSaturated( _work.inverse, cv::Rect(startX, startY, cropWidth, cropHeight),
+                    _filteredImagePriorToDownsample );
     _filteredImageDimens[0] = _filteredImagePriorToDownsample.cols;
     _filteredImageDimens[1] = _filteredImagePriorToDownsample.rows;
 
     // ------ STEP #7) Downsize to target ppi.
-    cv::resize( croppedImage, resampledImg, cv::Size(0, 0), _resizeFactor, _resizeFactor, _interpolationMethod );
+    cv::resize( _filteredImagePriorToDownsample, resampledImg, cv::Size(0, 0), _resizeFactor, _resizeFactor, _interpolationMethod );
   }
   catch( const cv::Exception& ex ) {
     throw ex;
   }
-
-  // resampledImg.release();  // Force test NFIR::Miscue
-  return resampledImg;
 }
 
 
@@ -136,7 +213,7 @@ cv::Mat Downsample::resize( cv::Mat srcImg )
 }
 
 /** @return WxH */
-uint32_t *Downsample::get_filteredImageDimens() const
+const uint32_t *Downsample::get_filteredImageDimens() const
 {
   return _filteredImageDimens;
 }
@@ -177,13 +254,21 @@ std::vector<std::string> Downsample::to_s(void) const
   v.push_back("  resize factor:       " + std::to_string(get_resizeFactor()) );
   v.push_back("Filter & Interpolation: " + _configRecap );
   v.push_back("  filter/mask type:     " + _filterType );
+  v.push_back("  filter engine:        " + _filterEngine );
+  v.push_back("  SIMD kernels:         " + NFIR::SpectrumKernels::get_isa() );
+  if( _filterEngine == "tiled" )
+  {
+    v.push_back("  tile size:            " + std::to_string(_tileSize) );
+    v.push_back("  memory budget:        " + std::to_string(_memoryBudget) );
+  }
   v.push_back("  interpolation method:  " + std::to_string(get_interpolationMethod())
-            + "  (1=bilinear, 2=bicubic)\n" );
+            + "  (1=bilinear, 2=bicubic, "
+            + std::to_string(INTER_SPECTRAL) + "=spectral)\n" );
   return v;
 }
 
 /**
- * @param im interpolation method `bicubic` or `bilinear`
+ * @param im interpolation method `bicubic`, `bilinear`, or `spectral`
  * @param fs filter type `Gaussian` or `ideal`
  *
  * @throw NFIR::Miscue invalid interpolation method or filter type
@@ -199,6 +284,8 @@ void Downsample::set_interpolationMethodAndFilterType( const std::string im, con
       _interpolationMethod = cv::INTER_CUBIC;
     else if( im == "bilinear" )
       _interpolationMethod = cv::INTER_LINEAR;
+    else if( im == "spectral" )
+      _interpolationMethod = INTER_SPECTRAL;
     else
       throw NFIR::Miscue( "NFIR lib: invalid interpolation method: " + im );
 
@@ -245,53 +332,416 @@ std::string Downsample::get_filterType(void) const
   return _filterType;
 }
 
+/**
+ * @param engine `fft` (default when empty), `auto`, `spatial`, or `tiled`
+ *
+ * @throw NFIR::Miscue invalid engine
+ */
+void Downsample::set_filterEngine( const std::string engine )
+{
+  if( ( engine == "" ) || ( engine == "fft" ) )
+    _filterEngine = "fft";
+  else if( ( engine == "auto" ) || ( engine == "spatial" ) || ( engine == "tiled" ) )
+    _filterEngine = engine;
+  else
+    throw NFIR::Miscue( "NFIR lib: invalid filter engine: " + engine );
+}
+
+/** @return "auto" until resolved, then "fft", "spatial", or "tiled" */
+std::string Downsample::get_filterEngine(void) const
+{
+  return _filterEngine;
+}
+
+/**
+ * The spatial engine requires a filter/mask that has a separable, short
+ * space-domain kernel (Gaussian) and does not apply to spectral decimation;
+ * neither does the tiled engine.
+ *
+ * For `auto`, estimate the cost per image of both engines:
+ *
+ * - spatial: one multiply-add per kernel tap, row and column passes, plus
+ *   the offset term, over the unpadded image
+ * - FFT: forward and inverse real-input DFT, about 2.5*log2(size) each,
+ *   plus the mask multiply, over the padded image
+ *
+ * and use the cheaper one.  The FFT is tiled when the whole-image working set
+ * exceeds the memory budget, except for spectral decimation, which is
+ * whole-image only.
+ *
+ * @param imageSize source image, not padded
+ * @param paddedSize padded image size as used by the FFT engine
+ * @param filterMask built for `paddedSize`
+ *
+ * @throw NFIR::Miscue spatial engine requested but not supported
+ */
+void Downsample::resolveFilterEngine( cv::Size imageSize, cv::Size paddedSize,
+                                      const NFIR::FilterMask *filterMask )
+{
+  // The kernels are kept for the spatial engine, see resizeInto().
+  bool isSeparable = ( _interpolationMethod != INTER_SPECTRAL )
+                  && filterMask->get_spatialKernels( _work.kernelRows,
+                                                     _work.kernelCols,
+                                                     _work.offset );
+
+  if( _filterEngine == "spatial" )
+  {
+    if( !isSeparable )
+      throw NFIR::Miscue( "NFIR lib: spatial filter engine requires Gaussian "
+                          "filter, a kernel shorter than half the image, and "
+                          "bicubic or bilinear interpolation" );
+    return;
+  }
+  if( _filterEngine == "tiled" )
+  {
+    if( _interpolationMethod == INTER_SPECTRAL )
+      throw NFIR::Miscue( "NFIR lib: tiled filter engine requires bicubic "
+                          "or bilinear interpolation" );
+    return;
+  }
+  if( _filterEngine == "fft" )
+    return;
+
+  // Spectral decimation has no tiled form; as get_maskSize(), it stays on
+  // the whole-image FFT whatever the budget.
+  _filterEngine = ( ( _interpolationMethod != INTER_SPECTRAL )
+                    && exceedsMemoryBudget( paddedSize ) ) ? "tiled" : "fft";
+  if( !isSeparable )
+    return;
+
+  double spatialCost = (double)imageSize.area()
+                     * ( _work.kernelRows.total() + _work.kernelCols.total() + 1 );
+  double fftCost = (double)paddedSize.area()
+                 * ( 5.0 * std::log2( (double)paddedSize.area() ) + 1 );
+  if( spatialCost < fftCost )
+    _filterEngine = "spatial";
+}
+
+/**
+ * The tile size is rounded up to an even, DFT-friendly size.
+ *
+ * @param tileSize pixels, at least 64
+ * @param memoryBudget bytes, 0 for unbounded
+ *
+ * @throw NFIR::Miscue tile size too small
+ */
+void Downsample::set_tiling( int tileSize, size_t memoryBudget )
+{
+  if( tileSize < 64 )
+    throw NFIR::Miscue( "NFIR lib: tile size must be at least 64: "
+                        + std::to_string(tileSize) );
+  _tileSize = cv::getOptimalDFTSize( tileSize );
+  while( _tileSize % 2 )
+    _tileSize = cv::getOptimalDFTSize( _tileSize + 1 );
+  _memoryBudget = memoryBudget;
+}
+
+/** @return pixels */
+int Downsample::get_tileSize(void) const
+{
+  return _tileSize;
+}
+
+/**
+ * Call after set_filterEngine() and set_tiling(); if the engine is, or
+ * resolves to, `tiled`, the filter/mask is built for one tile.
+ *
+ * @param paddedSize padded image size as used by the FFT engine
+ * @return mask size
+ */
+cv::Size Downsample::get_maskSize( cv::Size paddedSize ) const
+{
+  bool isTiled = ( _filterEngine == "tiled" )
+              || ( ( _filterEngine == "auto" )
+                && ( _interpolationMethod != INTER_SPECTRAL )
+                && exceedsMemoryBudget( paddedSize ) );
+  return isTiled ? cv::Size( _tileSize, _tileSize ) : paddedSize;
+}
+
+/**
+ * @param paddedSize padded image size as used by the FFT engine
+ * @return true if a budget is set and the whole-image FFT exceeds it
+ */
+bool Downsample::exceedsMemoryBudget( cv::Size paddedSize ) const
+{
+  return ( _memoryBudget > 0 )
+      && ( fftWorkingSetBytes( paddedSize ) > _memoryBudget );
+}
+
+/**
+ * For `spectral` decimation, the padded size N must scale to an integer
+ * target size N * tgt/src.  With the rate ratio reduced to lowest terms,
+ * num/den, N must be a multiple of den; and, to keep the target size even,
+ * of 2*den.
+ *
+ * @return 2 or, for spectral decimation, 2*den
+ */
+int Downsample::get_padMultiple(void) const
+{
+  if( _interpolationMethod != INTER_SPECTRAL )
+    return 2;
+
+  return 2 * get_downFactor();
+}
+
 }   // End namespace
 
 /**
- * @brief Wrapper for OpenCV `mulSpectrums` function.
+ * @brief Crop the packed spectrum to the target-size frequency band.
+ *
+ * The lowpass filter is applied, only to the frequencies that are kept,
+ * while copying.  Each kept frequency is also phase-shifted by `shift`
+ * source pixels so that the inverse transform samples the filtered image
+ * at the same positions as cv::resize.
+ *
+ * The Nyquist row and column of the target band are set to zero; they
+ * cannot hold a phase-shifted, real-valued signal.
+ *
+ * @param packedSpectrum CCS packed spectrum of the padded image, N x M
+ * @param filterMask built for N x M
+ * @param bandSize target band, even width and height
+ * @param shift sample offset in source pixels
+ * @param scale applied to every frequency, ie, DFT normalization
+ * @param work OUT `band`, CCS packed spectrum of the target band; the phase
+ *             ramps are also kept here
+ */
+void cropSpectrumToTarget( const cv::Mat &packedSpectrum,
+                           const NFIR::FilterMask *filterMask,
+                           cv::Size bandSize, double shift, float scale,
+                           NFIR::Downsample::Workspace &work )
+{
+  const double twoPi = 2.0 * 3.14159265358979323846;
+  int N = packedSpectrum.rows;
+  int M = packedSpectrum.cols;
+  int Nt = bandSize.height;
+  int Mt = bandSize.width;
+
+  // Separable phase ramps, one per signed frequency of the band.
+  std::vector<std::complex<float>> &rowPhase = work.rowPhase;
+  std::vector<std::complex<float>> &colPhase = work.colPhase;
+  rowPhase.resize( Nt );
+  colPhase.resize( Mt/2 );
+  for( int r=0; r<Nt; r++ ) {
+    int kr = ( r <= Nt/2 ) ? r : r - Nt;
+    rowPhase[r] = std::polar( scale, (float)( twoPi * kr * shift / N ) );
+  }
+  for( int c=0; c<Mt/2; c++ ) {
+    colPhase[c] = std::polar( 1.0f, (float)( twoPi * c * shift / M ) );
+  }
+
+  cv::Mat &band = work.band;
+  band.create( Nt, Mt, CV_32F );
+  band.setTo( 0 );
+  for( int c=0; c<Mt/2; c++ )     // skip the Nyquist column, c = Mt/2
+  {
+    // Column 0 of a real signal is conjugate-symmetric; store the top half.
+    int lastRow = ( c == 0 ) ? Nt/2 : Nt;
+    for( int r=0; r<lastRow; r++ )
+    {
+      if( r == Nt/2 )             // skip the Nyquist row
+        continue;
+      int u = ( r <= Nt/2 ) ? r : N - ( Nt - r );
+      std::complex<float> value = packedValue( packedSpectrum, u, c )
+                                * filterMask->get_value( u, c )
+                                * rowPhase[r] * colPhase[c];
+      setPackedValue( band, r, c, value );
+    }
+  }
+}
+
+/**
+ * @brief Read one frequency from a CCS packed spectrum.
+ *
+ * @param packed spectrum, N x M, both even
+ * @param u row frequency 0..N-1
+ * @param v column frequency 0..M/2
+ *
+ * @return Y(u,v)
+ */
+std::complex<float> packedValue( const cv::Mat &packed, int u, int v )
+{
+  int N = packed.rows;
+  int M = packed.cols;
+  if( ( v == 0 ) || ( v == M/2 ) )
+  {
+    int j = ( v == 0 ) ? 0 : M-1;
+    if( u == 0 )
+      return { packed.at<float>( 0, j ), 0.0f };
+    if( u == N/2 )
+      return { packed.at<float>( N-1, j ), 0.0f };
+    if( u > N/2 )
+      return std::conj( packedValue( packed, N-u, v ) );
+    return { packed.at<float>( 2*u-1, j ), packed.at<float>( 2*u, j ) };
+  }
+  return { packed.at<float>( u, 2*v-1 ), packed.at<float>( u, 2*v ) };
+}
+
+/**
+ * @brief Write one frequency to a CCS packed spectrum.
+ *
+ * For column frequencies 0 and M/2, only rows 0..N/2 are stored; the imaginary
+ * part of rows 0 and N/2 is dropped.
+ *
+ * @param packed spectrum, N x M, both even
+ * @param u row frequency 0..N-1
+ * @param v column frequency 0..M/2
+ * @param value Y(u,v)
+ */
+void setPackedValue( cv::Mat &packed, int u, int v, std::complex<float> value )
+{
+  int N = packed.rows;
+  int M = packed.cols;
+  if( ( v == 0 ) || ( v == M/2 ) )
+  {
+    int j = ( v == 0 ) ? 0 : M-1;
+    if( u == 0 )
+      packed.at<float>( 0, j ) = value.real();
+    else if( u == N/2 )
+      packed.at<float>( N-1, j ) = value.real();
+    else if( u < N/2 ) {
+      packed.at<float>( 2*u-1, j ) = value.real();
+      packed.at<float>( 2*u, j ) = value.imag();
+    }
+    return;
+  }
+  packed.at<float>( u, 2*v-1 ) = value.real();
+  packed.at<float>( u, 2*v ) = value.imag();
+}
+
+/**
+ * @brief Lowpass filter in the space domain with a separable kernel.
  *
- * IMPLEMENT THE LOWPASS FILTER by multiplication in the frequency domain.
+ * The frequency-domain mask is `rowProfile(u) * colProfile(v) + offset`; the
+ * equivalent space-domain filter is the separable convolution with the
+ * inverse DFT of each profile plus `offset` times the image itself, see
+ * FilterMask::get_spatialKernels().
  *
- * Since the lowpass filter mask was constructed in one "channel" as a single
- * 2-dimensional array (a "plane"), the mask is "merged" into 2 channels.
+ * The FFT engine pads the image with white pixels and its convolution is
+ * circular; the image is therefore bordered with white pixels here, too.
+ *
+ * @param srcImg 8-bit, not padded
+ * @param work kernels and offset per FilterMask::get_spatialKernels(); the
+ *             intermediate images are kept here
+ * @param filteredImage OUT filtered 8-bit image, same size as `srcImg`
+ */
+void filterSpatialDomain( const cv::Mat &srcImg, NFIR::Downsample::Workspace &work,
+                          cv::Mat &filteredImage )
+{
+  int radiusY = (int)work.kernelRows.total() / 2;
+  int radiusX = (int)work.kernelCols.total() / 2;
+
+  cv::copyMakeBorder( srcImg, work.bordered, radiusY, radiusY, radiusX, radiusX,
+                      cv::BORDER_CONSTANT, cv::Scalar::all(255) );
+
+  cv::sepFilter2D( work.bordered, work.convolved, CV_32F,
+                   work.kernelCols, work.kernelRows );
+  cv::Rect imageRect( radiusX, radiusY, srcImg.cols, srcImg.rows );
+
+  cv::addWeighted( work.convolved( imageRect ), 1.0, srcImg, work.offset, 0.0,
+                   work.filtered, CV_32F );
+
+  work.filtered.convertTo( filteredImage, CV_8U );
+}
+
+/**
+ * @brief Overlap-save lowpass filter, tile by tile.
  *
- * ```
- *  EXAMPLE]
+ * The filter/mask is built for one tile; it has the same cutoff, relative to
+ * the Nyquist frequency, as the whole-image filter/mask.  Each tile overlaps
+ * its neighbors by `tileSize/8` pixels on each side; the circular
+ * convolution wraps into that margin only, so the center of the tile is kept.
+ * Outside the image the tiles are white, as is the whole-image padding.
  *
- *  Mat m1 = (Mat_<uchar>(2,2) << 1,4,7,10);
- *  Mat m2 = (Mat_<uchar>(2,2) << 2,5,8,11);
- *  Mat m3 = (Mat_<uchar>(2,2) << 3,6,9,12);
- *  Mat channels[3] = {m1, m2, m3};
- *  Mat m;
- *  merge(channels, 3, m);
- *  ---
- *  m =
- *    [1, 2, 3, 4,  5,  6;
- *     7, 8, 9, 10, 11, 12]
- *  m.channels() = 3
- *  ---
- * ```
+ * Tolerance against the whole-image FFT, 8-bit output: Gaussian at most one
+ * gray level (rounding); ideal mean below one gray level, with a few gray
+ * levels near strong content at the cutoff frequency since the ideal
+ * filter/mask is sampled on the coarser tile frequency grid.
  *
- * Only the real-part of the complex image is filtered, so half the merged
- * array contains zeros "interlaced" with the real-part.  The 2-channel complex
- * image is multiplied by this 2-channel mask.
+ * Tiles are filtered in parallel, in batches of at most the number of
+ * threads and of as many tiles as fit the memory budget.
  *
- * @param complexI has 2 channels
- * @param mask has one channel
+ * @param srcImg 8-bit, not padded
+ * @param filterMask built for tileSize x tileSize
+ * @param tileSize pixels, even
+ * @param memoryBudget bytes of tiles in flight, 0 for unbounded
  *
- * @return filtered image in freq domain
+ * @return filtered 8-bit image, same size as `srcImg`
  */
-cv::Mat applyFilterFreqDomain( cv::Mat complexI, cv::Mat mask )
+cv::Mat filterTiled( cv::Mat srcImg, const NFIR::FilterMask *filterMask,
+                     int tileSize, size_t memoryBudget )
 {
-  cv::Mat planes[] = {cv::Mat::zeros( complexI.size(), CV_32F ),
-                      cv::Mat::zeros( complexI.size(), CV_32F )};
-  cv::Mat kernel_spec;
-  planes[0] = mask;    // real
-  // planes[1] = mask; // imaginary, no change with this in or out.
-  cv::merge( planes, 2, kernel_spec );
+  const int margin = tileSize / 8;
+  const int core = tileSize - 2 * margin;
+  const int tilesX = ( srcImg.cols + core - 1 ) / core;
+  const int tilesY = ( srcImg.rows + core - 1 ) / core;
+  const int numTiles = tilesX * tilesY;
+
+  int batch = std::max( 1, cv::getNumThreads() );
+  if( memoryBudget > 0 )
+  {
+    size_t fit = memoryBudget / fftWorkingSetBytes( cv::Size( tileSize, tileSize ) );
+    batch = std::max( 1, (int)std::min( (size_t)batch, fit ) );
+  }
 
-  cv::Mat filteredSpectrum;
-  cv::mulSpectrums( complexI, kernel_spec, filteredSpectrum, cv::DFT_ROWS );  // DFT_ROWS accepted);
+  cv::Mat filteredImage( srcImg.size(), CV_8U );
+  const cv::Rect imageRect( 0, 0, srcImg.cols, srcImg.rows );
+  NFIR::FFTBackend &fft = NFIR::FFTBackend::select( cv::Size( tileSize, tileSize ) );
+
+  for( int first=0; first<numTiles; first+=batch )
+  {
+    int last = std::min( numTiles, first + batch );
+    cv::parallel_for_( cv::Range( first, last ), [&]( const cv::Range &range )
+    {
+      for( int t=range.start; t<range.end; t++ )
+      {
+        cv::Rect coreRect( ( t % tilesX ) * core, ( t / tilesX ) * core, core, core );
+        cv::Rect tileRect( coreRect.x - margin, coreRect.y - margin, tileSize, tileSize );
+
+        // White outside the image.
+        cv::Mat tile( tileSize, tileSize, CV_32F, cv::Scalar::all(255) );
+        cv::Rect inside = tileRect & imageRect;
+        cv::Mat tileInside = tile( inside - tileRect.tl() );
+        srcImg( inside ).convertTo( tileInside, CV_32F );
+
+        cv::Mat spectrum;
+        fft.forward( tile, spectrum );
+        filterMask->applyPacked( spectrum, (float)1/tile.total() );
+        fft.inverse( spectrum, tile );
+
+        cv::Rect keep = coreRect & imageRect;
+        cv::Mat filteredCore = filteredImage( keep );
+        storeSaturated( tile, keep - tileRect.tl(), filteredCore );
+      }
+    } );
+  }
+  return filteredImage;
+}
+
+/**
+ * @brief Approximate peak bytes of the FFT filter: the float image, its
+ * packed spectrum, and the inverse transform.
+ *
+ * @param size padded image or tile
+ * @return bytes
+ */
+size_t fftWorkingSetBytes( cv::Size size )
+{
+  return (size_t)size.area() * sizeof(float) * 3;
+}
 
-  return filteredSpectrum;
+/**
+ * @brief Convert a rectangle of a float image to 8-bit, rounded and
+ * saturated, see SpectrumKernels::storeSaturated().
+ *
+ * @param src CV_32F
+ * @param rect of `src` to convert
+ * @param dst OUT CV_8U, rect size; existing data is written in place
+ */
+void storeSaturated( const cv::Mat &src, cv::Rect rect, cv::Mat &dst )
+{
+  dst.create( rect.height, rect.width, CV_8U );
+  for( int r=0; r<rect.height; r++ ) {
+    NFIR::SpectrumKernels::storeSaturated( src.ptr<float>( rect.y + r ) + rect.x,
+                                           dst.ptr<uint8_t>( r ), rect.width );
+  }
 }
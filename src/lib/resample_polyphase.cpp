@@ -0,0 +1,407 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "resample_polyphase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+static double besselI0( double );
+static double kaiserSinc( double, double, double );
+
+/** @brief Zero crossings of the sinc on either side, at the cutoff */
+static const int zeroCrossings{ 4 };
+/** @brief Kaiser window shape; about 60 dB stopband attenuation */
+static const double kaiserBeta{ 6.0 };
+
+
+namespace NFIR {
+
+// Default constructor.
+Polyphase::Polyphase()
+{
+  Init();
+  _interpolationMethod = INTER_POLYPHASE;
+  _table = PhaseTable::acquire( get_upFactor(), get_downFactor() );
+}
+// Copy constructor.
+Polyphase::Polyphase( const Polyphase& aCopy ) : Resample::Resample( aCopy )
+{
+  Copy( aCopy );
+  _table = aCopy._table;
+}
+
+/** Full constructor.  Calculates the image resize factor and acquires the
+ * phase table for the ratio.
+ *
+ * @param srcSampleRate source image ppi
+ * @param tgtSampleRate target image ppi
+ */
+Polyphase::Polyphase( int srcSampleRate, int tgtSampleRate )
+{
+  _srcSampleRate = srcSampleRate;
+  _tgtSampleRate = tgtSampleRate;
+
+  _resizeFactor = (float)_tgtSampleRate / (float)_srcSampleRate;
+  _interpolationMethod = INTER_POLYPHASE;
+  _table = PhaseTable::acquire( get_upFactor(), get_downFactor() );
+}
+
+
+/**
+ * Tables are few (one per ratio) and small; they are kept for the life of
+ * the process.  Thread-safe.
+ *
+ * For phase r, target pixel q*L + r is at source position q*M + x with
+ * `x = (r + 0.5) * M/L - 0.5`.  The taps are the source pixels nearest x,
+ * weighted by the windowed sinc of their distance to x.
+ *
+ * @param upFactor L
+ * @param downFactor M
+ *
+ * @return shared, immutable table
+ */
+std::shared_ptr<const Polyphase::PhaseTable>
+Polyphase::PhaseTable::acquire( int upFactor, int downFactor )
+{
+  static std::mutex mtx;
+  static std::map<std::pair<int,int>, std::shared_ptr<const PhaseTable>> tables;
+
+  std::lock_guard<std::mutex> lock( mtx );
+  auto it = tables.find( { upFactor, downFactor } );
+  if( it != tables.end() )
+    return it->second;
+
+  auto table = std::make_shared<PhaseTable>();
+  table->upFactor = upFactor;
+  table->downFactor = downFactor;
+
+  // Cutoff relative to the source Nyquist frequency.
+  double cutoff = std::min( 1.0, (double)upFactor / downFactor );
+  double halfWidth = zeroCrossings / cutoff;
+  int taps = 2 * (int)std::ceil( halfWidth );
+  table->taps = taps;
+  table->first.resize( upFactor );
+  table->weights.resize( (size_t)upFactor * taps );
+
+  for( int r=0; r<upFactor; r++ )
+  {
+    double x = ( r + 0.5 ) * downFactor / upFactor - 0.5;
+    int first = (int)std::floor( x ) - taps/2 + 1;
+    table->first[r] = first;
+
+    float *w = &table->weights[(size_t)r * taps];
+    double sum = 0.0;
+    for( int t=0; t<taps; t++ ) {
+      w[t] = (float)kaiserSinc( first + t - x, cutoff, halfWidth );
+      sum += w[t];
+    }
+    for( int t=0; t<taps; t++ ) {   // unity gain at DC
+      w[t] = (float)( w[t] / sum );
+    }
+  }
+
+  tables[{ upFactor, downFactor }] = table;
+  return table;
+}
+
+
+/** Stream the image through start(), pushRow(), finish().
+ *
+ * @param srcImg 8-bit, single-channel
+ * @return target resized image
+ *
+ * @throw NFIR::Miscue source image not 8-bit, single-channel
+ */
+cv::Mat Polyphase::resize( cv::Mat srcImg )
+{
+  cv::Mat resampledImg;
+  resizeInto( srcImg, resampledImg );
+  return resampledImg;
+}
+
+/** Same as resize(), the target buffer is reused if already allocated at
+ * the target size.
+ *
+ * @param srcImg 8-bit, single-channel
+ * @param tgtImg OUT target resized image
+ *
+ * @throw NFIR::Miscue source image not 8-bit, single-channel
+ */
+void Polyphase::resizeInto( cv::Mat srcImg, cv::Mat &tgtImg )
+{
+  if( srcImg.type() != CV_8UC1 )
+    throw NFIR::Miscue( "NFIR lib: polyphase requires 8-bit, single-channel image" );
+
+  tgtImg.create( get_targetSize( srcImg.size() ), CV_8UC1 );
+  start( srcImg.size(),
+         [&tgtImg]( int row, const uint8_t *pixels ) {
+           std::copy( pixels, pixels + tgtImg.cols, tgtImg.ptr<uint8_t>(row) );
+         } );
+  for( int y=0; y<srcImg.rows; y++ ) {
+    pushRow( srcImg.ptr<uint8_t>(y) );
+  }
+  finish();
+}
+
+/** No filter/mask is used.
+ *   NOT TO BE CALLED; overridden to satisfy linker.
+ * @param srcImg to be resized by the amount of the __resizeFactor__
+ * @param pads reset to zero
+ *
+ * @return target resized image
+ */
+cv::Mat Polyphase::resize( cv::Mat srcImg, NFIR::FilterMask*, Padding& pads )
+{
+  pads.reset();
+  return resize( srcImg );
+}
+
+
+Polyphase Polyphase::Clone(void)
+{
+  Polyphase c;
+  c.Copy( *this );
+  c._table = _table;
+  return c;
+}
+
+Polyphase Polyphase::operator=( const Polyphase& aCopy )
+{
+  Copy( aCopy );
+  _table = aCopy._table;
+  return *this;
+}
+
+
+/**
+ * @param im interpolation method `polyphase`, or empty
+ *
+ * @throw NFIR::Miscue invalid interpolation method
+ */
+void Polyphase::set_interpolationMethod( const std::string im )
+{
+  _configRecap = "Interpolation method specified by user (per config).";
+  if( ( im == "polyphase" ) || ( im == "" ) )
+    _interpolationMethod = INTER_POLYPHASE;
+  else
+    throw NFIR::Miscue( "NFIR lib: invalid interpolation method: " + im );
+}
+
+/**
+ * @param srcSize source image
+ * @return same as `cv::resize( ..., cv::Size(0, 0), fx, fy )`
+ */
+cv::Size Polyphase::get_targetSize( cv::Size srcSize ) const
+{
+  return cv::Size( cvRound( srcSize.width * _resizeFactor ),
+                   cvRound( srcSize.height * _resizeFactor ) );
+}
+
+/**
+ * Resets the stream; the per-column taps are resolved once, with the image
+ * borders replicated.
+ *
+ * @param srcSize source image
+ * @param sink receives each target row, in order, exactly once
+ */
+void Polyphase::start( cv::Size srcSize, RowSink sink )
+{
+  const int L = _table->upFactor;
+  const int M = _table->downFactor;
+  const int taps = _table->taps;
+
+  _srcSize = srcSize;
+  _tgtSize = get_targetSize( srcSize );
+  _sink = sink;
+  _rowsPushed = 0;
+  _nextRow = 0;
+
+  _colIndex.resize( (size_t)_tgtSize.width * taps );
+  _colWeights.resize( _tgtSize.width );
+  for( int n=0; n<_tgtSize.width; n++ )
+  {
+    int r = n % L;
+    int first = ( n / L ) * M + _table->first[r];
+    for( int t=0; t<taps; t++ ) {
+      _colIndex[(size_t)n * taps + t] = std::clamp( first + t, 0, _srcSize.width - 1 );
+    }
+    _colWeights[n] = r * taps;
+  }
+
+  _ring.create( taps, _tgtSize.width, CV_32F );
+  _accRow.resize( _tgtSize.width );
+  _outRow.resize( _tgtSize.width );
+}
+
+/**
+ * Filters the row horizontally into the ring buffer, then emits every target
+ * row whose source rows have all arrived.
+ *
+ * @param pixels source row, source width
+ *
+ * @throw NFIR::Miscue more rows than the source height
+ */
+void Polyphase::pushRow( const uint8_t *pixels )
+{
+  const int taps = _table->taps;
+  if( _rowsPushed >= _srcSize.height )
+    throw NFIR::Miscue( "NFIR lib: polyphase, too many source rows" );
+
+  float *dst = _ring.ptr<float>( _rowsPushed % taps );
+  const int *idx = _colIndex.data();
+  const float *weights = _table->weights.data();
+  for( int n=0; n<_tgtSize.width; n++, idx += taps )
+  {
+    const float *w = weights + _colWeights[n];
+    float sum = 0.f;
+    for( int t=0; t<taps; t++ ) {
+      sum += w[t] * pixels[idx[t]];
+    }
+    dst[n] = sum;
+  }
+  int lastRow = _rowsPushed++;
+
+  while( _nextRow < _tgtSize.height )
+  {
+    int lastNeeded = std::min( _srcSize.height - 1,
+                               firstSourceIndex( _nextRow ) + taps - 1 );
+    if( lastNeeded > lastRow )
+      break;
+    emitRow( _nextRow++ );
+  }
+}
+
+/**
+ * @throw NFIR::Miscue fewer rows pushed than the source height
+ */
+void Polyphase::finish(void)
+{
+  if( ( _rowsPushed != _srcSize.height ) || ( _nextRow != _tgtSize.height ) )
+    throw NFIR::Miscue( "NFIR lib: polyphase, incomplete source image" );
+  _sink = nullptr;
+}
+
+/**
+ * @param n target row
+ * @return first source row of its taps, may be outside the image
+ */
+int Polyphase::firstSourceIndex( int n ) const
+{
+  return ( n / _table->upFactor ) * _table->downFactor
+       + _table->first[n % _table->upFactor];
+}
+
+/**
+ * Vertical filter of the buffered rows; rows outside the image are
+ * replicated from the border rows.
+ *
+ * @param n target row
+ */
+void Polyphase::emitRow( int n )
+{
+  const int taps = _table->taps;
+  const float *w = &_table->weights[(size_t)( n % _table->upFactor ) * taps];
+  int first = firstSourceIndex( n );
+
+  std::fill( _accRow.begin(), _accRow.end(), 0.f );
+  for( int t=0; t<taps; t++ )
+  {
+    int srcRow = std::clamp( first + t, 0, _srcSize.height - 1 );
+    const float *src = _ring.ptr<float>( srcRow % taps );
+    for( int x=0; x<_tgtSize.width; x++ ) {
+      _accRow[x] += w[t] * src[x];
+    }
+  }
+  for( int x=0; x<_tgtSize.width; x++ ) {
+    _outRow[x] = cv::saturate_cast<uint8_t>( _accRow[x] );
+  }
+  _sink( n, _outRow.data() );
+}
+
+
+std::vector<std::string> Polyphase::to_s(void) const
+{
+  std::vector<std::string> v;
+  v.push_back("POLYPHASE configuration:");
+  v.push_back("  source sample rate:  " + std::to_string(get_srcSampleRate()) );
+  v.push_back("  target sample rate:  " + std::to_string(get_tgtSampleRate()) );
+  v.push_back("  resize factor:       " + std::to_string(get_resizeFactor()) );
+  v.push_back("  ratio L/M:           " + std::to_string(_table->upFactor)
+            + "/" + std::to_string(_table->downFactor) );
+  v.push_back("  phases x taps:       " + std::to_string(_table->upFactor)
+            + " x " + std::to_string(_table->taps) );
+  v.push_back("Interpolation: " + _configRecap );
+  v.push_back("  interpolation method:  " + std::to_string(get_interpolationMethod())
+            + "  (101=polyphase)\n" );
+  return v;
+}
+
+}   // End namespace
+
+
+/**
+ * @brief Modified Bessel function of the first kind, order zero.
+ *
+ * Power series; converges quickly for the window shapes used here.
+ */
+double besselI0( double x )
+{
+  double sum = 1.0, term = 1.0;
+  for( int k=1; k<50; k++ )
+  {
+    term *= ( x / ( 2.0 * k ) ) * ( x / ( 2.0 * k ) );
+    sum += term;
+    if( term < sum * 1e-12 )
+      break;
+  }
+  return sum;
+}
+
+/**
+ * @brief Kaiser-windowed sinc lowpass kernel.
+ *
+ * @param d distance in source pixels
+ * @param cutoff relative to the source Nyquist frequency, (0, 1]
+ * @param halfWidth window support, source pixels
+ *
+ * @return unnormalized weight
+ */
+double kaiserSinc( double d, double cutoff, double halfWidth )
+{
+  const double pi = 3.14159265358979323846;
+  double ratio = d / halfWidth;
+  if( std::abs( ratio ) >= 1.0 )
+    return 0.0;
+  double arg = pi * cutoff * d;
+  double sinc = ( std::abs( arg ) < 1e-9 ) ? 1.0 : std::sin( arg ) / arg;
+  double window = besselI0( kaiserBeta * std::sqrt( 1.0 - ratio * ratio ) )
+                / besselI0( kaiserBeta );
+  return cutoff * sinc * window;
+}
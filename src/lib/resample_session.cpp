@@ -0,0 +1,344 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+
+#include "filter_mask_cache.h"
+#include "filter_mask_gaussian.h"
+#include "filter_mask_ideal.h"
+#include "resample_down.h"
+#include "resample_polyphase.h"
+#include "resample_session.h"
+#include "resample_up.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+
+static cv::Size getPaddedSize( cv::Size, int );
+static cv::Size getTargetSize( cv::Size, double );
+static void validateUserSpecifiedSampleRates( int, int );
+
+
+namespace NFIR {
+
+/**
+ * Based on UP or DOWN sample, instantiate the proper object.  The polyphase
+ * resampler does both, without filter/mask; the filter type is ignored.
+ *
+ * For downsample, the filter/mask is built, or taken from the cache, for the
+ * padded source size, or for one tile with the tiled engine.  The filter
+ * engine is resolved here, for this image size, see
+ * Downsample::resolveFilterEngine().
+ *
+ * @param srcSampleRate value must reflect srUnits
+ * @param tgtSampleRate value must reflect srUnits
+ * @param interpolationMethod [ bilinear | bicubic | spectral (downsample only)
+ *                            | polyphase ]
+ * @param filterType [ ideal | Gaussian ]
+ * @param srcSize width and height of every source image
+ * @param options see NFIR::Options
+ *
+ * @throw NFIR::Miscue for invalid sample rate(s), image size, interpolation
+ *              method, downsample filter type, or filter/mask build failure
+ */
+Session::Session( int srcSampleRate, int tgtSampleRate,
+                  const std::string &interpolationMethod,
+                  const std::string &filterType,
+                  cv::Size srcSize, const Options &options )
+  : _srcSize( srcSize )
+{
+  validateUserSpecifiedSampleRates( srcSampleRate, tgtSampleRate );
+  if( ( srcSize.width <= 0 ) || ( srcSize.height <= 0 ) )
+    throw NFIR::Miscue( "NFIR lib: source image width and height must be positive" );
+  _pads.reset();
+
+  bool isPolyphase = ( interpolationMethod == "polyphase" );
+  if( ( tgtSampleRate > srcSampleRate ) || isPolyphase )
+  {
+    if( isPolyphase )
+      _resampler.reset( new Polyphase( srcSampleRate, tgtSampleRate ) );
+    else
+      _resampler.reset( new Upsample( srcSampleRate, tgtSampleRate ) );
+    _resampler->set_interpolationMethod( interpolationMethod );
+    _stage = isPolyphase ? "POLYPHASE" : "UPSAMPLE";
+    _tgtSize = getTargetSize( srcSize, _resampler->get_resizeFactor() );
+    _log = _resampler->to_s();
+    return;
+  }
+
+  _stage = "DOWNSAMPLE";
+  try
+  {
+    Downsample *downsampler = new Downsample( srcSampleRate, tgtSampleRate );
+    _resampler.reset( downsampler );
+    _tgtSize = getTargetSize( srcSize, downsampler->get_resizeFactor() );
+    downsampler->set_interpolationMethodAndFilterType( interpolationMethod,
+                                                       filterType );
+    downsampler->set_filterEngine( options.filterEngine );
+    downsampler->set_tiling( options.tileSize, options.memoryBudget );
+
+    // Padding depends on the interpolation method, see get_padMultiple().
+    // The filter/mask is defined on the padded size, or on one tile for the
+    // tiled engine.
+    cv::Size paddedSize = getPaddedSize( srcSize, downsampler->get_padMultiple() );
+    cv::Size maskSize = downsampler->get_maskSize( paddedSize );
+    if( downsampler->get_filterType() == "Gaussian" )
+      _filterMask.reset( new Gaussian( srcSampleRate, tgtSampleRate ) );
+    else if( downsampler->get_filterType() == "ideal" )
+      _filterMask.reset( new Ideal( srcSampleRate, tgtSampleRate ) );
+    else
+      throw NFIR::Miscue( "NFIR lib: invalid parameter filter type: '"
+                         + downsampler->get_filterType() + "'");
+
+    // Masks are reused across images of the same padded size and rates.
+    bool cacheHit = _filterMask->acquire( maskSize );
+    _log.push_back( std::string("FILTER MASK ")
+                   + ( cacheHit ? "cache hit" : "cache miss, built" ) );
+    _log.push_back( FilterMaskCache::instance().to_s() );
+
+    // The spatial and tiled engines filter the source image as is; no padding.
+    downsampler->resolveFilterEngine( srcSize, paddedSize, _filterMask.get() );
+    if( downsampler->get_filterEngine() == "fft" )
+    {
+      _pads.bottom = paddedSize.height - srcSize.height;
+      _pads.right = paddedSize.width - srcSize.width;
+    }
+    _log.push_back( _pads.to_s() );
+
+    _log.push_back( ">> START DOWNSAMPLE (resampler) metadata:" );
+    for( auto s : downsampler->to_s() ) { _log.push_back(s); }
+    _log.push_back( ">> END DOWNSAMPLE (resampler) metadata" );
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"NFIR lib: Downsample failed filter/mask: "};
+    err.append( ex.what() );
+    throw NFIR::Miscue( err );
+  }
+}
+
+Session::~Session() {}
+
+/**
+ * The source image is padded with white pixels into a buffer kept by the
+ * session if the fft engine is used.  The target is reused if it already
+ * has the target size.
+ *
+ * @param srcImg IN single-channel, 8-bit expected, session source size
+ * @param tgtImg OUT resampled image
+ *
+ * @throw NFIR::Miscue source image not of the session size or single-channel, or
+ *              cannot resize image
+ */
+void Session::run( const cv::Mat &srcImg, cv::Mat &tgtImg )
+{
+  if( srcImg.size() != _srcSize )
+    throw NFIR::Miscue( "NFIR lib: source image size "
+                        + std::to_string(srcImg.cols) + "x"
+                        + std::to_string(srcImg.rows)
+                        + " differs from session size "
+                        + std::to_string(_srcSize.width) + "x"
+                        + std::to_string(_srcSize.height) );
+  if( srcImg.channels() != 1 )
+    throw NFIR::Miscue( "NFIR lib: source image must be single-channel" );
+
+  try
+  {
+    if( !_filterMask )
+      _resampler->resizeInto( srcImg, tgtImg );
+    else if( ( _pads.bottom > 0 ) || ( _pads.right > 0 ) )
+    {
+      cv::copyMakeBorder( srcImg, _paddedImage, 0, _pads.bottom, 0, _pads.right,
+                          cv::BORDER_CONSTANT, cv::Scalar::all(255) );
+      _resampler->resizeInto( _paddedImage, tgtImg, _filterMask.get(), _pads );
+    }
+    else
+      _resampler->resizeInto( srcImg, tgtImg, _filterMask.get(), _pads );
+  }
+  catch( const cv::Exception& ex ) {
+    std::string err{"NFIR lib: " + _stage + " failed resize(): "};
+    err.append( ex.what() );
+    throw NFIR::Miscue( err );
+  }
+
+  if( tgtImg.empty() )
+    throw NFIR::Miscue( "NFIR lib: " + _stage + " failed resize(), target image empty" );
+}
+
+/** @return width and height */
+cv::Size Session::get_srcSize(void) const
+{
+  return _srcSize;
+}
+
+/** @return width and height */
+cv::Size Session::get_tgtSize(void) const
+{
+  return _tgtSize;
+}
+
+/** @return stage label */
+std::string Session::get_stage(void) const
+{
+  return _stage;
+}
+
+/** @return `fft`, `tiled`, `spatial`, or empty */
+std::string Session::get_filterEngine(void) const
+{
+  if( !_filterMask )
+    return "";
+  return static_cast<const Downsample*>( _resampler.get() )->get_filterEngine();
+}
+
+/** @return filtered image of the last run(), or empty */
+cv::Mat Session::get_filteredImage(void) const
+{
+  if( !_filterMask )
+    return cv::Mat{};
+  return static_cast<const Downsample*>( _resampler.get() )->get_filteredImage();
+}
+
+/** @return log lines of the constructor */
+std::vector<std::string> Session::to_s(void) const
+{
+  return _log;
+}
+
+/**
+ * Downsample is dominated by the forward and inverse DFT of the padded
+ * image, O(N log N) in its pixel count; up-sample by the interpolation,
+ * linear in the target pixel count.  Only the ratio between images is
+ * meaningful, eg, to order a batch.
+ *
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ * @param srcSize source image size
+ *
+ * @return relative cost, 0 for an empty image
+ */
+double Session::estimateCost( int srcSampleRate, int tgtSampleRate,
+                              cv::Size srcSize )
+{
+  if( srcSize.area() <= 0 )
+    return 0.0;
+  double resizeFactor = (double)tgtSampleRate / (double)srcSampleRate;
+  double tgtPixels = (double)getTargetSize( srcSize, resizeFactor ).area();
+  if( tgtSampleRate >= srcSampleRate )
+    return tgtPixels;
+
+  double paddedPixels = (double)getPaddedSize( srcSize, 2 ).area();
+  return paddedPixels * std::log2( paddedPixels ) + tgtPixels;
+}
+
+}   // End namespace
+
+
+/**
+ * @brief Padded size per the OpenCV optimal DFT size.
+ *
+ * If either (or both) of the optimal rows or columns are odd, one row or column
+ * is added to the padding. This must be done to ensure that the ideal filter/mask
+ * rightmost column and bottommost row contain all zeros.
+ *
+ * When a multiple other than 2 is required (spectral decimation), the next
+ * optimal size that is a multiple is used.  Should the multiple have a prime
+ * factor other than 2, 3, or 5, no optimal size is a multiple; the padded size
+ * is then just rounded up to the multiple.
+ *
+ * @param size of image to pad
+ * @param multiple padded rows and columns are a multiple of this value
+ *
+ * @return the padded size
+ */
+cv::Size getPaddedSize( cv::Size size, int multiple )
+{
+  int optimalRows = cv::getOptimalDFTSize( size.height );
+  if (optimalRows % 2)  // odd
+    optimalRows++;
+  int optimalCols = cv::getOptimalDFTSize( size.width );
+  if (optimalCols % 2)  // odd
+    optimalCols++;
+
+  if( multiple > 2 )
+  {
+    int factors = multiple;
+    for( int p : { 2, 3, 5 } ) {
+      while( factors % p == 0 ) { factors /= p; }
+    }
+    if( factors == 1 ) {
+      while( optimalRows % multiple )
+        optimalRows = cv::getOptimalDFTSize( optimalRows + 1 );
+      while( optimalCols % multiple )
+        optimalCols = cv::getOptimalDFTSize( optimalCols + 1 );
+    }
+    else {
+      optimalRows = ( ( size.height + multiple - 1 ) / multiple ) * multiple;
+      optimalCols = ( ( size.width + multiple - 1 ) / multiple ) * multiple;
+    }
+  }
+  return cv::Size( optimalCols, optimalRows );
+}
+
+/**
+ * @brief Target size as computed by `cv::resize( ..., cv::Size(0, 0), fx, fy )`.
+ *
+ * All resamplers produce this size; for spectral decimation and polyphase
+ * see Downsample::resize() and Polyphase::get_targetSize().
+ *
+ * @param srcSize source image
+ * @param resizeFactor target / source rate
+ *
+ * @return target image size
+ */
+cv::Size getTargetSize( cv::Size srcSize, double resizeFactor )
+{
+  return cv::Size( cvRound( srcSize.width * resizeFactor ),
+                   cvRound( srcSize.height * resizeFactor ) );
+}
+
+/**
+ * @brief Validate the sample rates not handled by CLI11.
+ *
+ * Rates cannot be equal to each other or less than zero.
+ *
+ * @param srcSampleRate source image
+ * @param tgtSampleRate target image
+ *
+ * @throw NFIR::Miscue send appropriate message
+ */
+void validateUserSpecifiedSampleRates( int srcSampleRate, int tgtSampleRate )
+{
+  if( tgtSampleRate == srcSampleRate )
+  {
+    throw NFIR::Miscue( "NFIR lib: source and target sample rates cannot be equal" );
+  }
+
+  if( (srcSampleRate <= 0 ) || ( tgtSampleRate <= 0 ) )
+  {
+    throw NFIR::Miscue( "NFIR lib: src and/or target sample rate cannot be negative" );
+  }
+}
@@ -70,12 +70,23 @@ Upsample::Upsample( int srcSampleRate, int tgtSampleRate )
 cv::Mat Upsample::resize( cv::Mat srcImg )
 {
   cv::Mat resampledImg;
-  cv::resize( srcImg, resampledImg, cv::Size(),
-              _resizeFactor, _resizeFactor, _interpolationMethod );
+  resizeInto( srcImg, resampledImg );
   // resampledImg.release();  // Force test NFIR::Miscue
   return resampledImg;
 }
 
+/** Same as resize(), the target buffer is reused if already allocated at
+ * the target size.
+ *
+ * @param srcImg to be resized by the amount of the `resizeFactor`
+ * @param tgtImg OUT target resized image
+ */
+void Upsample::resizeInto( cv::Mat srcImg, cv::Mat &tgtImg )
+{
+  cv::resize( srcImg, tgtImg, cv::Size(),
+              _resizeFactor, _resizeFactor, _interpolationMethod );
+}
+
 
 /** Wrapper for the OpenCV `resize` function.
  *   NOT TO BE CALLED; overridden to satisfy linker.
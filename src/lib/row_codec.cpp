@@ -0,0 +1,475 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "exceptions.h"
+#include "raw_image.h"
+#include "row_codec.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#ifdef USE_LIBPNG
+  #include <png.h>
+#endif
+
+#include <climits>
+#include <cstring>
+
+#ifdef USE_LIBPNG
+/** Library private methods declarations */
+static void readPngData( png_structp, png_bytep, png_size_t );
+static void writePngData( png_structp, png_bytep, png_size_t );
+static void flushPngData( png_structp );
+static void pngError( png_structp, png_const_charp );
+static void pngWarning( png_structp, png_const_charp );
+#endif
+
+
+namespace NFIR {
+
+#ifdef USE_LIBPNG
+/**
+ * @brief libpng reader of an encoded PNG in memory.
+ *
+ * libpng reports errors by longjmp() to the setjmp() of the calling
+ * method, its message in `_error`; those methods construct no C++ objects
+ * after the setjmp().
+ */
+class PngRowReader : public RowReader
+{
+public:
+  /** @brief Bytes of the encoded image not yet handed to libpng */
+  struct Source
+  {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+  };
+
+  PngRowReader( const uint8_t *encoded, size_t encodedSize )
+    : _source{ encoded, encodedSize, 0 }
+  {
+    _png = png_create_read_struct( PNG_LIBPNG_VER_STRING, &_error, pngError, pngWarning );
+    if( _png != nullptr )
+      _info = png_create_info_struct( _png );
+    if( _info == nullptr )
+      throw NFIR::Miscue( "NFIR lib: stream: cannot create PNG reader" );
+  }
+
+  ~PngRowReader()
+  {
+    png_destroy_read_struct( &_png, &_info, nullptr );
+  }
+
+  /** @return false if not 8-bit grayscale, non-interlaced */
+  bool readHeader(void)
+  {
+    if( setjmp( png_jmpbuf( _png ) ) )
+      throw NFIR::Miscue( "NFIR lib: stream: invalid PNG header: " + _error );
+    png_set_read_fn( _png, &_source, readPngData );
+    png_read_info( _png, _info );
+
+    if( ( png_get_color_type( _png, _info ) != PNG_COLOR_TYPE_GRAY )
+        || ( png_get_bit_depth( _png, _info ) != 8 )
+        || ( png_get_interlace_type( _png, _info ) != PNG_INTERLACE_NONE )
+        || ( png_get_image_width( _png, _info ) > (png_uint_32)INT_MAX )
+        || ( png_get_image_height( _png, _info ) > (png_uint_32)INT_MAX ) )
+      return false;
+    _size = cv::Size( (int)png_get_image_width( _png, _info ),
+                      (int)png_get_image_height( _png, _info ) );
+    return true;
+  }
+
+  void read( cv::Mat &band ) override
+  {
+    if( ( band.type() != CV_8UC1 ) || ( band.cols != _size.width )
+        || ( _rowsRead + band.rows > _size.height ) )
+      throw NFIR::Miscue( "NFIR lib: stream: band does not fit the PNG image" );
+    if( setjmp( png_jmpbuf( _png ) ) )
+      throw NFIR::Miscue( "NFIR lib: stream: corrupt PNG image data: " + _error );
+    for( int y = 0; y < band.rows; y++ )
+      png_read_row( _png, band.ptr<png_byte>( y ), nullptr );
+    _rowsRead += band.rows;
+  }
+
+  std::string get_format(void) const override { return "png"; }
+
+private:
+  png_structp _png{nullptr};
+  png_infop _info{nullptr};
+  Source _source;
+  std::string _error;
+};
+
+#endif
+
+/**
+ * @brief Reader of a binary PGM in memory; rows are copied out as is.
+ */
+class PgmRowReader : public RowReader
+{
+public:
+  PgmRowReader( const uint8_t *encoded, size_t encodedSize )
+    : _data{encoded}, _dataSize{encodedSize} {}
+
+  /** @return false if not `P5` with maxval up to 255 */
+  bool readHeader(void)
+  {
+    PgmHeader header;
+    if( !readPgmHeader( _data, _dataSize, header )
+        || ( header.maxval == 0 ) || ( header.maxval > 255 ) )
+      return false;
+    _pixels = header.pixelOffset;
+    _size = cv::Size( (int)header.width, (int)header.height );
+    if( _dataSize - _pixels < (size_t)_size.width * _size.height )
+      throw NFIR::Miscue( "NFIR lib: stream: truncated PGM image" );
+    return true;
+  }
+
+  void read( cv::Mat &band ) override
+  {
+    if( ( band.type() != CV_8UC1 ) || ( band.cols != _size.width )
+        || ( _rowsRead + band.rows > _size.height ) )
+      throw NFIR::Miscue( "NFIR lib: stream: band does not fit the PGM image" );
+    for( int y = 0; y < band.rows; y++ )
+    {
+      const uint8_t *row = _data + _pixels + (size_t)( _rowsRead + y ) * _size.width;
+      std::memcpy( band.ptr<uint8_t>( y ), row, _size.width );
+    }
+    _rowsRead += band.rows;
+  }
+
+  std::string get_format(void) const override { return "pgm"; }
+
+private:
+  const uint8_t *_data;
+  size_t _dataSize;
+  /** @brief Offset of the first pixel */
+  size_t _pixels{0};
+};
+
+#ifdef USE_LIBPNG
+/**
+ * @brief libpng writer into a growing vector; see PngRowReader on errors.
+ */
+class PngRowWriter : public RowWriter
+{
+public:
+  PngRowWriter( std::vector<uint8_t> &encoded ) : _encoded{encoded}
+  {
+    _png = png_create_write_struct( PNG_LIBPNG_VER_STRING, &_error, pngError, pngWarning );
+    if( _png != nullptr )
+      _info = png_create_info_struct( _png );
+    if( _info == nullptr )
+      throw NFIR::Miscue( "NFIR lib: stream: cannot create PNG writer" );
+  }
+
+  ~PngRowWriter()
+  {
+    png_destroy_write_struct( &_png, &_info );
+  }
+
+  /**
+   * @param size image
+   * @param metadata null for none
+   * @param level zlib level
+   * @param strategy zlib strategy, same values as IMWRITE_PNG_STRATEGY
+   *
+   * @throw NFIR::Miscue invalid text chunk, or libpng error
+   */
+  void writeHeader( cv::Size size, const ImageMetadata *metadata,
+                    int level, int strategy )
+  {
+    // libpng keeps pointers to the keywords and texts, held by the writer.
+    std::vector<png_text> text;
+    if( metadata != nullptr )
+    {
+      for( const auto &s : metadata->textChunks )
+      {
+        size_t colon = s.find( ':' );
+        if( ( colon == std::string::npos ) || ( colon == 0 ) || ( colon > 79 ) )
+          throw NFIR::Miscue( "NFIR lib: metadata: text chunk not 'keyword:text': '"
+                              + s + "'" );
+        _keywords.push_back( s.substr( 0, colon ) );
+        _texts.push_back( s.substr( colon + 1 ) );
+      }
+      for( size_t i = 0; i < _keywords.size(); i++ )
+      {
+        png_text t;
+        std::memset( &t, 0, sizeof(t) );
+        t.compression = PNG_TEXT_COMPRESSION_NONE;
+        t.key = const_cast<char*>( _keywords[i].c_str() );
+        t.text = const_cast<char*>( _texts[i].c_str() );
+        t.text_length = _texts[i].size();
+        text.push_back( t );
+      }
+    }
+
+    if( setjmp( png_jmpbuf( _png ) ) )
+      throw NFIR::Miscue( "NFIR lib: stream: cannot write PNG header: " + _error );
+    png_set_write_fn( _png, &_encoded, writePngData, flushPngData );
+    png_set_filter( _png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB );
+    png_set_compression_level( _png, level );
+    png_set_compression_strategy( _png, strategy );
+    png_set_IHDR( _png, _info, size.width, size.height, 8, PNG_COLOR_TYPE_GRAY,
+                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                  PNG_FILTER_TYPE_DEFAULT );
+    if( metadata != nullptr )
+    {
+      bool meter = ( metadata->srUnits == "inch" ) || ( metadata->srUnits == "meter" );
+      png_set_pHYs( _png, _info, metadata->get_pixelsPerUnit(),
+                    metadata->get_pixelsPerUnit(),
+                    meter ? PNG_RESOLUTION_METER : PNG_RESOLUTION_UNKNOWN );
+      if( !text.empty() )
+        png_set_text( _png, _info, text.data(), (int)text.size() );
+    }
+    png_write_info( _png, _info );
+    _size = size;
+  }
+
+  void write( const cv::Mat &band ) override
+  {
+    if( ( band.type() != CV_8UC1 ) || ( band.cols != _size.width )
+        || ( _rowsWritten + band.rows > _size.height ) )
+      throw NFIR::Miscue( "NFIR lib: stream: band does not fit the PNG image" );
+    if( setjmp( png_jmpbuf( _png ) ) )
+      throw NFIR::Miscue( "NFIR lib: stream: cannot write PNG rows: " + _error );
+    for( int y = 0; y < band.rows; y++ )
+      png_write_row( _png, const_cast<png_bytep>( band.ptr<png_byte>( y ) ) );
+    _rowsWritten += band.rows;
+  }
+
+  void finish(void) override
+  {
+    if( _rowsWritten != _size.height )
+      throw NFIR::Miscue( "NFIR lib: stream: PNG image incomplete" );
+    if( setjmp( png_jmpbuf( _png ) ) )
+      throw NFIR::Miscue( "NFIR lib: stream: cannot complete PNG image: " + _error );
+    png_write_end( _png, nullptr );
+  }
+
+private:
+  std::vector<uint8_t> &_encoded;
+  std::string _error;
+  png_structp _png{nullptr};
+  png_infop _info{nullptr};
+  cv::Size _size;
+  int _rowsWritten{0};
+  std::vector<std::string> _keywords;
+  std::vector<std::string> _texts;
+};
+
+#endif
+
+/**
+ * @brief Writer of a binary PGM, or of raw pixels without the header; rows
+ * are appended as is.
+ */
+class PgmRowWriter : public RowWriter
+{
+public:
+  PgmRowWriter( std::vector<uint8_t> &encoded, cv::Size size, bool withHeader )
+    : _encoded{encoded}, _size{size}
+  {
+    std::string header = withHeader ? writePgmHeader( size.width, size.height )
+                                    : std::string{};
+    _encoded.assign( header.begin(), header.end() );
+    _encoded.reserve( header.size() + (size_t)size.area() );
+  }
+
+  void write( const cv::Mat &band ) override
+  {
+    if( ( band.type() != CV_8UC1 ) || ( band.cols != _size.width )
+        || ( _rowsWritten + band.rows > _size.height ) )
+      throw NFIR::Miscue( "NFIR lib: stream: band does not fit the PGM image" );
+    for( int y = 0; y < band.rows; y++ )
+      _encoded.insert( _encoded.end(), band.ptr<uint8_t>( y ),
+                       band.ptr<uint8_t>( y ) + band.cols );
+    _rowsWritten += band.rows;
+  }
+
+  void finish(void) override
+  {
+    if( _rowsWritten != _size.height )
+      throw NFIR::Miscue( "NFIR lib: stream: PGM image incomplete" );
+  }
+
+private:
+  std::vector<uint8_t> &_encoded;
+  cv::Size _size;
+  int _rowsWritten{0};
+};
+
+
+/**
+ * @param encoded IN encoded image, must outlive the reader
+ * @param encodedSize bytes
+ *
+ * @return reader positioned at the first row; null if the format or pixel
+ *         type is not supported
+ *
+ * @throw NFIR::Miscue invalid or truncated header
+ */
+std::unique_ptr<RowReader>
+RowReader::open( const uint8_t *encoded, size_t encodedSize )
+{
+  static const uint8_t pngSignature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  if( ( encodedSize >= 8 ) && ( std::memcmp( encoded, pngSignature, 8 ) == 0 ) )
+  {
+#ifdef USE_LIBPNG
+    std::unique_ptr<PngRowReader> reader( new PngRowReader( encoded, encodedSize ) );
+    if( reader->readHeader() )
+      return reader;
+#endif
+    return nullptr;
+  }
+
+  std::unique_ptr<PgmRowReader> reader( new PgmRowReader( encoded, encodedSize ) );
+  if( reader->readHeader() )
+    return reader;
+  return nullptr;
+}
+
+/**
+ * @param compression `png`, `pgm`, or `raw`
+ * @return true for `pgm` and `raw`, and for `png` in a build with libpng
+ */
+bool
+RowWriter::supports( const std::string &compression )
+{
+  if( ( compression == "pgm" ) || ( compression == "raw" ) )
+    return true;
+#ifdef USE_LIBPNG
+  return compression == "png";
+#else
+  return false;
+#endif
+}
+
+/**
+ * PNG settings follow the rules of `cv::imencode()`: level 1 (best speed)
+ * and RLE strategy by default; a level given resets the strategy to the
+ * zlib default, unless a strategy is given after it.  The SUB row filter
+ * is always used, as `cv::imencode()` forces it, so that the streamed and
+ * the whole-image encodes are alike.
+ *
+ * @param compression `png`, `pgm`, or `raw`
+ * @param size target image
+ * @param metadata PNG: pHYs and tEXt; null for none
+ * @param encodeParams PNG: `cv::imencode()` style IMWRITE_PNG_COMPRESSION
+ *                     and IMWRITE_PNG_STRATEGY pairs
+ * @param encoded OUT receives the encoded image; must outlive the writer
+ *
+ * @return writer; null for other compression formats, see supports()
+ *
+ * @throw NFIR::Miscue invalid text chunk
+ */
+std::unique_ptr<RowWriter>
+RowWriter::create( const std::string &compression, cv::Size size,
+                   const ImageMetadata *metadata,
+                   const std::vector<int> &encodeParams,
+                   std::vector<uint8_t> &encoded )
+{
+  if( ( compression == "pgm" ) || ( compression == "raw" ) )
+    return std::unique_ptr<RowWriter>(
+      new PgmRowWriter( encoded, size, compression == "pgm" ) );
+  if( !supports( compression ) )
+    return nullptr;
+
+#ifdef USE_LIBPNG
+  int level{1};
+  int strategy{ cv::IMWRITE_PNG_STRATEGY_RLE };
+  for( size_t i = 0; i + 1 < encodeParams.size(); i += 2 )
+  {
+    if( encodeParams[i] == cv::IMWRITE_PNG_COMPRESSION )
+    {
+      level = encodeParams[i+1];
+      strategy = cv::IMWRITE_PNG_STRATEGY_DEFAULT;
+    }
+    else if( encodeParams[i] == cv::IMWRITE_PNG_STRATEGY )
+      strategy = encodeParams[i+1];
+  }
+
+  encoded.clear();
+  std::unique_ptr<PngRowWriter> writer( new PngRowWriter( encoded ) );
+  writer->writeHeader( size, metadata, level, strategy );
+  return writer;
+#else
+  (void)metadata;
+  (void)encodeParams;
+  return nullptr;
+#endif
+}
+
+}   // End namespace
+
+
+#ifdef USE_LIBPNG
+/**
+ * @brief libpng read callback: copy the next bytes of the encoded image.
+ */
+void readPngData( png_structp png, png_bytep out, png_size_t length )
+{
+  auto *source = static_cast<NFIR::PngRowReader::Source*>( png_get_io_ptr( png ) );
+  if( source->pos + length > source->size )
+    png_error( png, "truncated PNG image" );
+  std::memcpy( out, source->data + source->pos, length );
+  source->pos += length;
+}
+
+/**
+ * @brief libpng write callback: append to the encoded image.
+ */
+void writePngData( png_structp png, png_bytep data, png_size_t length )
+{
+  auto *encoded = static_cast<std::vector<uint8_t>*>( png_get_io_ptr( png ) );
+  encoded->insert( encoded->end(), data, data + length );
+}
+
+/**
+ * @brief libpng flush callback; nothing is buffered.
+ */
+void flushPngData( png_structp )
+{
+}
+
+/**
+ * @brief libpng error callback: keep the message for the exception, and
+ *        return to the setjmp() of the reader or writer.
+ */
+void pngError( png_structp png, png_const_charp message )
+{
+  *static_cast<std::string*>( png_get_error_ptr( png ) ) = message;
+  png_longjmp( png, 1 );
+}
+
+/**
+ * @brief libpng warning callback; warnings are not errors, and ignored.
+ */
+void pngWarning( png_structp, png_const_charp )
+{
+}
+#endif
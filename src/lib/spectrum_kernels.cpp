@@ -0,0 +1,283 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "spectrum_kernels.h"
+
+#include <opencv2/core/core.hpp>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+  #define NFIR_SIMD_DISPATCH
+  #include <immintrin.h>
+  #define NFIR_TARGET(isa) __attribute__((target(isa)))
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define NFIR_SIMD_SSE2
+  #include <emmintrin.h>
+  #define NFIR_TARGET(isa)
+#endif
+
+/** @brief One set of kernels per instruction set */
+struct Kernels
+{
+  void (*multiplyAffine)( float*, const float*, float, float, int );
+  void (*scale)( float*, float, int );
+  void (*storeSaturated)( const float*, uint8_t*, int );
+  const char *isa;
+};
+
+static const Kernels& kernels(void);
+static Kernels selectKernels(void);
+
+
+namespace NFIR {
+namespace SpectrumKernels {
+
+/**
+ * @param row IN/OUT
+ * @param profile same length as row
+ * @param a profile gain
+ * @param b offset
+ * @param n length
+ */
+void multiplyAffine( float *row, const float *profile, float a, float b, int n )
+{
+  kernels().multiplyAffine( row, profile, a, b, n );
+}
+
+/**
+ * @param row IN/OUT
+ * @param s factor
+ * @param n length
+ */
+void scale( float *row, float s, int n )
+{
+  kernels().scale( row, s, n );
+}
+
+/**
+ * Rounding is to nearest, ties to even, as `cv::saturate_cast<uchar>`.
+ *
+ * @param src float row
+ * @param dst OUT 8-bit row
+ * @param n length
+ */
+void storeSaturated( const float *src, uint8_t *dst, int n )
+{
+  kernels().storeSaturated( src, dst, n );
+}
+
+/** @return "AVX-512", "AVX2", "SSE2", or "scalar" */
+std::string get_isa(void)
+{
+  return kernels().isa;
+}
+
+}   // End namespace SpectrumKernels
+}   // End namespace
+
+
+// ---- Scalar, also the tail of the vector loops. ----
+
+static void multiplyAffineScalar( float *row, const float *profile, float a, float b, int n )
+{
+  for( int j=0; j<n; j++ ) {
+    row[j] *= a * profile[j] + b;
+  }
+}
+
+static void scaleScalar( float *row, float s, int n )
+{
+  for( int j=0; j<n; j++ ) {
+    row[j] *= s;
+  }
+}
+
+static void storeSaturatedScalar( const float *src, uint8_t *dst, int n )
+{
+  for( int j=0; j<n; j++ ) {
+    dst[j] = cv::saturate_cast<uint8_t>( src[j] );
+  }
+}
+
+
+#if defined(NFIR_SIMD_DISPATCH) || defined(NFIR_SIMD_SSE2)
+
+// ---- SSE2, 4 floats. ----
+
+NFIR_TARGET("sse2")
+static void multiplyAffineSSE2( float *row, const float *profile, float a, float b, int n )
+{
+  const __m128 va = _mm_set1_ps( a ), vb = _mm_set1_ps( b );
+  int j=0;
+  for( ; j+4<=n; j+=4 ) {
+    __m128 gain = _mm_add_ps( _mm_mul_ps( va, _mm_loadu_ps( profile+j ) ), vb );
+    _mm_storeu_ps( row+j, _mm_mul_ps( _mm_loadu_ps( row+j ), gain ) );
+  }
+  multiplyAffineScalar( row+j, profile+j, a, b, n-j );
+}
+
+NFIR_TARGET("sse2")
+static void scaleSSE2( float *row, float s, int n )
+{
+  const __m128 vs = _mm_set1_ps( s );
+  int j=0;
+  for( ; j+4<=n; j+=4 ) {
+    _mm_storeu_ps( row+j, _mm_mul_ps( _mm_loadu_ps( row+j ), vs ) );
+  }
+  scaleScalar( row+j, s, n-j );
+}
+
+// Clamp first so that out-of-range values saturate like saturate_cast.
+NFIR_TARGET("sse2")
+static void storeSaturatedSSE2( const float *src, uint8_t *dst, int n )
+{
+  const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps( 255.f );
+  int j=0;
+  for( ; j+16<=n; j+=16 ) {
+    __m128i a = _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( _mm_loadu_ps( src+j ), lo ), hi ) );
+    __m128i b = _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( _mm_loadu_ps( src+j+4 ), lo ), hi ) );
+    __m128i c = _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( _mm_loadu_ps( src+j+8 ), lo ), hi ) );
+    __m128i d = _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( _mm_loadu_ps( src+j+12 ), lo ), hi ) );
+    __m128i bytes = _mm_packus_epi16( _mm_packs_epi32( a, b ), _mm_packs_epi32( c, d ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dst+j ), bytes );
+  }
+  storeSaturatedScalar( src+j, dst+j, n-j );
+}
+
+#endif
+
+#ifdef NFIR_SIMD_DISPATCH
+
+// ---- AVX2, 8 floats. ----
+
+NFIR_TARGET("avx2")
+static void multiplyAffineAVX2( float *row, const float *profile, float a, float b, int n )
+{
+  const __m256 va = _mm256_set1_ps( a ), vb = _mm256_set1_ps( b );
+  int j=0;
+  for( ; j+8<=n; j+=8 ) {
+    __m256 gain = _mm256_add_ps( _mm256_mul_ps( va, _mm256_loadu_ps( profile+j ) ), vb );
+    _mm256_storeu_ps( row+j, _mm256_mul_ps( _mm256_loadu_ps( row+j ), gain ) );
+  }
+  multiplyAffineScalar( row+j, profile+j, a, b, n-j );
+}
+
+NFIR_TARGET("avx2")
+static void scaleAVX2( float *row, float s, int n )
+{
+  const __m256 vs = _mm256_set1_ps( s );
+  int j=0;
+  for( ; j+8<=n; j+=8 ) {
+    _mm256_storeu_ps( row+j, _mm256_mul_ps( _mm256_loadu_ps( row+j ), vs ) );
+  }
+  scaleScalar( row+j, s, n-j );
+}
+
+// The packs work per 128-bit lane; the permute restores the order of the
+// four 8-float groups.
+NFIR_TARGET("avx2")
+static void storeSaturatedAVX2( const float *src, uint8_t *dst, int n )
+{
+  const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps( 255.f );
+  const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+  int j=0;
+  for( ; j+32<=n; j+=32 ) {
+    __m256i a = _mm256_cvtps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( src+j ), lo ), hi ) );
+    __m256i b = _mm256_cvtps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( src+j+8 ), lo ), hi ) );
+    __m256i c = _mm256_cvtps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( src+j+16 ), lo ), hi ) );
+    __m256i d = _mm256_cvtps_epi32( _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( src+j+24 ), lo ), hi ) );
+    __m256i bytes = _mm256_packus_epi16( _mm256_packs_epi32( a, b ), _mm256_packs_epi32( c, d ) );
+    bytes = _mm256_permutevar8x32_epi32( bytes, order );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dst+j ), bytes );
+  }
+  storeSaturatedScalar( src+j, dst+j, n-j );
+}
+
+// ---- AVX-512, 16 floats. ----
+
+NFIR_TARGET("avx512f")
+static void multiplyAffineAVX512( float *row, const float *profile, float a, float b, int n )
+{
+  const __m512 va = _mm512_set1_ps( a ), vb = _mm512_set1_ps( b );
+  int j=0;
+  for( ; j+16<=n; j+=16 ) {
+    __m512 gain = _mm512_add_ps( _mm512_mul_ps( va, _mm512_loadu_ps( profile+j ) ), vb );
+    _mm512_storeu_ps( row+j, _mm512_mul_ps( _mm512_loadu_ps( row+j ), gain ) );
+  }
+  multiplyAffineScalar( row+j, profile+j, a, b, n-j );
+}
+
+NFIR_TARGET("avx512f")
+static void scaleAVX512( float *row, float s, int n )
+{
+  const __m512 vs = _mm512_set1_ps( s );
+  int j=0;
+  for( ; j+16<=n; j+=16 ) {
+    _mm512_storeu_ps( row+j, _mm512_mul_ps( _mm512_loadu_ps( row+j ), vs ) );
+  }
+  scaleScalar( row+j, s, n-j );
+}
+
+NFIR_TARGET("avx512f")
+static void storeSaturatedAVX512( const float *src, uint8_t *dst, int n )
+{
+  const __m512 lo = _mm512_setzero_ps(), hi = _mm512_set1_ps( 255.f );
+  int j=0;
+  for( ; j+16<=n; j+=16 ) {
+    __m512i a = _mm512_cvtps_epi32( _mm512_min_ps( _mm512_max_ps( _mm512_loadu_ps( src+j ), lo ), hi ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dst+j ), _mm512_cvtusepi32_epi8( a ) );
+  }
+  storeSaturatedScalar( src+j, dst+j, n-j );
+}
+
+#endif
+
+
+/** @return kernels for this CPU, selected on first use */
+const Kernels& kernels(void)
+{
+  static const Kernels selected = selectKernels();
+  return selected;
+}
+
+/** @return best kernels the CPU supports */
+Kernels selectKernels(void)
+{
+  #ifdef NFIR_SIMD_DISPATCH
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx512f" ) )
+    return { multiplyAffineAVX512, scaleAVX512, storeSaturatedAVX512, "AVX-512" };
+  if( __builtin_cpu_supports( "avx2" ) )
+    return { multiplyAffineAVX2, scaleAVX2, storeSaturatedAVX2, "AVX2" };
+  if( __builtin_cpu_supports( "sse2" ) )
+    return { multiplyAffineSSE2, scaleSSE2, storeSaturatedSSE2, "SSE2" };
+  return { multiplyAffineScalar, scaleScalar, storeSaturatedScalar, "scalar" };
+  #elif defined(NFIR_SIMD_SSE2)
+  return { multiplyAffineSSE2, scaleSSE2, storeSaturatedSSE2, "SSE2" };
+  #else
+  return { multiplyAffineScalar, scaleScalar, storeSaturatedScalar, "scalar" };
+  #endif
+}
@@ -0,0 +1,482 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "exceptions.h"
+#include "target_writer.h"
+
+#ifdef _WIN32_64
+  #include <windows.h>
+  #include <cstdio>
+  #include <fstream>
+#else
+  #include <cerrno>
+  #include <cstring>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+#include <set>
+
+/** Library private methods declarations */
+#ifndef _WIN32_64
+static std::string parentDirectory( const std::string & );
+static bool writeAll( int, const uint8_t *, size_t );
+static bool syncPath( const std::string &, int );
+#endif
+
+
+namespace NFIR {
+
+/**
+ * Unsubmitted, or its write failed: the file is removed, so that no
+ * partly written target is left.
+ */
+MappedTarget::~MappedTarget()
+{
+#ifndef _WIN32_64
+  unmap();
+  if( _fd >= 0 )
+    close( _fd );
+  if( !_written && !_writePath.empty() )
+    unlink( _writePath.c_str() );
+#endif
+}
+
+/** @return null once submitted */
+uint8_t*
+MappedTarget::data(void) const
+{
+  return _data;
+}
+
+/** @return bytes */
+size_t
+MappedTarget::size(void) const
+{
+  return _size;
+}
+
+/** @return false on error, errno set */
+bool
+MappedTarget::unmap(void)
+{
+#ifndef _WIN32_64
+  if( !_data )
+    return true;
+  int error = munmap( _data, _size );
+  _data = nullptr;
+  return error == 0;
+#else
+  return true;
+#endif
+}
+
+/**
+ * @param options see NFIR::TargetWriterOptions
+ *
+ * @throw NFIR::Miscue invalid fsync policy
+ */
+TargetWriter::TargetWriter( const TargetWriterOptions &options )
+  : _options{options}, _queue{options.queueDepth}
+{
+  if( ( _options.fsync != "none" ) && ( _options.fsync != "file" )
+      && ( _options.fsync != "batch" ) )
+    throw NFIR::Miscue( "NFIR lib: invalid fsync policy: '" + _options.fsync
+                        + "', must be none, file, or batch" );
+
+  for( size_t i = 0; i < _options.threads; i++ )
+    _threads.emplace_back( &TargetWriter::writeStage, this );
+}
+
+TargetWriter::~TargetWriter()
+{
+  try {
+    finish();
+  }
+  catch( ... ) {}
+}
+
+/**
+ * The buffer is moved from, not copied.  Without write threads the file is
+ * written, and the Completion called, before submit() returns.
+ *
+ * @param path of the file, created or replaced
+ * @param data IN encoded image; moved from
+ * @param completion called once written or failed; must not throw
+ *
+ * @throw NFIR::Miscue called after finish()
+ */
+void
+TargetWriter::submit( const std::string &path, std::vector<uint8_t> &&data,
+                      const Completion &completion )
+{
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( _finished )
+      throw NFIR::Miscue( "NFIR lib: target writer already finished" );
+  }
+
+  std::unique_ptr<Task> task( new Task );
+  task->path = path;
+  task->data = std::move( data );
+  task->completion = completion;
+  enqueue( std::move( task ) );
+}
+
+/**
+ * The disk blocks are allocated here, so that a full disk fails the call
+ * rather than raising SIGBUS on a store into a sparse mapping.  With
+ * `atomicRename` the file mapped is `<path>.tmp`.  Windows: not mapped.
+ *
+ * @param path of the file, created or replaced
+ * @param size bytes of the file
+ *
+ * @return mapping, its bytes unset; null if the file cannot be created,
+ *         allocated, or mapped, for the caller to submit() a buffer instead
+ */
+std::shared_ptr<MappedTarget>
+TargetWriter::map( const std::string &path, size_t size ) const
+{
+#ifdef _WIN32_64
+  return nullptr;
+#else
+  if( size == 0 )
+    return nullptr;
+  const std::string writePath = _options.atomicRename ? path + ".tmp" : path;
+  int fd = open( writePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+  if( fd < 0 )
+    return nullptr;
+
+  std::shared_ptr<MappedTarget> target( new MappedTarget );
+  target->_path = path;
+  target->_writePath = writePath;
+  target->_fd = fd;
+  target->_size = size;
+  if( posix_fallocate( fd, 0, (off_t)size ) != 0 )
+    return nullptr;
+  void *addr = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  if( addr == MAP_FAILED )
+    return nullptr;
+  target->_data = static_cast<uint8_t*>( addr );
+  return target;
+#endif
+}
+
+/**
+ * The file is unmapped, then synced and renamed as a written buffer is.
+ * Without write threads that is done, and the Completion called, before
+ * submit() returns.
+ *
+ * @param target from map(), written
+ * @param completion called once written or failed; must not throw
+ *
+ * @throw NFIR::Miscue called after finish()
+ */
+void
+TargetWriter::submit( const std::shared_ptr<MappedTarget> &target,
+                      const Completion &completion )
+{
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( _finished )
+      throw NFIR::Miscue( "NFIR lib: target writer already finished" );
+  }
+
+  std::unique_ptr<Task> task( new Task );
+  task->path = target->_path;
+  task->mapped = target;
+  task->completion = completion;
+  enqueue( std::move( task ) );
+}
+
+/**
+ * Returns once every submitted file has been written and its Completion
+ * called.  With the `batch` policy, the files are synced here, then, with
+ * `atomicRename`, renamed, and then their directories synced, once each;
+ * a temporary file that cannot be synced or renamed is removed.  Further
+ * calls do nothing.
+ *
+ * @throw NFIR::Miscue `batch`: a file cannot be synced or renamed, or a
+ *        directory cannot be synced
+ */
+void
+TargetWriter::finish(void)
+{
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    if( _finished )
+      return;
+    _finished = true;
+  }
+  _queue.close();
+  for( auto &t : _threads )
+    t.join();
+  _threads.clear();
+
+  if( _options.fsync != "batch" )
+    return;
+#ifndef _WIN32_64
+  std::set<std::string> directories;
+  std::string failed;
+  size_t numFailed{0};
+  for( const auto &path : _unsynced )
+  {
+    const std::string writePath = _options.atomicRename ? path + ".tmp" : path;
+    if( !syncPath( writePath, O_RDONLY )
+        || ( _options.atomicRename
+             && ( rename( writePath.c_str(), path.c_str() ) != 0 ) ) )
+    {
+      if( _options.atomicRename )
+        unlink( writePath.c_str() );
+      if( numFailed++ == 0 )
+        failed = path;
+      continue;
+    }
+    directories.insert( parentDirectory( path ) );
+  }
+  for( const auto &dir : directories )
+  {
+    if( !syncPath( dir, O_RDONLY | O_DIRECTORY ) && ( numFailed++ == 0 ) )
+      failed = dir;
+  }
+  _unsynced.clear();
+  if( numFailed > 0 )
+    throw NFIR::Miscue( "NFIR lib: cannot sync or rename "
+                        + std::to_string(numFailed)
+                        + " written target(s), first: " + failed );
+#endif
+}
+
+/** @return count */
+size_t
+TargetWriter::get_written(void) const
+{
+  std::lock_guard<std::mutex> lock( _mutex );
+  return _written;
+}
+
+/**
+ * @param task moved from
+ */
+void
+TargetWriter::enqueue( std::unique_ptr<Task> &&task )
+{
+  if( _threads.empty() )
+    complete( *task );
+  else
+    _queue.push( std::move( task ) );
+}
+
+/**
+ * Writes until the queue is closed by finish() and empty.
+ */
+void
+TargetWriter::writeStage(void)
+{
+  std::unique_ptr<Task> task;
+  while( _queue.pop( task ) )
+    complete( *task );
+}
+
+/**
+ * The buffer or mapping is freed before the Completion runs, so that a
+ * slow caller does not hold it; a mapped file that failed is removed by
+ * then.
+ *
+ * @param task file
+ */
+void
+TargetWriter::complete( Task &task )
+{
+  std::string error = write( task );
+  if( error.empty() )
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _written++;
+  }
+  std::vector<uint8_t>().swap( task.data );
+  task.mapped.reset();
+  if( task.completion )
+    task.completion( error );
+}
+
+/**
+ * With `atomicRename`, a failed write removes the temporary file and
+ * leaves the path as it was.  The temporary file is synced before it is
+ * renamed, else the rename may reach the disk before the data does, and a
+ * crash leave an empty target; with the `file` policy its directory is
+ * synced after, so that the rename too is on disk.  With the `batch`
+ * policy, the sync and rename are left to finish().  Windows: the file is
+ * written and renamed, not synced.
+ *
+ * @param task file
+ *
+ * @return error message; empty if written
+ */
+std::string
+TargetWriter::write( const Task &task )
+{
+  const std::string writePath = _options.atomicRename ? task.path + ".tmp"
+                                                      : task.path;
+#ifdef _WIN32_64
+  {
+    std::ofstream ofs( writePath, std::ios::out | std::ios::binary );
+    ofs.write( reinterpret_cast<const char*>( task.data.data() ), task.data.size() );
+    if( !ofs.good() )
+    {
+      ofs.close();
+      if( _options.atomicRename )
+        std::remove( writePath.c_str() );
+      return "Cannot write file: " + writePath;
+    }
+  }
+  if( _options.atomicRename
+      && !MoveFileExA( writePath.c_str(), task.path.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) )
+  {
+    std::remove( writePath.c_str() );
+    return "Cannot rename file: " + writePath;
+  }
+  return "";
+#else
+  int fd;
+  bool ok;
+  if( task.mapped )
+  {
+    // Already written through the mapping, into allocated blocks.
+    fd = task.mapped->_fd;
+    task.mapped->_fd = -1;
+    ok = task.mapped->unmap();
+  }
+  else
+  {
+    fd = open( writePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+      return "Cannot open file for write: " + writePath + ": " + std::strerror( errno );
+    ok = writeAll( fd, task.data.data(), task.data.size() );
+  }
+  const bool syncNow = ( _options.fsync == "file" )
+                       || ( _options.atomicRename && ( _options.fsync == "none" ) );
+  if( ok && syncNow )
+    ok = ( fsync( fd ) == 0 );
+  int error = ok ? 0 : errno;
+  if( ( close( fd ) != 0 ) && ok )
+  {
+    ok = false;
+    error = errno;
+  }
+  if( !ok )
+  {
+    if( _options.atomicRename )
+      unlink( writePath.c_str() );
+    return "Cannot write file: " + writePath + ": " + std::strerror( error );
+  }
+  if( task.mapped )
+    task.mapped->_written = true;
+
+  if( _options.fsync == "batch" )
+  {
+    std::lock_guard<std::mutex> lock( _mutex );
+    _unsynced.push_back( task.path );
+    return "";
+  }
+
+  if( _options.atomicRename )
+  {
+    if( rename( writePath.c_str(), task.path.c_str() ) != 0 )
+    {
+      error = errno;
+      unlink( writePath.c_str() );
+      return "Cannot rename file: " + writePath + ": " + std::strerror( error );
+    }
+    if( ( _options.fsync == "file" )
+        && !syncPath( parentDirectory( task.path ), O_RDONLY | O_DIRECTORY ) )
+      return "Cannot sync directory of: " + task.path + ": " + std::strerror( errno );
+  }
+  return "";
+#endif
+}
+
+}   // End namespace
+
+
+#ifndef _WIN32_64
+/**
+ * @param path of a file
+ *
+ * @return directory part of the path; `.` if none
+ */
+std::string parentDirectory( const std::string &path )
+{
+  size_t found = path.find_last_of( "/\\" );
+  if( found == std::string::npos )
+    return ".";
+  if( found == 0 )
+    return path.substr( 0, 1 );
+  return path.substr( 0, found );
+}
+
+/**
+ * @brief write() until all bytes are written; retried on EINTR.
+ *
+ * @return false on error, errno set
+ */
+bool writeAll( int fd, const uint8_t *data, size_t size )
+{
+  while( size > 0 )
+  {
+    ssize_t n = ::write( fd, data, size );
+    if( n < 0 )
+    {
+      if( errno == EINTR )
+        continue;
+      return false;
+    }
+    data += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+/**
+ * @brief Open and fsync a file or directory.
+ *
+ * @return false on error, errno set
+ */
+bool syncPath( const std::string &path, int flags )
+{
+  int fd = open( path.c_str(), flags );
+  if( fd < 0 )
+    return false;
+  bool ok = ( fsync( fd ) == 0 );
+  int error = errno;
+  close( fd );
+  errno = error;
+  return ok;
+}
+#endif
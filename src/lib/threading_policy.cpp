@@ -0,0 +1,131 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "exceptions.h"
+#include "threading_policy.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace NFIR {
+
+/** @return one line */
+std::string
+ThreadingPlan::to_s(void) const
+{
+  return "Threading policy: " + policy + ", workers: "
+         + std::to_string(workers) + ", OpenCV threads (shared): "
+         + std::to_string(openCVThreads) + ", readers: "
+         + std::to_string(readers) + ", writers: " + std::to_string(writers)
+         + ", write threads: " + std::to_string(writeThreads);
+}
+
+/**
+ * Policies:
+ *  - `latency`: all cores to one image at a time, OpenCV's pool as wide as
+ *    the cores
+ *  - `throughput`: one image per core, OpenCV single-threaded
+ *  - `hybrid`: `workers` images; OpenCV's pool gets the cores the workers
+ *    leave, and helps whichever worker calls it; with 0 workers, one per 4
+ *    cores
+ *  - `auto`: `latency` for one image; for large images (see
+ *    largeImagePixels) `hybrid`, which bounds the large images in memory;
+ *    `throughput` once the batch fills the cores; `hybrid` with one image
+ *    per worker otherwise.  A `workers` count selects `hybrid`.
+ *
+ * No more workers than images are planned.  Each image is decoded and
+ * encoded on one thread, so there are as many readers and writers as
+ * workers; they mostly wait on the queues.  File writes are I/O bound: one
+ * write thread per 4 workers.
+ *
+ * @param policy [ auto | latency | throughput | hybrid ]
+ * @param batchSize number of images
+ * @param maxImagePixels of the largest source image, 0 if not known
+ * @param workers images in parallel, 0 to let the policy choose
+ * @param cores 0 for the number of hardware threads
+ *
+ * @return threads of every stage
+ *
+ * @throw NFIR::Miscue unknown policy
+ */
+ThreadingPlan
+resolveThreadingPolicy( const std::string &policy, size_t batchSize,
+                        uint64_t maxImagePixels, size_t workers,
+                        unsigned cores )
+{
+  if( cores == 0 )
+    cores = std::max( 1u, std::thread::hardware_concurrency() );
+  batchSize = std::max( (size_t)1, batchSize );
+
+  ThreadingPlan plan;
+  plan.policy = policy;
+  if( policy == "auto" )
+  {
+    if( workers > 0 )
+      plan.policy = "hybrid";
+    else if( batchSize == 1 )
+      plan.policy = "latency";
+    else if( maxImagePixels >= largeImagePixels )
+      plan.policy = "hybrid";
+    else if( batchSize >= cores )
+      plan.policy = "throughput";
+    else
+    {
+      plan.policy = "hybrid";
+      workers = batchSize;
+    }
+  }
+
+  if( plan.policy == "latency" )
+  {
+    plan.workers = 1;
+    plan.openCVThreads = (int)cores;
+  }
+  else if( plan.policy == "throughput" )
+  {
+    plan.workers = std::min( (size_t)cores, batchSize );
+    plan.openCVThreads = 1;
+  }
+  else if( plan.policy == "hybrid" )
+  {
+    if( workers == 0 )
+      workers = std::max( 1u, cores / 4 );
+    plan.workers = std::min( workers, batchSize );
+    // OpenCV counts the calling thread as one of its pool.
+    plan.openCVThreads = ( plan.workers < cores ) ? (int)( cores - plan.workers + 1 ) : 1;
+  }
+  else
+    throw NFIR::Miscue( "NFIR lib: invalid threading policy: '" + policy + "'" );
+
+  plan.readers = plan.workers;
+  plan.writers = plan.workers;
+  plan.writeThreads = std::max( (size_t)1, plan.workers / 4 );
+
+  return plan;
+}
+
+}   // End namespace
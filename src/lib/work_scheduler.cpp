@@ -0,0 +1,73 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+#include "work_scheduler.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace NFIR {
+
+/**
+ * @param costs estimated cost per image, see NFIR::get_resampleCost()
+ */
+WorkScheduler::WorkScheduler( const std::vector<double> &costs )
+  : _order( costs.size() )
+{
+  // Stable, so that images of equal cost keep their list order.
+  std::iota( _order.begin(), _order.end(), 0 );
+  std::stable_sort( _order.begin(), _order.end(),
+                    [&costs]( size_t a, size_t b ) { return costs[a] > costs[b]; } );
+}
+
+/**
+ * @param index OUT image
+ * @param position OUT of the image in the order, from 0
+ *
+ * @return false when every image has been taken
+ */
+bool
+WorkScheduler::next( size_t &index, size_t &position )
+{
+  position = _next++;
+  if( position >= _order.size() )
+    return false;
+  index = _order[position];
+  return true;
+}
+
+/**
+ * @param position in the order, less than the number of images
+ * @return image index
+ */
+size_t
+WorkScheduler::at( size_t position ) const
+{
+  return _order.at( position );
+}
+
+}   // End namespace
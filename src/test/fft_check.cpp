@@ -0,0 +1,167 @@
+/*******************************************************************************
+License:
+This software was developed at the National Institute of Standards and
+Technology (NIST) by employees of the Federal Government in the course
+of their official duties. Pursuant to title 17 Section 105 of the
+United States Code, this software is not subject to copyright protection
+and is in the public domain. NIST assumes no responsibility  whatsoever for
+its use by other parties, and makes no guarantees, expressed or implied,
+about its quality, reliability, or any other characteristic.
+
+This software has been determined to be outside the scope of the EAR
+(see Part 734.3 of the EAR for exact details) as it has been created solely
+by employees of the U.S. Government; it is freely distributed with no
+licensing requirements; and it is considered public domain. Therefore,
+it is permissible to distribute this software as a free download from the
+internet.
+
+Disclaimer:
+This software was developed to promote biometric standards and biometric
+technology testing for the Federal Government in accordance with the USA
+PATRIOT Act and the Enhanced Border Security and Visa Entry Reform Act.
+Specific hardware and software products identified in this software were used
+in order to perform the software development.  In no case does such
+identification imply recommendation or endorsement by the National Institute
+of Standards and Technology, nor does it imply that the products and equipment
+identified are necessarily the best available for the purpose.
+*******************************************************************************/
+/**
+ * @brief Check every compiled-in FFT backend against a direct DFT.
+ *
+ * For each transform size, a random real image is transformed forward and
+ * compared, bin by bin, with the direct 2-D DFT computed in double; the
+ * inverse of that spectrum must give back the image times rows * cols.
+ * The sizes cover the radices of the builtin backend: 2, 4, 3, 5, and the
+ * generic butterfly for 7 and 11.
+ *
+ * Exit status 0 if all backends pass.
+ */
+#include "fft_backend.h"
+
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+/** Check program private methods declarations */
+static std::complex<double> packedBin( const cv::Mat&, int, int );
+static double checkForward( const cv::Mat&, const cv::Mat& );
+static double checkInverse( const cv::Mat&, const cv::Mat& );
+
+
+int main()
+{
+  const std::vector<cv::Size> sizes{ { 6, 8 }, { 16, 16 }, { 10, 12 }, { 28, 20 },
+                                     { 18, 22 }, { 64, 48 }, { 42, 30 }, { 32, 2 } };
+  // Relative to the largest bin; float transforms of 8-bit range data.
+  const double tolerance{ 1e-5 };
+
+  std::mt19937 random( 17 );
+  std::uniform_real_distribution<float> gray( 0.f, 255.f );
+  bool passed{ true };
+
+  for( auto name : NFIR::FFTBackend::get_available() )
+  {
+    NFIR::FFTBackend::set_preferred( name );
+    for( auto size : sizes )
+    {
+      cv::Mat image( size, CV_32F );
+      for( int r=0; r<image.rows; r++ ) {
+        for( int c=0; c<image.cols; c++ ) {
+          image.at<float>( r, c ) = gray( random );
+        }
+      }
+
+      NFIR::FFTBackend &fft = NFIR::FFTBackend::select( size );
+      cv::Mat spectrum, restored;
+      fft.forward( image, spectrum );
+      fft.inverse( spectrum, restored );
+
+      double forwardError = checkForward( image, spectrum );
+      double inverseError = checkInverse( image, restored );
+      bool ok = ( forwardError < tolerance ) && ( inverseError < tolerance );
+      passed = passed && ok;
+      std::cout << ( ok ? "pass " : "FAIL " ) << fft.get_name() << " "
+                << size.height << "x" << size.width
+                << ": forward " << forwardError
+                << ", inverse " << inverseError << std::endl;
+    }
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Bin of a CCS packed spectrum, see FFTBackend.
+ *
+ * @param packed N x M, CV_32F, both even
+ * @param u row frequency, 0..N-1
+ * @param v column frequency, 0..M/2
+ * @return bin (u, v)
+ */
+std::complex<double> packedBin( const cv::Mat &packed, int u, int v )
+{
+  const int N = packed.rows;
+  const int M = packed.cols;
+  if( ( v > 0 ) && ( v < M/2 ) )
+    return { packed.at<float>( u, 2*v-1 ), packed.at<float>( u, 2*v ) };
+
+  int j = ( v == 0 ) ? 0 : M-1;
+  if( u == 0 )
+    return { packed.at<float>( 0, j ), 0. };
+  if( u == N/2 )
+    return { packed.at<float>( N-1, j ), 0. };
+  int k = ( u < N/2 ) ? u : N-u;
+  std::complex<double> bin{ packed.at<float>( 2*k-1, j ), packed.at<float>( 2*k, j ) };
+  return ( u < N/2 ) ? bin : std::conj( bin );
+}
+
+/**
+ * @param image real, CV_32F
+ * @param spectrum CCS packed forward transform of image
+ * @return largest bin error relative to the largest bin
+ */
+double checkForward( const cv::Mat &image, const cv::Mat &spectrum )
+{
+  const double pi = 3.14159265358979323846;
+  const int N = image.rows;
+  const int M = image.cols;
+  double maxError{ 0. }, maxBin{ 0. };
+
+  for( int u=0; u<N; u++ )
+  {
+    for( int v=0; v<=M/2; v++ )
+    {
+      std::complex<double> direct{ 0., 0. };
+      for( int r=0; r<N; r++ ) {
+        for( int c=0; c<M; c++ ) {
+          double phase = -2. * pi * ( (double)u * r / N + (double)v * c / M );
+          direct += (double)image.at<float>( r, c ) * std::polar( 1., phase );
+        }
+      }
+      maxError = std::max( maxError, std::abs( packedBin( spectrum, u, v ) - direct ) );
+      maxBin = std::max( maxBin, std::abs( direct ) );
+    }
+  }
+  return maxError / maxBin;
+}
+
+/**
+ * @param image real, CV_32F
+ * @param restored inverse transform of the forward transform of image
+ * @return largest pixel error relative to the largest pixel, after scaling
+ */
+double checkInverse( const cv::Mat &image, const cv::Mat &restored )
+{
+  const double scale = 1. / ( (double)image.rows * image.cols );
+  double maxError{ 0. }, maxPixel{ 0. };
+
+  for( int r=0; r<image.rows; r++ ) {
+    for( int c=0; c<image.cols; c++ ) {
+      double pixel = image.at<float>( r, c );
+      maxError = std::max( maxError, std::abs( restored.at<float>( r, c ) * scale - pixel ) );
+      maxPixel = std::max( maxPixel, std::abs( pixel ) );
+    }
+  }
+  return maxError / maxPixel;
+}